@@ -15,6 +15,7 @@
 #define FOXXLL_IO_HEADER
 
 #include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/io/copy_request.hpp>
 #include <foxxll/io/create_file.hpp>
 #include <foxxll/io/disk_queues.hpp>
 #include <foxxll/io/file.hpp>
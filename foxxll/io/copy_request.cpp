@@ -0,0 +1,98 @@
+/***************************************************************************
+ *  foxxll/io/copy_request.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <iomanip>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/io/copy_request.hpp>
+#include <foxxll/io/disk_queues.hpp>
+#include <foxxll/io/file.hpp>
+
+namespace foxxll {
+
+copy_request::copy_request(
+    const completion_handler& on_complete,
+    file* src_file, offset_type src_offset,
+    file* dst_file, offset_type dst_offset,
+    size_type bytes, int queue_id)
+    : serving_request(on_complete, src_file, nullptr, src_offset, bytes,
+                      request::WRITE),
+      dst_file_(dst_file), dst_offset_(dst_offset), queue_id_(queue_id)
+{
+    dst_file_->add_request_ref();
+}
+
+void copy_request::serve()
+{
+    check_nref();
+    TLX_LOG
+        << "copy_request[" << static_cast<void*>(this) << "]::serve(): ["
+        << file_ << "|" << file_->get_allocator_id() << "]0x"
+        << std::hex << std::setfill('0') << std::setw(8)
+        << offset_ << " -> ["
+        << dst_file_ << "|" << dst_file_->get_allocator_id() << "]0x"
+        << std::setw(8) << dst_offset_ << "/0x" << bytes_ << std::dec;
+
+    try
+    {
+        file_->serve_copy(dst_file_, offset_, dst_offset_, bytes_);
+    }
+    catch (const io_error& ex)
+    {
+        error_occured(ex.what());
+    }
+
+    check_nref(true);
+
+    completed(false);
+}
+
+bool copy_request::cancel()
+{
+    if (!file_) return false;
+
+    request_ptr rp(this);
+    if (disk_queues::get_instance()->cancel_request(rp, queue_id_))
+    {
+        state_.set_to(DONE);
+        if (on_complete_)
+            on_complete_(this, /* success */ false);
+        notify_waiters();
+        release_dst_file_reference();
+        release_file_reference();
+        state_.set_to(READY2DIE);
+        return true;
+    }
+    return false;
+}
+
+void copy_request::completed(bool canceled)
+{
+    // drop the target reference first: waiters may destroy the files as soon
+    // as the request is marked as done.
+    release_dst_file_reference();
+    serving_request::completed(canceled);
+}
+
+void copy_request::release_dst_file_reference()
+{
+    if (dst_file_) {
+        dst_file_->delete_request_ref();
+        dst_file_ = nullptr;
+    }
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
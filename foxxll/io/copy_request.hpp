@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  foxxll/io/copy_request.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_IO_COPY_REQUEST_HEADER
+#define FOXXLL_IO_COPY_REQUEST_HEADER
+
+#include <foxxll/io/serving_request.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_reqlayer
+//! \{
+
+/*!
+ * Request which copies a byte range from one file into another file (or
+ * another range of the same file) without passing the data through a user
+ * buffer.
+ *
+ * The request is served by calling file::serve_copy() of the source file,
+ * which may use in-kernel copies or reflinks. It is enqueued as a WRITE
+ * request with the source file's queue (or file::DEFAULT_COPY_QUEUE) and has
+ * no user buffer.
+ */
+class copy_request : public serving_request
+{
+    constexpr static bool debug = false;
+
+    friend class file;
+
+protected:
+    //! target file of the copy
+    file* dst_file_;
+    //! offset within the target file
+    offset_type dst_offset_;
+    //! queue this request was submitted to
+    int queue_id_;
+
+public:
+    copy_request(
+        const completion_handler& on_complete,
+        file* src_file, offset_type src_offset,
+        file* dst_file, offset_type dst_offset,
+        size_type bytes, int queue_id);
+
+    file * get_dst_file() const { return dst_file_; }
+    offset_type dst_offset() const { return dst_offset_; }
+
+    bool cancel() final;
+
+protected:
+    void serve() final;
+    void completed(bool canceled) final;
+
+    //! release reference held on the target file
+    void release_dst_file_reference();
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_IO_COPY_REQUEST_HEADER
+
+/**************************************************************************/
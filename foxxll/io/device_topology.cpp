@@ -0,0 +1,115 @@
+/***************************************************************************
+ *  foxxll/io/device_topology.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <fstream>
+#include <string>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/config.hpp>
+#include <foxxll/io/device_topology.hpp>
+
+#if defined(__linux__)
+ #include <climits>
+ #include <cstdlib>
+ #include <sys/stat.h>
+ #include <sys/sysmacros.h>
+ #include <sys/types.h>
+#endif
+
+namespace foxxll {
+
+#if defined(__linux__)
+
+//! read the first word of a sysfs attribute, empty if it does not exist
+static std::string read_sysfs(const std::string& path)
+{
+    std::ifstream in(path.c_str());
+    std::string value;
+    in >> value;
+    return value;
+}
+
+static uint64_t read_sysfs_number(const std::string& path)
+{
+    const std::string value = read_sysfs(path);
+    return value.empty() ? 0 : std::strtoull(value.c_str(), nullptr, 10);
+}
+
+device_topology device_topology::discover(const std::string& path)
+{
+    constexpr bool debug = false;
+    device_topology topo;
+
+    // the file may not exist yet: use the nearest existing directory
+    struct stat st;
+    std::string p = path;
+    while (stat(p.c_str(), &st) != 0)
+    {
+        const std::string::size_type slash = p.find_last_of('/');
+        if (slash == std::string::npos) {
+            p = ".";
+        }
+        else if (slash == 0) {
+            if (p == "/") return topo;
+            p = "/";
+        }
+        else {
+            p = p.substr(0, slash);
+        }
+    }
+
+    const dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+    const std::string sys_link =
+        "/sys/dev/block/" + std::to_string(major(dev)) + ":" +
+        std::to_string(minor(dev));
+
+    char resolved[PATH_MAX];
+    if (realpath(sys_link.c_str(), resolved) == nullptr) {
+        TLX_LOG << "device_topology: no block device for " << path;
+        return topo;
+    }
+
+    // partitions share the queue of their whole disk
+    std::string sys_dev = resolved;
+    if (std::ifstream((sys_dev + "/partition").c_str()).good())
+        sys_dev = sys_dev.substr(0, sys_dev.find_last_of('/'));
+
+    topo.id = read_sysfs(sys_dev + "/dev");
+    topo.name = sys_dev.substr(sys_dev.find_last_of('/') + 1);
+    topo.rotational = read_sysfs_number(sys_dev + "/queue/rotational") != 0;
+    topo.queue_depth = static_cast<size_t>(
+        read_sysfs_number(sys_dev + "/queue/nr_requests"));
+    topo.optimal_io_size = read_sysfs_number(sys_dev + "/queue/optimal_io_size");
+    topo.physical_block_size =
+        read_sysfs_number(sys_dev + "/queue/physical_block_size");
+
+    TLX_LOG << "device_topology: " << path << " is on " << topo.name
+            << " (" << topo.id << ") rotational=" << topo.rotational
+            << " queue_depth=" << topo.queue_depth
+            << " optimal_io_size=" << topo.optimal_io_size;
+
+    return topo;
+}
+
+#else
+
+device_topology device_topology::discover(const std::string& /* path */)
+{
+    return device_topology();
+}
+
+#endif
+
+} // namespace foxxll
+
+/**************************************************************************/
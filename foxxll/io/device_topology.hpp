@@ -0,0 +1,73 @@
+/***************************************************************************
+ *  foxxll/io/device_topology.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_IO_DEVICE_TOPOLOGY_HEADER
+#define FOXXLL_IO_DEVICE_TOPOLOGY_HEADER
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_iolayer
+//! \{
+
+/*!
+ * Properties of the physical block device backing a file.
+ *
+ * discover() resolves a path via stat() to its block device and reads the
+ * device's queue attributes from sysfs, partitions are mapped to their whole
+ * disk. Files on file systems without a backing block device (tmpfs, network
+ * file systems) and platforms without sysfs yield an unknown topology.
+ */
+struct device_topology
+{
+    //! "major:minor" of the whole block device, empty if unknown
+    std::string id;
+
+    //! kernel name of the device, e.g. "sda" or "nvme0n1"
+    std::string name;
+
+    //! device has rotating media, i.e. seeks are expensive
+    bool rotational = false;
+
+    //! number of requests the device queue accepts, zero if unknown
+    size_t queue_depth = 0;
+
+    //! preferred request size in bytes, zero if not reported
+    uint64_t optimal_io_size = 0;
+
+    //! physical sector size in bytes, zero if unknown
+    uint64_t physical_block_size = 0;
+
+    //! whether the backing device was found
+    bool known() const { return !id.empty(); }
+
+    //! whether both files reside on the same known device
+    bool same_device(const device_topology& other) const
+    {
+        return known() && id == other.id;
+    }
+
+    //! Resolve the block device of path, which need not exist yet, in which
+    //! case the nearest existing parent directory is used.
+    static device_topology discover(const std::string& path);
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_IO_DEVICE_TOPOLOGY_HEADER
+
+/**************************************************************************/
@@ -10,6 +10,7 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <foxxll/io/copy_request.hpp>
 #include <foxxll/io/disk_queued_file.hpp>
 #include <foxxll/io/disk_queues.hpp>
 #include <foxxll/io/file.hpp>
@@ -46,6 +47,19 @@ request_ptr disk_queued_file::awrite(
     return req;
 }
 
+request_ptr disk_queued_file::acopy(
+    file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+    const completion_handler& on_complete)
+{
+    request_ptr req = tlx::make_counting<copy_request>(
+            on_complete, this, pos, dst, dst_pos, bytes, get_queue_id()
+        );
+
+    disk_queues::get_instance()->add_request(req, get_queue_id());
+
+    return req;
+}
+
 } // namespace foxxll
 
 /**************************************************************************/
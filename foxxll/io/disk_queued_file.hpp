@@ -41,6 +41,10 @@ public:
         void* buffer, offset_type pos, size_type bytes,
         const completion_handler& on_complete = completion_handler()) override;
 
+    request_ptr acopy(
+        file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+        const completion_handler& on_complete = completion_handler()) override;
+
     int get_queue_id() const override
     {
         return queue_id_;
@@ -10,11 +10,70 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <algorithm>
+
+#include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/io/copy_request.hpp>
+#include <foxxll/io/disk_queues.hpp>
 #include <foxxll/io/file.hpp>
 #include <foxxll/io/ufs_platform.hpp>
 
 namespace foxxll {
 
+request_ptr file::acopy(
+    file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+    const completion_handler& on_complete)
+{
+    const int queue_id = DEFAULT_COPY_QUEUE;
+
+    request_ptr req = tlx::make_counting<copy_request>(
+            on_complete, this, pos, dst, dst_pos, bytes, queue_id
+        );
+
+    disk_queues::get_instance()->add_request(req, queue_id);
+
+    return req;
+}
+
+void file::serve_copy(file* dst, offset_type pos, offset_type dst_pos,
+                      size_type bytes)
+{
+    // buffered fallback: bounce data through an aligned chunk buffer. A
+    // target without multi-block requests gets the range in one piece, it
+    // is a single block.
+    const size_type chunk_size = dst->supports_multiblock_requests()
+                                 ? size_type(4 * 1024 * 1024) : bytes;
+
+    const size_type buffer_size = std::min(bytes, chunk_size);
+    void* buffer = aligned_alloc<BlockAlignment>(buffer_size);
+
+    try
+    {
+        while (bytes > 0)
+        {
+            const size_type chunk = std::min(bytes, chunk_size);
+
+            serve(buffer, pos, chunk, request::READ);
+            dst->serve(buffer, dst_pos, chunk, request::WRITE);
+
+            pos += chunk, dst_pos += chunk, bytes -= chunk;
+        }
+    }
+    catch (...)
+    {
+        aligned_dealloc<BlockAlignment>(buffer);
+        throw;
+    }
+
+    aligned_dealloc<BlockAlignment>(buffer);
+}
+
+void file::preallocate(offset_type offset, offset_type bytes)
+{
+    if (offset + bytes > size())
+        set_size(offset + bytes);
+}
+
 int file::unlink(const char* path)
 {
     return ::unlink(path);
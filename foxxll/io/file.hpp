@@ -88,6 +88,8 @@ public:
 
     static const int DEFAULT_QUEUE = -1;
     static const int DEFAULT_LINUXAIO_QUEUE = -2;
+    //! queue for copy requests of files whose queue cannot serve them
+    static const int DEFAULT_COPY_QUEUE = -3;
     static const int NO_ALLOCATOR = -1;
     static const unsigned int DEFAULT_DEVICE_ID = std::numeric_limits<unsigned int>::max();
 
@@ -132,13 +134,38 @@ public:
         void* buffer, offset_type pos, size_type bytes,
         const completion_handler& on_complete = completion_handler()) = 0;
 
+    //! Schedules an asynchronous copy of a range of this file into another
+    //! file (or another range of this file), without a user buffer.
+    //! \param dst file to copy the data into
+    //! \param pos file position to start copying from
+    //! \param dst_pos position in \c dst to start writing at
+    //! \param bytes number of bytes to copy
+    //! \param on_complete I/O completion handler
+    //! \return \c request_ptr request object, which can be used to track the
+    //! status of the operation
+    virtual request_ptr acopy(
+        file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+        const completion_handler& on_complete = completion_handler());
+
     virtual void serve(void* buffer, offset_type offset, size_type bytes,
                        request::read_or_write op) = 0;
 
+    //! Synchronously copies a range of this file into \c dst. The default
+    //! implementation reads and writes the data in chunks via serve(),
+    //! subclasses may use in-kernel copies or reflinks instead.
+    virtual void serve_copy(file* dst, offset_type pos, offset_type dst_pos,
+                            size_type bytes);
+
     //! Changes the size of the file.
     //! \param newsize new file size
     virtual void set_size(offset_type newsize) = 0;
 
+    //! Reserves storage for the range [offset, offset + bytes) and extends
+    //! the file if necessary. The default implementation calls set_size(),
+    //! subclasses may allocate contiguous extents instead of sparse holes,
+    //! throwing bad_ext_alloc if the file system is out of space.
+    virtual void preallocate(offset_type offset, offset_type bytes);
+
     //! Returns size of the file.
     //! \return file size in bytes
     virtual offset_type size() = 0;
@@ -173,6 +200,11 @@ public:
     //! close and remove file
     virtual void close_remove() { }
 
+    //! Whether a request may span several adjacent blocks, such that writes
+    //! of neighbouring blocks can be merged. Files storing each block
+    //! separately return false.
+    virtual bool supports_multiblock_requests() const { return true; }
+
     virtual ~file()
     {
         const size_t nr = get_request_nref();
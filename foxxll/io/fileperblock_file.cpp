@@ -78,6 +78,27 @@ void fileperblock_file<base_file_type>::serve(
     base_file.serve(buffer, 0, bytes, op);
 }
 
+template <class base_file_type>
+void fileperblock_file<base_file_type>::serve_copy(
+    file* dst, offset_type pos, offset_type dst_pos, size_type bytes)
+{
+    // the chunked fallback would map every chunk to a file of its own
+    void* buffer = aligned_alloc<BlockAlignment>(bytes);
+
+    try
+    {
+        serve(buffer, pos, bytes, request::READ);
+        dst->serve(buffer, dst_pos, bytes, request::WRITE);
+    }
+    catch (...)
+    {
+        aligned_dealloc<BlockAlignment>(buffer);
+        throw;
+    }
+
+    aligned_dealloc<BlockAlignment>(buffer);
+}
+
 template <class base_file_type>
 void fileperblock_file<base_file_type>::lock()
 {
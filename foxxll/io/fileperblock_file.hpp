@@ -55,6 +55,10 @@ public:
     void serve(void* buffer, offset_type offset, size_type bytes,
                request::read_or_write op) final;
 
+    //! Copies one whole block, which is a file of its own, in one piece.
+    void serve_copy(file* dst, offset_type pos, offset_type dst_pos,
+                    size_type bytes) final;
+
     //! Changes the size of the file.
     //! \param new_size value of the new file size
     virtual void set_size(offset_type new_size) { current_size_ = new_size; }
@@ -72,6 +76,9 @@ public:
     //! Rename the file corresponding to the offset such that it is out of reach for deleting.
     virtual void export_files(offset_type offset, offset_type length, std::string filename);
 
+    //! Each block is a file of its own, requests cannot span blocks.
+    bool supports_multiblock_requests() const final { return false; }
+
     const char * io_type() const final;
 };
 
@@ -45,6 +45,13 @@ request_ptr linuxaio_file::awrite(
     return req;
 }
 
+request_ptr linuxaio_file::acopy(
+    file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+    const completion_handler& on_complete)
+{
+    return file::acopy(dst, pos, dst_pos, bytes, on_complete);
+}
+
 void linuxaio_file::serve(void* buffer, offset_type offset, size_type bytes,
                           request::read_or_write op)
 {
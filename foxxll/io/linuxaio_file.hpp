@@ -71,6 +71,12 @@ public:
         void* buffer, offset_type pos, size_type bytes,
         const completion_handler& on_cmpl = completion_handler()) final;
 
+    //! Copy requests cannot be posted to the kernel AIO queue, they are
+    //! served by file::DEFAULT_COPY_QUEUE instead.
+    request_ptr acopy(
+        file* dst, offset_type pos, offset_type dst_pos, size_type bytes,
+        const completion_handler& on_cmpl = completion_handler()) final;
+
     const char * io_type() const final;
 
     int get_desired_queue_length() const
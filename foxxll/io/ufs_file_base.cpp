@@ -18,11 +18,18 @@
 
 #include <foxxll/common/error_handling.hpp>
 #include <foxxll/common/exceptions.hpp>
+#include <foxxll/common/timer.hpp>
 #include <foxxll/config.hpp>
 #include <foxxll/io/file.hpp>
+#include <foxxll/io/iostats.hpp>
 #include <foxxll/io/ufs_file_base.hpp>
 #include <foxxll/io/ufs_platform.hpp>
 
+#if FOXXLL_HAVE_FICLONERANGE
+ #include <linux/fs.h>
+ #include <sys/ioctl.h>
+#endif
+
 namespace foxxll {
 
 const char* ufs_file_base::io_type() const
@@ -280,6 +287,114 @@ void ufs_file_base::_set_size(offset_type newsize)
 #endif
 }
 
+void ufs_file_base::preallocate(offset_type offset, offset_type bytes)
+{
+    std::unique_lock<std::mutex> fd_lock(fd_mutex_);
+
+    if (bytes == 0 || (mode_ & RDONLY) || is_device_)
+        return;
+
+#if FOXXLL_HAVE_FALLOCATE
+    // allocate extents instead of sparse holes, this also extends the file
+    if (::fallocate(file_des_, 0, offset, bytes) == 0)
+        return;
+
+    if (errno == ENOSPC)
+        FOXXLL_THROW_ERRNO(
+            bad_ext_alloc,
+            "fallocate() path=" << filename_ << " fd=" << file_des_ <<
+                " offset=" << offset << " bytes=" << bytes
+        );
+
+    // fall back to ftruncate() on file systems without fallocate() support
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+        FOXXLL_THROW_ERRNO(
+            io_error,
+            "fallocate() path=" << filename_ << " fd=" << file_des_ <<
+                " offset=" << offset << " bytes=" << bytes
+        );
+#endif
+
+    if (offset + bytes > _size())
+        _set_size(offset + bytes);
+}
+
+ufs_file_base::size_type ufs_file_base::_copy_in_kernel(
+    ufs_file_base* dst, offset_type pos, offset_type dst_pos, size_type bytes)
+{
+    size_type done = 0;
+
+#if FOXXLL_HAVE_FICLONERANGE
+    // share the extents if the file system supports reflinks (btrfs, XFS).
+    // This fails unless both ranges are aligned to the file system block size.
+    struct file_clone_range range;
+    range.src_fd = file_des_;
+    range.src_offset = pos;
+    range.src_length = bytes;
+    range.dest_offset = dst_pos;
+
+    if (::ioctl(dst->file_des_, FICLONERANGE, &range) == 0)
+        return bytes;
+#endif
+
+#if FOXXLL_HAVE_COPY_FILE_RANGE
+    while (done < bytes)
+    {
+        loff_t in_pos = static_cast<loff_t>(pos + done);
+        loff_t out_pos = static_cast<loff_t>(dst_pos + done);
+
+        ssize_t rc = ::copy_file_range(
+                file_des_, &in_pos, dst->file_des_, &out_pos, bytes - done, 0
+            );
+
+        if (rc > 0) {
+            done += static_cast<size_type>(rc);
+            continue;
+        }
+        if (rc == 0) // end of source file, let the caller zero-fill
+            break;
+        if (errno == EINTR)
+            continue;
+        if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+            errno == EOPNOTSUPP || errno == EBADF)
+            break;
+
+        FOXXLL_THROW_ERRNO(
+            io_error,
+            "copy_file_range() path=" << filename_ << " fd=" << file_des_ <<
+                " dst_path=" << dst->filename_ << " dst_fd=" << dst->file_des_ <<
+                " pos=" << pos + done << " dst_pos=" << dst_pos + done <<
+                " bytes=" << bytes - done
+        );
+    }
+#else
+    tlx::unused(dst, pos, dst_pos, bytes);
+#endif
+
+    return done;
+}
+
+void ufs_file_base::serve_copy(file* dst, offset_type pos, offset_type dst_pos,
+                               size_type bytes)
+{
+    if (auto* dst_ufs = dynamic_cast<ufs_file_base*>(dst))
+    {
+        double start = timestamp();
+        size_type done = _copy_in_kernel(dst_ufs, pos, dst_pos, bytes);
+        double duration = timestamp() - start;
+
+        if (done > 0) {
+            file_stats_->read_op_finished(done, duration);
+            dst->get_file_stats()->write_op_finished(done, duration);
+        }
+
+        pos += done, dst_pos += done, bytes -= done;
+    }
+
+    if (bytes > 0)
+        file::serve_copy(dst, pos, dst_pos, bytes);
+}
+
 void ufs_file_base::close_remove()
 {
     close();
@@ -43,11 +43,19 @@ protected:
     void _set_size(offset_type newsize);
     void close();
 
+    //! copy as much as possible of a range into \c dst using reflinks or
+    //! in-kernel copies, returns the number of bytes copied.
+    size_type _copy_in_kernel(ufs_file_base* dst, offset_type pos,
+                              offset_type dst_pos, size_type bytes);
+
 public:
     ~ufs_file_base();
     offset_type size() final;
     void set_size(offset_type newsize) final;
+    void preallocate(offset_type offset, offset_type bytes) final;
     void lock() final;
+    void serve_copy(file* dst, offset_type pos, offset_type dst_pos,
+                    size_type bytes) override;
     const char * io_type() const override;
     void close_remove() final;
     //! unlink file without closing it.
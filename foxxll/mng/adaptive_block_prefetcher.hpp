@@ -0,0 +1,341 @@
+/***************************************************************************
+ *  foxxll/mng/adaptive_block_prefetcher.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_ADAPTIVE_BLOCK_PREFETCHER_HEADER
+#define FOXXLL_MNG_ADAPTIVE_BLOCK_PREFETCHER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io/request.hpp>
+#include <foxxll/mng/concurrent_prefetch_pool.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Prefetching engine with a read-ahead window adapted to the consumer.
+ *
+ * Offers the interface of block_prefetcher, but reads the blocks in
+ * consumption order and sizes the number of blocks in flight by Little's law:
+ * the window covers the measured read latency divided by the measured time
+ * the consumer spends per block, plus one. A consumer faster than the disks
+ * thus gets a deeper window, a slower one releases its buffers. The window
+ * stays within [min_buffers, max_buffers].
+ *
+ * Buffers are allocated individually. If a shared concurrent_prefetch_pool
+ * is given, additional buffers are taken from its free blocks and unused
+ * ones are handed back to it, hence several prefetchers share one memory
+ * budget; buffers are only allocated to reach min_buffers.
+ */
+template <typename BlockType, typename BidIteratorType>
+class adaptive_block_prefetcher
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_iterator_type = BidIteratorType;
+    using bid_type = typename block_type::bid_type;
+    using pool_type = concurrent_prefetch_pool<block_type>;
+
+protected:
+    //! a block in flight or read but not yet consumed
+    struct slot
+    {
+        block_type* block;
+        request_ptr req;
+        double issued;
+        double completed = 0.0;
+    };
+
+    bid_iterator_type consume_seq_begin;
+    size_t seq_length;
+
+    //! next block to read and to consume
+    size_t nextread = 0;
+    size_t nextconsume = 0;
+
+    size_t min_buffers_, max_buffers_;
+
+    //! current target number of blocks in flight
+    size_t window_;
+
+    pool_type* pool_;
+
+    completion_handler do_after_fetch;
+
+    //! blocks in consumption order
+    std::deque<std::unique_ptr<slot> > slots_;
+
+    //! buffers not in use
+    std::vector<block_type*> spare_;
+
+    //! buffer held by the consumer, if any
+    block_type* held_ = nullptr;
+
+    //! number of buffers owned
+    size_t nbuffers_ = 0;
+
+    //! smoothed read latency and consumer time per block in seconds
+    double latency_ = 0.0, interval_ = 0.0;
+
+    //! time the consumer received its last block
+    double last_return_ = 0.0;
+
+    //! number of waits for a block which was not yet read
+    size_t stalls_ = 0;
+
+    //! weight of a new sample in the smoothed measurements
+    static constexpr double smoothing = 0.25;
+
+    block_type * get_buffer()
+    {
+        if (!spare_.empty()) {
+            block_type* block = spare_.back();
+            spare_.pop_back();
+            return block;
+        }
+        if (nbuffers_ >= max_buffers_)
+            return nullptr;
+
+        block_type* block = pool_ ? pool_->try_steal() : nullptr;
+        if (!block)
+        {
+            if (pool_ && nbuffers_ >= min_buffers_)
+                return nullptr;
+            block = new block_type;
+        }
+        ++nbuffers_;
+        return block;
+    }
+
+    void release_buffer(block_type* block)
+    {
+        --nbuffers_;
+        if (pool_)
+            pool_->add(block);
+        else
+            delete block;
+    }
+
+    //! issue reads until the window is full, then release surplus buffers
+    void fill()
+    {
+        while (slots_.size() < window_ && nextread < seq_length)
+        {
+            block_type* block = get_buffer();
+            if (!block)
+                break;
+
+            slot* s = new slot;
+            s->block = block;
+            s->issued = timestamp();
+            slots_.emplace_back(s);
+
+            const size_t iblock = nextread++;
+            TLX_LOG << "adaptive_block_prefetcher: reading block " << iblock;
+
+            completion_handler on_complete = do_after_fetch;
+            s->req = block->read(
+                *(consume_seq_begin + iblock),
+                [s, on_complete](request* req, bool success) {
+                    s->completed = timestamp();
+                    if (on_complete)
+                        on_complete(req, success);
+                });
+        }
+
+        while (!spare_.empty() && nbuffers_ > window_ + 1)
+        {
+            release_buffer(spare_.back());
+            spare_.pop_back();
+        }
+    }
+
+    //! adapt the window to the latest measurements
+    void adapt()
+    {
+        size_t window = min_buffers_;
+        if (interval_ > 0.0)
+        {
+            const double needed = std::ceil(latency_ / interval_) + 1.0;
+            if (needed >= static_cast<double>(max_buffers_))
+                window = max_buffers_;
+            else if (needed > static_cast<double>(min_buffers_))
+                window = static_cast<size_t>(needed);
+        }
+        else if (latency_ > 0.0)
+        {
+            window = max_buffers_;
+        }
+
+        if (window != window_) {
+            TLX_LOG << "adaptive_block_prefetcher: window " << window_
+                    << " -> " << window << " latency=" << latency_
+                    << " interval=" << interval_;
+            window_ = window;
+        }
+    }
+
+    block_type * wait()
+    {
+        assert(!slots_.empty());
+        const double now = timestamp();
+        if (nextconsume > 0)
+            interval_ += smoothing * ((now - last_return_) - interval_);
+
+        std::unique_ptr<slot> s = std::move(slots_.front());
+        slots_.pop_front();
+        ++nextconsume;
+
+        try {
+            // the request finishes after its completion handler ran
+            if (!s->req->poll())
+                ++stalls_;
+            s->req->wait();
+        }
+        catch (...) {
+            // keep the buffer of the failed read and the following reads
+            spare_.push_back(s->block);
+            fill();
+            throw;
+        }
+
+        latency_ += smoothing * ((s->completed - s->issued) - latency_);
+        adapt();
+
+        last_return_ = timestamp();
+        held_ = s->block;
+        return held_;
+    }
+
+public:
+    /*!
+     * Constructs an object and immediately starts prefetching.
+     *
+     * \param cons_begin \c bid_iterator pointing to the \c bid of the first
+     * block to be consumed
+     * \param cons_end \c bid_iterator pointing to the \c bid of the ( \b last
+     * + 1 ) block of consumption sequence
+     * \param min_buffers minimum number of blocks in flight, at least one
+     * \param max_buffers maximum number of buffers, the memory budget
+     * \param pool shared pool to take buffers from and hand them back to
+     * \param do_after_fetch called after each completed read
+     */
+    adaptive_block_prefetcher(
+        bid_iterator_type cons_begin,
+        bid_iterator_type cons_end,
+        size_t min_buffers, size_t max_buffers,
+        pool_type* pool = nullptr,
+        completion_handler do_after_fetch = completion_handler())
+        : consume_seq_begin(cons_begin),
+          seq_length(cons_end - cons_begin),
+          min_buffers_(std::max<size_t>(min_buffers, 1)),
+          max_buffers_(std::max(max_buffers, min_buffers_)),
+          window_(min_buffers_),
+          pool_(pool),
+          do_after_fetch(do_after_fetch)
+    {
+        assert(seq_length > 0);
+        fill();
+    }
+
+    //! non-copyable: delete copy-constructor
+    adaptive_block_prefetcher(const adaptive_block_prefetcher&) = delete;
+    //! non-copyable: delete assignment operator
+    adaptive_block_prefetcher& operator = (const adaptive_block_prefetcher&) = delete;
+
+    //! Pulls next unconsumed block from the consumption sequence.
+    //! \return Pointer to the already prefetched block from the internal buffer pool
+    block_type * pull_block()
+    {
+        return wait();
+    }
+
+    //! Exchanges buffers between prefetcher and application.
+    //! \param buffer pointer to the consumed buffer. After call if return value is true \c buffer
+    //!        contains valid pointer to the next unconsumed prefetched buffer.
+    //! \remark parameter \c buffer must be value returned by \c pull_block() or \c block_consumed() methods
+    //! \return \c false if there are no blocks to consume left, \c true if consumption sequence is not emptied
+    bool block_consumed(block_type*& buffer)
+    {
+        assert(buffer == held_);
+        spare_.push_back(buffer);
+        held_ = nullptr;
+
+        fill();
+
+        if (nextconsume >= seq_length)
+            return false;
+
+        buffer = wait();
+        return true;
+    }
+
+    //! No more consumable blocks available, but can't delete the prefetcher,
+    //! because not all blocks may have been returned, yet.
+    bool empty() const
+    {
+        return nextconsume >= seq_length;
+    }
+
+    //! Index of the next element in the consume sequence.
+    size_t pos() const
+    {
+        return nextconsume;
+    }
+
+    //! current target number of blocks in flight
+    size_t window() const { return window_; }
+
+    //! number of buffers currently owned
+    size_t buffers() const { return nbuffers_; }
+
+    //! number of times the consumer waited for a block
+    size_t stalls() const { return stalls_; }
+
+    //! Waits for outstanding reads and frees or returns all buffers.
+    ~adaptive_block_prefetcher()
+    {
+        for (std::unique_ptr<slot>& s : slots_)
+        {
+            // errors of reads nobody consumed are not reported
+            try {
+                s->req->wait();
+            }
+            catch (...) { }
+            release_buffer(s->block);
+        }
+        for (block_type* block : spare_)
+            release_buffer(block);
+        if (held_)
+            release_buffer(held_);
+    }
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_ADAPTIVE_BLOCK_PREFETCHER_HEADER
+
+/**************************************************************************/
@@ -54,12 +54,31 @@ struct sim_event_cmp
 using write_time_pair = std::pair<size_t, size_t>;
 struct write_time_cmp
 {
-    inline bool operator () (const write_time_pair& a, const write_time_pair& b) const
+    template <typename PairType>
+    inline bool operator () (const PairType& a, const PairType& b) const
     {
         return a.second > b.second;
     }
 };
 
+// WRITE COMPLETED at a real valued time
+struct timed_event
+{
+    double timestamp;
+    size_t iblock;
+    inline timed_event(double t, size_t b) : timestamp(t), iblock(b) { }
+};
+
+struct timed_event_cmp
+{
+    inline bool operator () (const timed_event& a, const timed_event& b) const
+    {
+        // ties in favor of the block needed later, as in the unit time case
+        return a.timestamp > b.timestamp ||
+               (a.timestamp == b.timestamp && a.iblock < b.iblock);
+    }
+};
+
 static inline size_t get_disk(size_t i, const size_t* disks, size_t D)
 {
     size_t disk = disks[i];
@@ -167,6 +186,101 @@ size_t simulate_async_write(
     return (oldtime - 1);
 }
 
+// as simulate_async_write, but disk d needs service_time[d] per block and
+// starts its next queued block as soon as it is idle
+double simulate_async_write(
+    const size_t* disks,
+    const size_t L,
+    const size_t m_init,
+    const size_t D,
+    const double* service_time,
+    std::pair<size_t, double>* o_time)
+{
+    using event_queue_type = std::priority_queue<
+              timed_event, std::vector<timed_event>, timed_event_cmp>;
+    // + sentinel for remapping NO_ALLOCATOR
+    tlx::simple_vector<std::queue<size_t> > disk_queues(D + 1);
+    tlx::simple_vector<bool> disk_busy(D + 1);
+    std::fill(disk_busy.begin(), disk_busy.end(), false);
+    event_queue_type event_queue;
+
+    double now = 0.0;
+    auto start_next = [&](size_t disk) {
+                          if (disk_busy[disk] || disk_queues[disk].empty())
+                              return;
+                          const size_t j = disk_queues[disk].front();
+                          disk_queues[disk].pop();
+                          disk_busy[disk] = true;
+                          event_queue.push(timed_event(now + service_time[disk], j));
+                          TLX_LOG << "Block " << j << " scheduled for time "
+                                  << now + service_time[disk];
+                      };
+
+    size_t m = m_init;
+    size_t i = L;
+    while (m && (i > 0))
+    {
+        i--;
+        m--;
+        disk_queues[get_disk(i, disks, D)].push(i);
+    }
+    for (size_t d = 0; d <= D; d++)
+        start_next(d);
+
+    while (!event_queue.empty())
+    {
+        const timed_event cur = event_queue.top();
+        event_queue.pop();
+        now = cur.timestamp;
+        o_time[cur.iblock] = std::pair<size_t, double>(cur.iblock, now);
+
+        const size_t disk = get_disk(cur.iblock, disks, D);
+        disk_busy[disk] = false;
+
+        // the freed buffer takes the next block to write
+        if (i > 0)
+        {
+            size_t next = get_disk(--i, disks, D);
+            disk_queues[next].push(i);
+            start_next(next);
+        }
+        start_next(disk);
+    }
+
+    assert(i == 0);
+    return now;
+}
+
+//! Fill service_time[0..D] from the given per device times. Unknown (zero)
+//! entries and the sentinel get the mean of the known ones. Returns false if
+//! the times do not distinguish the disks.
+static bool normalize_service_times(
+    const std::vector<double>& times, size_t D, double* service_time)
+{
+    double sum = 0.0;
+    size_t known = 0;
+    for (size_t d = 0; d < D && d < times.size(); ++d)
+    {
+        if (times[d] > 0.0) {
+            sum += times[d];
+            ++known;
+        }
+    }
+    if (known == 0)
+        return false;
+
+    const double mean = sum / static_cast<double>(known);
+    bool uniform = true;
+    for (size_t d = 0; d <= D; ++d)
+    {
+        service_time[d] = (d < D && d < times.size() && times[d] > 0.0)
+                          ? times[d] : mean;
+        if (service_time[d] != service_time[0])
+            uniform = false;
+    }
+    return !uniform;
+}
+
 } // namespace async_schedule_local
 
 void compute_prefetch_schedule(
@@ -209,6 +323,75 @@ void compute_prefetch_schedule(
     tlx::unused(w_steps);
 }
 
+void compute_prefetch_schedule(
+    const size_t* first,
+    const size_t* last,
+    size_t* out_first,
+    size_t m,
+    size_t D,
+    const std::vector<double>& service_times)
+{
+    constexpr bool debug = false;
+
+    using pair_type = std::pair<size_t, double>;
+    const size_t L = last - first;
+
+    tlx::simple_vector<double> service_time(D + 1);
+    if (L <= D ||
+        !async_schedule_local::normalize_service_times(
+            service_times, D, service_time.begin()))
+    {
+        compute_prefetch_schedule(first, last, out_first, m, D);
+        return;
+    }
+
+    tlx::simple_vector<pair_type> write_order(L);
+
+    const double w_time = async_schedule_local::simulate_async_write(
+        first, L, m, D, service_time.begin(), write_order.begin());
+
+    TLX_LOG << "Write time: " << w_time;
+
+    std::stable_sort(write_order.begin(), write_order.end(),
+                     async_schedule_local::write_time_cmp());
+
+    for (size_t i = 0; i < L; i++)
+        out_first[i] = write_order[i].first;
+
+    tlx::unused(w_time);
+}
+
+void compute_windowed_prefetch_schedule(
+    const size_t* first,
+    const size_t* last,
+    size_t* out_first,
+    size_t m,
+    size_t D,
+    size_t window,
+    const std::vector<double>& service_times)
+{
+    if (window == 0)
+        window = default_prefetch_window(m);
+
+    // the schedule of a window issues its j-th block among its first j + m
+    // reads, the concatenation keeps this bound which block_prefetcher needs
+    for (const size_t* chunk = first; chunk < last; )
+    {
+        const size_t n = std::min<size_t>(window, last - chunk);
+        const size_t offset = chunk - first;
+        compute_prefetch_schedule(
+            chunk, chunk + n, out_first + offset, m, D, service_times);
+        for (size_t i = 0; i < n; ++i)
+            out_first[offset + i] += offset;
+        chunk += n;
+    }
+}
+
+size_t default_prefetch_window(size_t m)
+{
+    return std::max<size_t>(64 * m, 64 * 1024);
+}
+
 } // namespace foxxll
 
 /**************************************************************************/
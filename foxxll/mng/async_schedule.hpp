@@ -19,6 +19,10 @@
 // and queued writing on parallel disks, 2005
 // DOI: 10.1137/S0097539703431573
 
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
 #include <foxxll/common/types.hpp>
 #include <tlx/simple_vector.hpp>
 
@@ -41,6 +45,21 @@ inline void compute_prefetch_schedule(
     compute_prefetch_schedule(static_cast<const size_t*>(first), static_cast<const size_t*>(last), out_first, m, D);
 }
 
+/*!
+ * Computes the prefetch schedule for disks of different speed: device d
+ * needs service_times[d] to read a block, e.g. as estimated by
+ * block_manager::device_service_times(). Unknown (zero) entries are assumed
+ * to be average. Falls back to the unit time schedule above if the times do
+ * not distinguish the devices.
+ */
+void compute_prefetch_schedule(
+    const size_t* first,
+    const size_t* last,
+    size_t* out_first,
+    size_t m,
+    size_t D,
+    const std::vector<double>& service_times);
+
 template <typename RunType>
 void compute_prefetch_schedule(
     const RunType& input,
@@ -71,6 +90,106 @@ void compute_prefetch_schedule(
     compute_prefetch_schedule(disks.begin(), disks.end(), out_first, m, D);
 }
 
+/*!
+ * Computes the prefetch schedule of consecutive windows of the sequence
+ * independently and concatenates them. Costs O(window) memory besides the
+ * output, and the schedule of the first window is available after O(window)
+ * time. The order is as safe for a block_prefetcher with m buffers as the
+ * full schedule; near the window borders the disks are used less evenly.
+ *
+ * \param window number of blocks per window, zero selects
+ * default_prefetch_window(m)
+ * \param service_times per device service times, see above, empty for unit
+ * times
+ */
+void compute_windowed_prefetch_schedule(
+    const size_t* first,
+    const size_t* last,
+    size_t* out_first,
+    size_t m,
+    size_t D,
+    size_t window = 0,
+    const std::vector<double>& service_times = std::vector<double>());
+
+//! Default window size for m prefetch buffers: large enough that the loss at
+//! the window borders is small, small enough to be computed quickly.
+size_t default_prefetch_window(size_t m);
+
+/*!
+ * Prefetch schedule of a BID sequence computed lazily window by window, see
+ * compute_windowed_prefetch_schedule(). Only the current window is held in
+ * memory; it is computed when operator[] first reaches it, i.e. while the
+ * prefetcher is reading the previous one. Intended for the monotone accesses
+ * of block_prefetcher, going back to an earlier window recomputes it.
+ */
+template <typename BidIteratorType>
+class windowed_prefetch_schedule
+{
+public:
+    /*!
+     * \param begin first BID of the consumption sequence
+     * \param end one past the last BID of the consumption sequence
+     * \param m number of prefetch buffers
+     * \param D maximum device id
+     * \param window number of blocks per window, zero selects
+     * default_prefetch_window(m)
+     * \param service_times per device service times, empty for unit times
+     */
+    windowed_prefetch_schedule(
+        BidIteratorType begin, BidIteratorType end,
+        size_t m, size_t D, size_t window = 0,
+        const std::vector<double>& service_times = std::vector<double>())
+        : begin_(begin), length_(end - begin), m_(m), D_(D),
+          window_(window ? window : default_prefetch_window(m)),
+          service_times_(service_times),
+          disks_(std::min(window_, length_)),
+          order_(std::min(window_, length_))
+    { }
+
+    //! length of the consumption sequence
+    size_t size() const { return length_; }
+
+    //! number of blocks per window
+    size_t window() const { return window_; }
+
+    //! index into the consumption sequence of the i-th block to prefetch
+    size_t operator [] (size_t i)
+    {
+        assert(i < length_);
+        if (i - chunk_begin_ >= chunk_size_)
+            compute(i - i % window_);
+        return order_[i - chunk_begin_];
+    }
+
+private:
+    BidIteratorType begin_;
+    size_t length_, m_, D_, window_;
+
+    std::vector<double> service_times_;
+
+    //! first index and length of the window held in order_
+    size_t chunk_begin_ = 0, chunk_size_ = 0;
+
+    tlx::simple_vector<size_t> disks_, order_;
+
+    void compute(size_t chunk_begin)
+    {
+        const size_t n = std::min(window_, length_ - chunk_begin);
+        BidIteratorType it = begin_ + chunk_begin;
+        for (size_t i = 0; i < n; ++i, ++it)
+            disks_[i] = it->storage->get_device_id();
+
+        compute_prefetch_schedule(
+            disks_.begin(), disks_.begin() + n, order_.begin(), m_, D_,
+            service_times_);
+        for (size_t i = 0; i < n; ++i)
+            order_[i] += chunk_begin;
+
+        chunk_begin_ = chunk_begin;
+        chunk_size_ = n;
+    }
+};
+
 } // namespace foxxll
 
 #endif // !FOXXLL_MNG_ASYNC_SCHEDULE_HEADER
@@ -0,0 +1,164 @@
+/***************************************************************************
+ *  foxxll/mng/block_alloc_strategy.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/io/device_topology.hpp>
+#include <foxxll/io/file.hpp>
+#include <foxxll/io/iostats.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+
+namespace foxxll {
+
+load_aware::load_aware(size_t begin, size_t end)
+    : begin_(begin), diff_(end - begin)
+{
+    refresh();
+}
+
+load_aware::load_aware()
+    : begin_(0), diff_(config::get_instance()->disks_number())
+{
+    refresh();
+}
+
+void load_aware::refresh()
+{
+    block_manager* bm = block_manager::get_instance();
+    config* cfg = config::get_instance();
+
+    // disks unknown to the block manager have no statistics
+    const size_t ndisks = bm->disks_number();
+
+    std::vector<double> speed(diff_, 0.0);
+    last_io_.resize(diff_);
+
+    for (size_t i = 0; i < diff_ && begin_ + i < ndisks; ++i)
+    {
+        file_stats* fs = bm->disk_file(begin_ + i)->get_file_stats();
+        const double bytes = static_cast<double>(
+            fs->get_read_bytes() + fs->get_write_bytes());
+        const double time = fs->get_read_time() + fs->get_write_time();
+
+        // prefer the throughput since the last refresh, if there was I/O
+        const double delta_bytes = bytes - last_io_[i].first;
+        const double delta_time = time - last_io_[i].second;
+
+        if (delta_bytes > 0 && delta_time > 0)
+            speed[i] = delta_bytes / delta_time;
+        else if (bytes > 0 && time > 0)
+            speed[i] = bytes / time;
+
+        last_io_[i] = std::make_pair(bytes, time);
+    }
+
+    // disks without history are assumed to be average
+    const size_t known = static_cast<size_t>(
+        std::count_if(speed.begin(), speed.end(),
+                      [](double s) { return s > 0; }));
+    const double average = known == 0 ? 1.0 :
+                           std::accumulate(speed.begin(), speed.end(), 0.0) / known;
+
+    weights_.resize(diff_);
+    std::vector<bool> draining(diff_, false);
+    for (size_t i = 0; i < diff_; ++i)
+    {
+        const size_t disk = begin_ + i;
+        double w = speed[i] > 0 ? speed[i] : average;
+
+        if (disk >= ndisks) {
+            weights_[i] = w;
+            continue;
+        }
+
+        // draining disks receive no new blocks
+        if (bm->is_draining(disk)) {
+            weights_[i] = 0.0;
+            draining[i] = true;
+            continue;
+        }
+
+        // penalize busy devices by their number of outstanding requests,
+        // counting all files on the same physical device. Each outstanding
+        // request costs a seek on rotational devices.
+        const device_topology& dev = bm->disk_device(disk);
+        size_t queued = 0, sharing = 0;
+        for (size_t d = 0; d < ndisks; ++d)
+        {
+            if (d != disk && !dev.same_device(bm->disk_device(d)))
+                continue;
+            queued += bm->disk_file(d)->get_request_nref();
+            ++sharing;
+        }
+        w /= 1.0 + static_cast<double>(queued) / (dev.rotational ? 1.0 : 4.0);
+
+        // without measurements, files on one device share its bandwidth
+        if (!(speed[i] > 0))
+            w /= static_cast<double>(sharing);
+
+        // fill fixed size disks proportionally to their free space
+        if (!cfg->disk(disk).autogrow) {
+            const uint64_t total = bm->total_bytes(disk);
+            w *= total == 0 ? 0.0 :
+                 static_cast<double>(bm->free_bytes(disk)) /
+                 static_cast<double>(total);
+        }
+
+        weights_[i] = w;
+    }
+
+    const double sum = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+    if (!(sum > 0))
+    {
+        // e.g. all fixed size disks are full: spread evenly, but never onto
+        // draining disks
+        if (diff_ != 0 &&
+            std::find(draining.begin(), draining.end(), false) == draining.end())
+        {
+            FOXXLL_THROW(
+                bad_ext_alloc,
+                "load_aware: all disks [" << begin_ << "," << begin_ + diff_
+                                          << ") are draining."
+            );
+        }
+        for (size_t i = 0; i < diff_; ++i)
+            weights_[i] = draining[i] ? 0.0 : 1.0;
+    }
+
+    // smooth weighted round-robin pattern, 16 slots per disk
+    pattern_.resize(16 * std::max<size_t>(diff_, 1));
+    std::vector<double> current(diff_, 0.0);
+    const double total = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+
+    for (size_t& slot : pattern_)
+    {
+        size_t best = 0;
+        for (size_t i = 0; i < diff_; ++i) {
+            current[i] += weights_[i];
+            if (current[i] > current[best])
+                best = i;
+        }
+        current[best] -= total;
+        slot = best;
+    }
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
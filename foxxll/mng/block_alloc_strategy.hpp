@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <random>
+#include <utility>
 #include <vector>
 
 #include <foxxll/mng/block_manager.hpp>
@@ -212,6 +213,61 @@ struct single_disk
     }
 };
 
+/*!
+ * Load-aware parallel disk block allocation scheme functor.
+ *
+ * Weights the disks by their measured throughput (from file_stats, recent
+ * since the last refresh() if available), divided by one plus a quarter of
+ * the current queue depth of their physical device (the full queue depth on
+ * rotational devices), and scaled by their free space fraction unless they
+ * autogrow. Blocks are distributed proportionally to the weights, in a
+ * smooth weighted round-robin pattern. Disks without I/O history get the
+ * average measured speed, split among the disks on the same device, and
+ * draining disks get no blocks. Throws bad_ext_alloc if all disks are
+ * draining. The weights are sampled on construction and
+ * by refresh(), so long-lived functors should be refreshed between
+ * allocations.
+ *
+ * \remarks model of \b allocation_strategy concept
+ */
+struct load_aware
+{
+    size_t begin_, diff_;
+
+    load_aware(size_t begin, size_t end);
+
+    load_aware();
+
+    size_t operator () (size_t i) const
+    {
+        return begin_ + pattern_[i % pattern_.size()];
+    }
+
+    //! sample speed, queue depth and free space of the disks again
+    void refresh();
+
+    //! current relative weight of disk begin + i
+    double weight(size_t i) const
+    {
+        return weights_[i];
+    }
+
+    static const char * name()
+    {
+        return "load-aware weighted striping";
+    }
+
+private:
+    //! weight of each disk
+    std::vector<double> weights_;
+
+    //! disk sequence with frequencies proportional to the weights
+    std::vector<size_t> pattern_;
+
+    //! transferred bytes and I/O time of each disk at the last refresh
+    std::vector<std::pair<double, double> > last_io_;
+};
+
 //! Allocator functor adapter.
 //!
 //! Gives offset to disk number sequence defined in constructor
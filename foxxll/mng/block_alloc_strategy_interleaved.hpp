@@ -104,6 +104,22 @@ struct interleaved_random_cyclic : public interleaved_striping
     }
 };
 
+struct interleaved_load_aware : public interleaved_striping
+{
+    load_aware strategy_;
+
+    interleaved_load_aware(int nruns, const load_aware& strategy)
+        : interleaved_striping(nruns, strategy.begin_, strategy.diff_),
+          strategy_(strategy)
+    { }
+
+    size_t operator () (size_t i) const
+    {
+        // walk the weighted pattern, each run starting at another position
+        return strategy_(i / nruns_ + i % nruns_);
+    }
+};
+
 struct first_disk_only : public interleaved_striping
 {
     first_disk_only(int nruns, const single_disk& strategy)
@@ -158,6 +174,12 @@ struct interleaved_alloc_traits<random_cyclic_flash>
     using strategy = interleaved_random_cyclic;
 };
 
+template <>
+struct interleaved_alloc_traits<load_aware>
+{
+    using strategy = interleaved_load_aware;
+};
+
 template <>
 struct interleaved_alloc_traits<single_disk>
 {
@@ -0,0 +1,578 @@
+/***************************************************************************
+ *  foxxll/mng/block_cache.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_BLOCK_CACHE_HEADER
+#define FOXXLL_MNG_BLOCK_CACHE_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tlx/die/core.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/io/request.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/write_pool.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Bounded cache of recently used blocks, shared by several data structures
+ * and threads.
+ *
+ * Blocks are pinned by BID with pin(), which reads them on a miss, and
+ * released with unpin(), optionally marking them dirty. Pinned blocks stay
+ * resident. Dirty blocks are written back through an internal write_pool
+ * when they are evicted, or by flush(); a miss on a block still being written
+ * back takes it from the write_pool without reading it.
+ *
+ * Replacement follows the Adaptive Replacement Cache (ARC) policy of Megiddo
+ * and Modha: blocks accessed once live in a recency list T1, blocks accessed
+ * again in a frequency list T2, and ghost lists B1 and B2 remember the BIDs
+ * recently evicted from either. Ghost hits shift the target size of T1, hence
+ * a sequential scan only cycles through T1 and does not evict the hot set
+ * from T2.
+ *
+ * All methods are thread-safe, a single mutex protects the cache state and
+ * is not held while waiting for reads or write-backs. A block whose read
+ * fails is dropped from the cache when its last pin is released by the
+ * exception.
+ */
+template <class BlockType>
+class block_cache
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_type = typename block_type::bid_type;
+    using write_pool_type = write_pool<block_type>;
+
+protected:
+    struct bid_hash
+    {
+        size_t operator () (const bid_type& bid) const noexcept
+        {
+            return size_t(bid.storage) + size_t(bid.offset & 0xffffffff) +
+                   size_t(bid.offset >> 32);
+        }
+    };
+
+    //! resident lists T1 (seen once) and T2 (seen again), ghost lists B1, B2
+    enum list_id { T1 = 0, T2 = 1, B1 = 2, B2 = 3 };
+
+    struct entry;
+    using list_type = std::list<entry*>;
+
+    struct entry
+    {
+        bid_type bid;
+        //! block frame, nullptr for ghosts
+        block_type* block = nullptr;
+        //! number of pins
+        size_t pins = 0;
+        //! block was modified since it was read or written
+        bool dirty = false;
+        //! outstanding read of the block
+        request_ptr req;
+        //! list holding the entry and position in it
+        list_id list = T1;
+        typename list_type::iterator pos;
+    };
+
+    using map_type = std::unordered_map<bid_type, entry, bid_hash>;
+
+    //! maximum number of resident blocks
+    size_t capacity_;
+
+    //! target size of T1, adapted by ghost hits
+    size_t target_t1_ = 0;
+
+    //! resident and ghost entries
+    map_type entries_;
+
+    //! the four lists, least recently used first
+    list_type lists_[4];
+
+    //! unused block frames
+    std::vector<block_type*> free_blocks_;
+
+    //! number of frames allocated by the cache, at most capacity_
+    size_t frames_ = 0;
+
+    //! write-back of evicted dirty blocks
+    write_pool_type w_pool_;
+
+    //! protects all members
+    mutable std::mutex mutex_;
+
+    //! \name Statistics
+    //! \{
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t evictions_ = 0;
+    size_t writebacks_ = 0;
+    //! \}
+
+    //! append a new entry at the most recently used end of a list
+    void link(entry& e, list_id list)
+    {
+        e.pos = lists_[list].insert(lists_[list].end(), &e);
+        e.list = list;
+    }
+
+    //! move entry to the most recently used end of a list
+    void move_to(entry& e, list_id list)
+    {
+        lists_[list].splice(lists_[list].end(), lists_[e.list], e.pos);
+        e.list = list;
+    }
+
+    //! remove an entry from its list and the map
+    void erase(entry& e)
+    {
+        const bid_type bid = e.bid;
+        lists_[e.list].erase(e.pos);
+        entries_.erase(bid);
+    }
+
+    //! evict the least recently used unpinned block of a resident list to
+    //! its ghost list, returns false if all are pinned
+    bool evict_from(list_id list)
+    {
+        for (entry* e : lists_[list])
+        {
+            if (e->pins != 0)
+                continue;
+
+            if (e->dirty)
+            {
+                // the write pool takes over the frame, a free frame is
+                // taken from it later without waiting under the lock
+                TLX_LOG << "block_cache: write back " << e->bid;
+                w_pool_.write(e->block, e->bid);
+                ++writebacks_;
+            }
+            else
+            {
+                free_blocks_.push_back(e->block);
+            }
+
+            TLX_LOG << "block_cache: evict " << e->bid;
+            e->block = nullptr;
+            e->dirty = false;
+            e->req = request_ptr();
+            move_to(*e, list == T1 ? B1 : B2);
+            ++evictions_;
+            return true;
+        }
+        return false;
+    }
+
+    //! ARC's REPLACE: evict from T1 or T2 depending on the target size of
+    //! T1, falling back to the other list if all blocks are pinned
+    void replace(bool ghost_in_b2)
+    {
+        const size_t t1 = lists_[T1].size();
+        const bool from_t1 =
+            t1 != 0 && (t1 > target_t1_ || (ghost_in_b2 && t1 == target_t1_));
+
+        if (!evict_from(from_t1 ? T1 : T2) && !evict_from(from_t1 ? T2 : T1)) {
+            FOXXLL_THROW(resource_error,
+                         "All " << capacity_ << " blocks of the cache are pinned.");
+        }
+    }
+
+    //! obtain a frame for a new resident block, expects mutex_ to be locked.
+    //! Returns nullptr if all free frames are still being written back.
+    block_type * get_frame(bool ghost_in_b2)
+    {
+        if (lists_[T1].size() + lists_[T2].size() >= capacity_)
+            replace(ghost_in_b2);
+
+        if (!free_blocks_.empty()) {
+            block_type* block = free_blocks_.back();
+            free_blocks_.pop_back();
+            return block;
+        }
+
+        if (frames_ < capacity_) {
+            ++frames_;
+            return new block_type;
+        }
+
+        return w_pool_.try_steal();
+    }
+
+    //! release the pin of a block whose read failed, the block is dropped
+    //! with its last pin
+    void read_failed(const bid_type& bid)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        typename map_type::iterator it = entries_.find(bid);
+        assert(it != entries_.end() && it->second.pins > 0);
+
+        entry& e = it->second;
+        if (--e.pins != 0)
+            return;
+
+        TLX_LOG << "block_cache: drop " << bid << " after a failed read";
+        free_blocks_.push_back(e.block);
+        erase(e);
+    }
+
+    //! wait for the request of a pinned block, dropping the pin if it failed
+    void wait(const bid_type& bid, const request_ptr& req)
+    {
+        if (!req.valid())
+            return;
+        try {
+            req->wait();
+        }
+        catch (...) {
+            read_failed(bid);
+            throw;
+        }
+    }
+
+    //! bound the ghost lists of a cache miss on a BID without history
+    void trim_ghosts()
+    {
+        const size_t l1 = lists_[T1].size() + lists_[B1].size();
+        const size_t total = l1 + lists_[T2].size() + lists_[B2].size();
+
+        if (l1 >= capacity_ && !lists_[B1].empty())
+            erase(*lists_[B1].front());
+        else if (total >= 2 * capacity_ && !lists_[B2].empty())
+            erase(*lists_[B2].front());
+    }
+
+public:
+    /*!
+     * Constructs an empty cache.
+     *
+     * \param capacity maximum number of resident blocks
+     * \param write_blocks number of blocks of the write-back pool
+     */
+    explicit block_cache(size_t capacity, size_t write_blocks = 2)
+        : capacity_(capacity), w_pool_(write_blocks)
+    {
+        tlx_die_unless(capacity > 0);
+        entries_.reserve(2 * capacity);
+    }
+
+    //! non-copyable: delete copy-constructor
+    block_cache(const block_cache&) = delete;
+    //! non-copyable: delete assignment operator
+    block_cache& operator = (const block_cache&) = delete;
+
+    //! Writes back dirty blocks and frees memory. All blocks must be unpinned.
+    ~block_cache()
+    {
+        try {
+            flush();
+        }
+        catch (...)
+        { }
+
+        for (auto& it : entries_)
+        {
+            if (!it.second.block)
+                continue;
+            assert(it.second.pins == 0);
+            if (it.second.req.valid())
+                it.second.req->wait();
+            delete it.second.block;
+        }
+        for (block_type* block : free_blocks_)
+            delete block;
+    }
+
+    /*!
+     * Pin a block and return it. On a miss the block is read, unless \b load
+     * is false, e.g. for newly allocated blocks which are overwritten
+     * completely. The block stays resident until unpin() is called as often
+     * as pin(). Throws resource_error if all cached blocks are pinned.
+     *
+     * \param bid address of the block
+     * \param load read the block on a miss
+     * \return the cached block, valid until it is unpinned
+     */
+    block_type * pin(const bid_type& bid, bool load = true)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        typename map_type::iterator it;
+        request_ptr req;
+        block_type* block = nullptr;
+        bool missed = false;
+
+        for ( ; ; )
+        {
+            it = entries_.find(bid);
+
+            if (it != entries_.end() && it->second.block)
+            {
+                // hit in T1 or T2
+                entry& e = it->second;
+                if (!missed)
+                    ++hits_;
+                move_to(e, T2);
+                ++e.pins;
+                block = e.block;
+                req = e.req;
+                lock.unlock();
+
+                // another thread may still be reading the block
+                wait(bid, req);
+                return block;
+            }
+
+            const bool ghost = (it != entries_.end());
+
+            if (!missed && ghost)
+            {
+                // ghost hit: adapt the target size of T1 in favour of the
+                // list the block was evicted from
+                const size_t b1 = lists_[B1].size(), b2 = lists_[B2].size();
+                if (it->second.list == B1) {
+                    const size_t delta = b1 >= b2 ? 1 : b2 / b1;
+                    target_t1_ = std::min(capacity_, target_t1_ + delta);
+                }
+                else {
+                    const size_t delta = b2 >= b1 ? 1 : b1 / b2;
+                    target_t1_ = target_t1_ > delta ? target_t1_ - delta : 0;
+                }
+            }
+            else if (!missed)
+            {
+                trim_ghosts();
+            }
+            if (!missed) {
+                ++misses_;
+                missed = true;
+            }
+
+            block = get_frame(ghost && it->second.list == B2);
+            if (block)
+                break;
+
+            // all free frames are being written back: wait for a write
+            // without the lock, then look the block up again
+            const size_t seen = w_pool_.completed_writes();
+            lock.unlock();
+            w_pool_.wait_for_write(seen);
+            lock.lock();
+        }
+
+        const bool ghost = (it != entries_.end());
+
+        // blocks seen again while remembered as ghosts go to T2
+        entry& e = ghost ? it->second : entries_[bid];
+        if (ghost) {
+            move_to(e, T2);
+        }
+        else {
+            e.bid = bid;
+            link(e, T1);
+        }
+        e.pins = 1;
+        e.dirty = !load;
+
+        if (w_pool_.has_request(bid))
+        {
+            // the block is still being written back: take it from the write
+            // pool in exchange for the frame, which also orders a later
+            // write after the pending one
+            std::pair<block_type*, request_ptr> wp = w_pool_.steal_request(bid);
+            TLX_LOG << "block_cache: " << bid << " was in write cache at " << wp.first;
+            w_pool_.add(block);
+            block = wp.first;
+            req = wp.second;
+        }
+        else if (load)
+        {
+            TLX_LOG << "block_cache: read " << bid;
+            req = block->read(bid);
+        }
+
+        e.block = block;
+        e.req = req;
+        lock.unlock();
+
+        wait(bid, req);
+        return block;
+    }
+
+    /*!
+     * Release a pinned block.
+     *
+     * \param bid address of the block
+     * \param dirty whether the block was modified and must be written back
+     */
+    void unpin(const bid_type& bid, bool dirty = false)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        typename map_type::iterator it = entries_.find(bid);
+        assert(it != entries_.end() && it->second.pins > 0);
+
+        entry& e = it->second;
+        --e.pins;
+        e.dirty = e.dirty || dirty;
+    }
+
+    /*!
+     * Drop a block from the cache without writing it back, e.g. when it is
+     * deleted. Returns false if the block is pinned or not cached.
+     */
+    bool invalidate(const bid_type& bid)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        typename map_type::iterator it = entries_.find(bid);
+        if (it == entries_.end() || it->second.pins != 0)
+            return false;
+
+        entry& e = it->second;
+        const bool resident = (e.block != nullptr);
+        if (resident)
+            free_blocks_.push_back(e.block);
+        erase(e);
+        return resident;
+    }
+
+    //! Write all dirty unpinned blocks and wait for completion, including
+    //! the write-backs of evicted blocks. The blocks stay cached. Blocks
+    //! whose write failed stay dirty, the first error is rethrown.
+    void flush()
+    {
+        std::vector<entry*> flushed;
+        std::vector<request_ptr> reqs;
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            try {
+                for (list_id list : { T1, T2 })
+                {
+                    for (entry* e : lists_[list])
+                    {
+                        if (!e->dirty || e->pins != 0)
+                            continue;
+                        reqs.push_back(e->block->write(e->bid));
+                        // pin the block until its write completed
+                        ++e->pins;
+                        e->dirty = false;
+                        flushed.push_back(e);
+                        ++writebacks_;
+                    }
+                }
+
+                // dirty blocks evicted before are written by the write pool
+                std::vector<request_ptr> evicted = w_pool_.pending_requests();
+                reqs.insert(reqs.end(), evicted.begin(), evicted.end());
+            }
+            catch (...) {
+                // wait for the writes submitted so far nevertheless
+                error = std::current_exception();
+            }
+        }
+
+        // wait for all writes, such that no pinned frame is still written
+        // when it is unpinned
+        std::vector<bool> failed(reqs.size(), false);
+        for (size_t i = 0; i < reqs.size(); ++i)
+        {
+            try {
+                reqs[i]->wait();
+            }
+            catch (...) {
+                failed[i] = true;
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < flushed.size(); ++i)
+            {
+                --flushed[i]->pins;
+                if (failed[i])
+                    flushed[i]->dirty = true;
+            }
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    //! maximum number of resident blocks
+    size_t capacity() const { return capacity_; }
+
+    //! Returns the number of resident blocks.
+    size_t size() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return lists_[T1].size() + lists_[T2].size();
+    }
+
+    //! \name Statistics
+    //! \{
+
+    //! number of pin() calls finding the block resident
+    size_t hits() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return hits_;
+    }
+
+    //! number of pin() calls loading the block
+    size_t misses() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+    //! number of blocks evicted from the cache
+    size_t evictions() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return evictions_;
+    }
+
+    //! number of dirty blocks written back
+    size_t writebacks() const
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return writebacks_;
+    }
+
+    //! \}
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_BLOCK_CACHE_HEADER
+
+/**************************************************************************/
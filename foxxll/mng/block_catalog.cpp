@@ -0,0 +1,518 @@
+/***************************************************************************
+ *  foxxll/mng/block_catalog.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <tlx/logger/core.hpp>
+#include <tlx/unused.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/config.hpp>
+#include <foxxll/mng/block_catalog.hpp>
+
+#if !FOXXLL_WINDOWS
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace foxxll {
+
+//! "FOXXLLCT" in little endian
+static constexpr uint64_t superblock_magic = 0x54434C4C58584F46ull;
+static constexpr uint64_t superblock_version = 2;
+
+//! marks blocks of a sequence not yet read from any superblock
+static constexpr size_t no_disk = static_cast<size_t>(-1);
+
+namespace {
+
+//! appends integers and strings to a superblock image
+class superblock_writer
+{
+public:
+    void put(uint64_t v)
+    {
+        data_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    void put(const std::string& s)
+    {
+        put(s.size());
+        data_.append(s);
+    }
+
+    const std::string& data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+//! reads integers and strings from a superblock image
+class superblock_reader
+{
+public:
+    superblock_reader(const std::string& path, std::string&& data)
+        : path_(path), data_(std::move(data)) { }
+
+    uint64_t get()
+    {
+        uint64_t v;
+        check(sizeof(v));
+        std::copy(data_.data() + pos_, data_.data() + pos_ + sizeof(v),
+                  reinterpret_cast<char*>(&v));
+        pos_ += sizeof(v);
+        return v;
+    }
+
+    std::string get_string()
+    {
+        const uint64_t size = get();
+        check(size);
+        std::string s = data_.substr(pos_, size);
+        pos_ += size;
+        return s;
+    }
+
+private:
+    std::string path_;
+    std::string data_;
+    size_t pos_ = 0;
+
+    void check(uint64_t bytes) const
+    {
+        if (bytes > data_.size() - pos_)
+            FOXXLL_THROW(io_error, "Truncated catalog superblock " << path_);
+    }
+};
+
+//! a superblock file read from disk
+struct superblock_file {
+    std::string path;
+    std::string data;
+};
+
+//! write a file and flush it to stable storage
+void write_synced(const std::string& path, const std::string& data)
+{
+#if !FOXXLL_WINDOWS
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        FOXXLL_THROW_ERRNO(io_error, "Error creating catalog " << path);
+
+    size_t done = 0;
+    while (done < data.size())
+    {
+        const ssize_t rc = ::write(fd, data.data() + done, data.size() - done);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc < 0) {
+            const int err = errno;
+            ::close(fd);
+            FOXXLL_THROW_ERRNO2(io_error, "Error writing catalog " << path, err);
+        }
+        done += static_cast<size_t>(rc);
+    }
+
+    if (::fsync(fd) != 0) {
+        const int err = errno;
+        ::close(fd);
+        FOXXLL_THROW_ERRNO2(io_error, "Error syncing catalog " << path, err);
+    }
+    if (::close(fd) != 0)
+        FOXXLL_THROW_ERRNO(io_error, "Error closing catalog " << path);
+#else
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out.flush();
+    if (!out.good())
+        FOXXLL_THROW_ERRNO(io_error, "Error writing catalog " << path);
+#endif
+}
+
+//! flush the directory entry of a renamed file to stable storage
+void sync_directory(const std::string& path)
+{
+#if !FOXXLL_WINDOWS
+    const size_t slash = path.rfind('/');
+    const std::string dir =
+        slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+
+    const int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0)
+        FOXXLL_THROW_ERRNO(io_error, "Error opening directory " << dir);
+    if (::fsync(fd) != 0) {
+        const int err = errno;
+        ::close(fd);
+        FOXXLL_THROW_ERRNO2(io_error, "Error syncing directory " << dir, err);
+    }
+    ::close(fd);
+#else
+    tlx::unused(path);
+#endif
+}
+
+//! rename a file over another one
+void replace_file(const std::string& from, const std::string& to)
+{
+#if FOXXLL_WINDOWS
+    std::remove(to.c_str());
+#endif
+    if (std::rename(from.c_str(), to.c_str()) != 0)
+        FOXXLL_THROW_ERRNO(io_error, "Error replacing catalog " << to);
+}
+
+//! read the generation of a superblock file, returns false if it does not
+//! exist or is invalid
+bool read_generation(const std::string& path, uint64_t& generation)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    uint64_t header[3];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in.good() || header[0] != superblock_magic ||
+        header[1] != superblock_version)
+        return false;
+
+    generation = header[2];
+    return true;
+}
+
+//! read a superblock of disk d into extents and sequences
+void parse_superblock(
+    const superblock_file& file, size_t d, const std::string& disk_path,
+    std::vector<block_catalog::extent>& extents,
+    std::map<std::string, block_catalog::sequence>& sequences)
+{
+    superblock_reader sb(file.path, std::string(file.data));
+
+    // magic, version and generation were checked before
+    sb.get(), sb.get(), sb.get();
+
+    if (sb.get_string() != disk_path) {
+        FOXXLL_THROW(io_error, "Catalog superblock " << file.path <<
+                     " does not match the disk configuration.");
+    }
+
+    for (uint64_t n = sb.get(); n != 0; --n) {
+        const uint64_t offset = sb.get();
+        extents.emplace_back(offset, sb.get());
+    }
+
+    for (uint64_t n = sb.get(); n != 0; --n)
+    {
+        const std::string name = sb.get_string();
+        const uint64_t block_size = sb.get();
+        const uint64_t length = sb.get();
+
+        block_catalog::sequence& seq = sequences[name];
+        if (seq.blocks.empty()) {
+            seq.block_size = block_size;
+            seq.blocks.resize(length, block_catalog::location(no_disk, 0));
+        }
+        else if (seq.block_size != block_size ||
+                 seq.blocks.size() != length)
+        {
+            FOXXLL_THROW(io_error, "Catalog superblock " << file.path <<
+                         " disagrees about sequence " << name);
+        }
+
+        for (uint64_t k = sb.get(); k != 0; --k) {
+            const uint64_t pos = sb.get();
+            const uint64_t offset = sb.get();
+            if (pos >= length) {
+                FOXXLL_THROW(io_error, "Invalid block in catalog "
+                             "superblock " << file.path);
+            }
+            seq.blocks[pos] = block_catalog::location(d, offset);
+        }
+    }
+}
+
+} // namespace
+
+void block_catalog::put(const std::string& name, sequence&& seq)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    sequences_[name] = std::move(seq);
+}
+
+bool block_catalog::get(const std::string& name, sequence& seq) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = sequences_.find(name);
+    if (it == sequences_.end())
+        return false;
+    seq = it->second;
+    return true;
+}
+
+bool block_catalog::erase(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return sequences_.erase(name) != 0;
+}
+
+std::vector<std::string> block_catalog::names() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<std::string> result;
+    for (const auto& seq : sequences_)
+        result.push_back(seq.first);
+    return result;
+}
+
+std::string block_catalog::superblock_path(const std::string& disk_path)
+{
+    return disk_path + ".catalog";
+}
+
+std::string block_catalog::previous_path(const std::string& disk_path)
+{
+    return superblock_path(disk_path) + ".prev";
+}
+
+std::vector<std::vector<block_catalog::extent> >
+block_catalog::extents(size_t ndisks) const
+{
+    std::vector<std::vector<extent> > result(ndisks);
+    for (const auto& seq : sequences_) {
+        for (const location& loc : seq.second.blocks)
+            result[loc.first].emplace_back(loc.second, seq.second.block_size);
+    }
+
+    // sort and merge adjacent and duplicate extents
+    for (std::vector<extent>& list : result)
+    {
+        std::sort(list.begin(), list.end());
+        size_t out = 0;
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            if (out != 0 &&
+                list[out - 1].first + list[out - 1].second >= list[i].first)
+            {
+                list[out - 1].second = std::max(
+                    list[out - 1].second,
+                    list[i].first + list[i].second - list[out - 1].first);
+            }
+            else {
+                list[out++] = list[i];
+            }
+        }
+        list.resize(out);
+    }
+    return result;
+}
+
+void block_catalog::save(const std::vector<std::string>& disk_paths)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const size_t ndisks = disk_paths.size();
+    const std::vector<std::vector<extent> > disk_extents = extents(ndisks);
+
+    // reserve the number, a retry after a failure must not reuse it for
+    // different contents
+    const uint64_t generation = ++generation_;
+
+    // write all superblocks to temporary files on stable storage first
+    for (size_t d = 0; d < ndisks; ++d)
+    {
+        if (disk_paths[d].empty()) {
+            if (!disk_extents[d].empty()) {
+                FOXXLL_THROW(io_error, "Catalogued blocks on disk " << d <<
+                             " which has no catalog.");
+            }
+            continue;
+        }
+
+        superblock_writer sb;
+        sb.put(superblock_magic);
+        sb.put(superblock_version);
+        sb.put(generation);
+        sb.put(disk_paths[d]);
+
+        sb.put(disk_extents[d].size());
+        for (const extent& e : disk_extents[d]) {
+            sb.put(e.first);
+            sb.put(e.second);
+        }
+
+        sb.put(sequences_.size());
+        for (const auto& seq : sequences_)
+        {
+            sb.put(seq.first);
+            sb.put(seq.second.block_size);
+            sb.put(seq.second.blocks.size());
+
+            const std::vector<location>& blocks = seq.second.blocks;
+            sb.put(std::count_if(
+                       blocks.begin(), blocks.end(),
+                       [d](const location& loc) { return loc.first == d; }));
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                if (blocks[i].first != d) continue;
+                sb.put(i);
+                sb.put(blocks[i].second);
+            }
+        }
+
+        write_synced(superblock_path(disk_paths[d]) + ".tmp", sb.data());
+    }
+
+    // then replace the superblocks, keeping the last complete generation as
+    // previous one. At any time, it is current or previous on all disks.
+    for (size_t d = 0; d < ndisks; ++d)
+    {
+        if (disk_paths[d].empty()) continue;
+
+        const std::string path = superblock_path(disk_paths[d]);
+        const std::string prev = previous_path(disk_paths[d]);
+
+        // a failed save may have left an incomplete generation as current
+        // superblock, the complete one is already the previous superblock
+        uint64_t current;
+        if (!read_generation(path, current) || current == committed_)
+        {
+#if FOXXLL_WINDOWS
+            std::remove(prev.c_str());
+#endif
+            if (std::rename(path.c_str(), prev.c_str()) != 0 && errno != ENOENT)
+                FOXXLL_THROW_ERRNO(io_error, "Error replacing catalog " << prev);
+        }
+        replace_file(path + ".tmp", path);
+        sync_directory(path);
+    }
+
+    committed_ = generation;
+
+    TLX_LOG << "block_catalog: saved generation " << generation << " with "
+            << sequences_.size() << " sequences";
+}
+
+std::vector<std::vector<block_catalog::extent> >
+block_catalog::load(const std::vector<std::string>& disk_paths)
+{
+    const size_t ndisks = disk_paths.size();
+
+    // current and previous superblock of each disk by generation
+    std::vector<std::map<uint64_t, superblock_file> > files(ndisks);
+    std::set<uint64_t> generations = { 0 };
+
+    for (size_t d = 0; d < ndisks; ++d)
+    {
+        if (disk_paths[d].empty()) continue;
+
+        for (const std::string& path :
+             { superblock_path(disk_paths[d]), previous_path(disk_paths[d]) })
+        {
+            std::ifstream in(path.c_str(), std::ios::binary);
+            if (!in.good()) continue;
+
+            std::ostringstream oss;
+            oss << in.rdbuf();
+            superblock_file file { path, oss.str() };
+
+            superblock_reader sb(path, std::string(file.data));
+            if (sb.get() != superblock_magic || sb.get() != superblock_version)
+                FOXXLL_THROW(io_error, "Invalid catalog superblock " << path);
+
+            const uint64_t gen = sb.get();
+            files[d].emplace(gen, std::move(file));
+            generations.insert(gen);
+        }
+    }
+
+    // choose the newest generation which is present on all disks with
+    // superblocks and complete. Disks without superblocks hold no catalogued
+    // blocks, e.g. disks added since. Before the first generation was
+    // written completely, the empty generation 0 is present.
+    auto present = [&files](size_t d, uint64_t gen) {
+        return files[d].empty() || files[d].count(gen) != 0 ||
+               (gen == 0 && files[d].rbegin()->first <= 1);
+    };
+
+    std::vector<std::vector<extent> > disk_extents;
+    std::map<std::string, sequence> sequences;
+    uint64_t generation = 0;
+    bool complete = false;
+
+    for (auto g = generations.rbegin(); g != generations.rend() && !complete; ++g)
+    {
+        generation = *g;
+        bool all = true;
+        for (size_t d = 0; d < ndisks; ++d)
+            all = all && present(d, generation);
+        if (!all) continue;
+
+        disk_extents.assign(ndisks, std::vector<extent>());
+        sequences.clear();
+        for (size_t d = 0; d < ndisks; ++d)
+        {
+            auto f = files[d].find(generation);
+            if (f != files[d].end()) {
+                parse_superblock(f->second, d, disk_paths[d],
+                                 disk_extents[d], sequences);
+            }
+        }
+
+        complete = true;
+        for (const auto& seq : sequences) {
+            for (const location& loc : seq.second.blocks)
+                complete = complete && loc.first != no_disk;
+        }
+        if (!complete) {
+            TLX_LOG1 << "foxxll: Catalog generation " << generation
+                     << " is missing blocks, trying an older one";
+        }
+    }
+
+    if (!complete)
+        FOXXLL_THROW(io_error, "Catalog superblocks of some disks are missing.");
+
+    // roll back partially written newer generations, such that the next
+    // save() keeps the chosen one as previous generation
+    for (size_t d = 0; d < ndisks; ++d)
+    {
+        if (files[d].empty() || files[d].rbegin()->first == generation)
+            continue;
+
+        const std::string path = superblock_path(disk_paths[d]);
+        auto f = files[d].find(generation);
+        if (f == files[d].end())
+            std::remove(path.c_str());
+        else if (f->second.path != path)
+            replace_file(f->second.path, path);
+        sync_directory(path);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    sequences_.swap(sequences);
+    generation_ = std::max(generation_, *generations.rbegin());
+    committed_ = generation;
+
+    if (generation != 0) {
+        TLX_LOG1 << "foxxll: Reattached catalog generation " << generation
+                 << " with " << sequences_.size() << " sequences";
+    }
+
+    return disk_extents;
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
@@ -0,0 +1,124 @@
+/***************************************************************************
+ *  foxxll/mng/block_catalog.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_BLOCK_CATALOG_HEADER
+#define FOXXLL_MNG_BLOCK_CATALOG_HEADER
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * Persistent catalog of named BID sequences.
+ *
+ * Each disk configured with the "catalog" option has a superblock file
+ * "<path>.catalog" next to it, holding the allocated extents of the disk and
+ * the catalogued blocks on the disk. A later process with the same disk
+ * configuration reads the superblocks, marks the extents as allocated and can
+ * look up the sequences by name. Blocks which are not catalogued are free in
+ * the later process.
+ *
+ * Superblocks carry a generation number and are written by save(), first to
+ * temporary files synced to disk, which are then renamed over the current
+ * ones. The current superblock of each disk is kept as "<path>.catalog.prev".
+ * After a crash during save(), some disks hold the new and some the previous
+ * generation, load() then takes the newest generation present on all disks.
+ * A save() after a failed one uses a new generation number and keeps the last
+ * complete generation as previous superblock.
+ * Superblocks are matched to disks by path, disks without superblocks, e.g.
+ * disks added since, hold no catalogued blocks.
+ *
+ * Blocks are stored as pairs (disk number, offset), the conversion from and
+ * to BIDs is done by block_manager.
+ */
+class block_catalog
+{
+    static constexpr bool debug = false;
+
+public:
+    //! location of a block: disk number and offset
+    using location = std::pair<size_t, uint64_t>;
+
+    //! extent of allocated space on a disk: offset and size
+    using extent = std::pair<uint64_t, uint64_t>;
+
+    //! a named BID sequence
+    struct sequence {
+        //! size of each block in bytes
+        uint64_t block_size = 0;
+        //! locations of the blocks
+        std::vector<location> blocks;
+    };
+
+    //! add or replace a sequence
+    void put(const std::string& name, sequence&& seq);
+
+    //! look up a sequence, returns false if it does not exist
+    bool get(const std::string& name, sequence& seq) const;
+
+    //! remove a sequence, returns false if it does not exist
+    bool erase(const std::string& name);
+
+    //! names of all sequences
+    std::vector<std::string> names() const;
+
+    //! Write the superblocks of all disks with non-empty path in disk_paths,
+    //! all catalogued blocks must be on these disks. Throws io_error.
+    void save(const std::vector<std::string>& disk_paths);
+
+    //! Read the superblocks of all disks with non-empty path in disk_paths and
+    //! replace the catalog. Returns the extents to be claimed on each disk.
+    //! Throws io_error if the superblocks are corrupt or inconsistent.
+    std::vector<std::vector<extent> > load(
+        const std::vector<std::string>& disk_paths);
+
+    //! superblock file of a disk
+    static std::string superblock_path(const std::string& disk_path);
+
+    //! superblock file of the previous generation of a disk
+    static std::string previous_path(const std::string& disk_path);
+
+private:
+    //! protects sequences_
+    mutable std::mutex mutex_;
+
+    //! sequences by name
+    std::map<std::string, sequence> sequences_;
+
+    //! last generation number used by save() or loaded, failed saves
+    //! consume their number, too
+    uint64_t generation_ = 0;
+
+    //! newest generation complete on all disks. After a failed save() it is
+    //! kept as previous superblock where a newer one became current.
+    uint64_t committed_ = 0;
+
+    //! merged extents of all catalogued blocks on each disk. Expects mutex_
+    //! to be locked.
+    std::vector<std::vector<extent> > extents(size_t ndisks) const;
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_BLOCK_CATALOG_HEADER
+
+/**************************************************************************/
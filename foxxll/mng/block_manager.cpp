@@ -12,8 +12,13 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <tlx/logger/core.hpp>
 
@@ -30,6 +35,63 @@ namespace foxxll {
 
 class io_error;
 
+//! protects block_manager::magazines_ and bid_magazines::owner_
+static std::mutex s_magazines_mutex;
+
+/*!
+ * Per-thread cache of free blocks, one magazine of offsets per disk and block
+ * size. Accessed by its thread, and by others only to drain it.
+ */
+class bid_magazines
+{
+public:
+    //! (disk, block size) -> offsets of free blocks
+    using magazine_map = std::map<std::pair<size_t, uint64_t>,
+                                  std::vector<uint64_t> >;
+
+    //! block manager this set is registered with
+    block_manager* owner_ = nullptr;
+
+    //! protects magazines_ against draining by other threads
+    std::mutex mutex_;
+
+    magazine_map magazines_;
+
+    //! return all blocks to the disk allocators, expects mutex_ to be locked
+    uint64_t drain()
+    {
+        uint64_t bytes = 0;
+        for (auto& mag : magazines_)
+        {
+            const size_t disk = mag.first.first;
+            const uint64_t size = mag.first.second;
+            for (const uint64_t& offset : mag.second) {
+                owner_->block_allocators_[disk]->delete_block(
+                    BID<0>(nullptr, offset, static_cast<size_t>(size)));
+            }
+            bytes += size * mag.second.size();
+            mag.second.clear();
+        }
+        return bytes;
+    }
+
+    ~bid_magazines()
+    {
+        std::unique_lock<std::mutex> reg_lock(s_magazines_mutex);
+        if (!owner_)
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        drain();
+
+        std::vector<bid_magazines*>& list = owner_->magazines_;
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    }
+};
+
+//! the calling thread's magazines
+static thread_local bid_magazines s_local_magazines;
+
 block_manager::block_manager()
 {
     config* config = config::get_instance();
@@ -37,55 +99,193 @@ block_manager::block_manager()
     // initialize config (may read config files now)
     config->check_initialized();
 
-    // allocate block_allocators_
-    ndisks_ = config->disks_number();
-    block_allocators_.resize(ndisks_);
-    disk_files_.resize(ndisks_);
+    // allocate per-disk arrays with room for disks added later
+    const size_t ndisks = config->disks_number();
+    capacity_ = ndisks > max_disks ? ndisks : max_disks;
+    block_allocators_.resize(capacity_);
+    disk_files_.resize(capacity_);
+    devices_.resize(capacity_);
+    draining_.reset(new std::atomic<bool>[capacity_]);
+    catalog_paths_.reserve(capacity_);
+    // config entries must not move while disks are appended
+    config->reserve_disks(capacity_);
+
+    for (size_t i = 0; i < capacity_; ++i) {
+        block_allocators_[i] = nullptr;
+        draining_[i] = false;
+    }
 
     uint64_t total_size = 0;
 
-    for (size_t i = 0; i < ndisks_; ++i)
+    for (size_t i = 0; i < ndisks; ++i)
     {
-        disk_config& cfg = config->disk(i);
-
-        // assign queues in order of disks.
-        if (cfg.queue == file::DEFAULT_QUEUE)
-            cfg.queue = i;
+        open_disk(i, config->disk(i));
+        total_size += config->disk(i).size;
+    }
 
-        try
-        {
-            disk_files_[i] = create_file(cfg, file::CREAT | file::RDWR, i);
+    // reattach to the blocks catalogued by earlier processes
+    const bool has_catalog =
+        std::any_of(catalog_paths_.begin(), catalog_paths_.end(),
+                    [](const std::string& path) { return !path.empty(); });
 
-            TLX_LOG1 << "foxxll: Disk '" << cfg.path << "' is allocated, space: "
-                     << (cfg.size) / (1024 * 1024)
-                     << " MiB, I/O implementation: " << cfg.fileio_string();
+    if (has_catalog)
+    {
+        std::vector<std::vector<block_catalog::extent> > extents =
+            catalog_.load(catalog_paths_);
+
+        for (size_t i = 0; i < ndisks_; ++i) {
+            for (const block_catalog::extent& e : extents[i]) {
+                block_allocators_[i]->claim_region(e.first, e.second);
+                add_allocation(e.second);
+            }
         }
-        catch (io_error&)
+    }
+
+    if (ndisks_ > 1)
+    {
+        TLX_LOG1 << "foxxll: In total " << ndisks_ << " disks are allocated, space: "
+                 << (total_size / (1024 * 1024)) << " MiB";
+    }
+}
+
+void block_manager::open_disk(size_t i, disk_config& cfg)
+{
+    config* config = config::get_instance();
+    assert(i == ndisks_ && i < capacity_);
+
+    if (cfg.io_impl != "memory")
+        devices_[i] = device_topology::discover(cfg.path);
+
+    // assign queues in order of disks, files on the same physical device
+    // share the queue and device id of the first one.
+    if (cfg.queue == file::DEFAULT_QUEUE)
+    {
+        cfg.queue = static_cast<int>(i);
+
+        for (size_t j = 0; j < i; ++j)
         {
-            TLX_LOG1 << "foxxll: Error allocating disk '" << cfg.path << "', space: "
-                     << (cfg.size) / (1024 * 1024)
-                     << " MiB, I/O implementation: " << cfg.fileio_string();
-            throw;
+            if (!shared_queue_[j] || !devices_[i].same_device(devices_[j]))
+                continue;
+
+            cfg.queue = config->disk(j).queue;
+            if (cfg.device_id == file::DEFAULT_DEVICE_ID)
+                cfg.device_id = config->disk(j).device_id;
+
+            TLX_LOG1 << "foxxll: Disk '" << cfg.path << "' shares device "
+                     << devices_[i].name << " with disk '"
+                     << config->disk(j).path << "'";
+            break;
         }
+        shared_queue_.push_back(true);
+    }
+    else {
+        shared_queue_.push_back(false);
+    }
 
-        total_size += cfg.size;
+    try
+    {
+        disk_files_[i] = create_file(cfg, file::CREAT | file::RDWR, i);
+
+        TLX_LOG1 << "foxxll: Disk '" << cfg.path << "' is allocated, space: "
+                 << (cfg.size) / (1024 * 1024)
+                 << " MiB, I/O implementation: " << cfg.fileio_string();
+    }
+    catch (io_error&)
+    {
+        TLX_LOG1 << "foxxll: Error allocating disk '" << cfg.path << "', space: "
+                 << (cfg.size) / (1024 * 1024)
+                 << " MiB, I/O implementation: " << cfg.fileio_string();
+        shared_queue_.pop_back();
+        throw;
+    }
 
-        // create queue for the file.
-        disk_queues::get_instance()->make_queue(disk_files_[i].get());
+    // create queue for the file.
+    disk_queues::get_instance()->make_queue(disk_files_[i].get());
 
-        block_allocators_[i] = new disk_block_allocator(disk_files_[i].get(), cfg);
+    block_allocators_[i] = new disk_block_allocator(disk_files_[i].get(), cfg);
+
+    catalog_paths_.push_back(cfg.catalog ? cfg.path : std::string());
+
+    // publish the disk to lock-free readers
+    ndisks_ = i + 1;
+}
+
+size_t block_manager::add_disk(const disk_config& cfg)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const size_t i = ndisks_;
+    if (i >= capacity_) {
+        FOXXLL_THROW_INVALID_ARGUMENT(
+            "Cannot add disk '" << cfg.path << "', " << capacity_
+                                << " disks are in use.");
     }
 
-    if (ndisks_ > 1)
+    // disk indices are positions in the config, hence a regular disk cannot
+    // be inserted before flash devices
+    const std::pair<unsigned, unsigned> flash =
+        config::get_instance()->flash_range();
+    if (!cfg.flash && flash.first != flash.second) {
+        FOXXLL_THROW_INVALID_ARGUMENT(
+            "Cannot add regular disk '" << cfg.path << "' after "
+                                        << flash.second - flash.first
+                                        << " flash devices.");
+    }
+
+    // the config entry is added once the disk is open, with its queue set
+    disk_config new_cfg = cfg;
+    open_disk(i, new_cfg);
+    config::get_instance()->append_disk(new_cfg);
+
+    TLX_LOG1 << "foxxll: Added disk " << i << " '" << cfg.path
+             << "' at runtime";
+
+    return i;
+}
+
+void block_manager::set_draining(size_t disk, bool draining)
+{
     {
-        TLX_LOG1 << "foxxll: In total " << ndisks_ << " disks are allocated, space: "
-                 << (total_size / (1024 * 1024)) << " MiB";
+        std::unique_lock<std::mutex> lock(mutex_);
+        assert(disk < ndisks_);
+        draining_[disk] = draining;
     }
+
+    TLX_LOG1 << "foxxll: Disk " << disk
+             << (draining ? " is draining" : " accepts new blocks");
+
+    // blocks cached for the disk would otherwise be handed out again
+    if (draining)
+        drain_magazines();
+}
+
+bool block_manager::is_draining(size_t disk) const
+{
+    assert(disk < ndisks_);
+    return draining_[disk];
 }
 
 block_manager::~block_manager()
 {
     TLX_LOG << "foxxll: Block manager destructor";
+
+    try {
+        catalog_commit();
+    }
+    catch (std::exception& e) {
+        TLX_LOG1 << "foxxll: Error writing block catalog: " << e.what();
+    }
+
+    {
+        // detach magazines of all threads, their blocks vanish with the disks
+        std::unique_lock<std::mutex> reg_lock(s_magazines_mutex);
+        for (bid_magazines* mags : magazines_) {
+            std::unique_lock<std::mutex> lock(mags->mutex_);
+            mags->magazines_.clear();
+            mags->owner_ = nullptr;
+        }
+        magazines_.clear();
+    }
     for (size_t i = ndisks_; i > 0; )
     {
         --i;
@@ -94,6 +294,97 @@ block_manager::~block_manager()
     }
 }
 
+void block_manager::catalog_commit()
+{
+    std::vector<std::string> paths;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        paths = catalog_paths_;
+    }
+    if (std::any_of(paths.begin(), paths.end(),
+                    [](const std::string& path) { return !path.empty(); }))
+        catalog_.save(paths);
+}
+
+bool block_manager::catalog_erase(const std::string& name)
+{
+    return catalog_.erase(name);
+}
+
+std::vector<std::string> block_manager::catalog_names() const
+{
+    return catalog_.names();
+}
+
+file* block_manager::disk_file(size_t disk) const
+{
+    // slots of disk files are never reallocated, no locking required
+    assert(disk < ndisks_);
+    return disk_files_[disk].get();
+}
+
+const device_topology& block_manager::disk_device(size_t disk) const
+{
+    assert(disk < ndisks_);
+    return devices_[disk];
+}
+
+std::vector<double> block_manager::device_service_times(size_t block_size) const
+{
+    // fewer reads are dominated by noise and cold caches
+    constexpr unsigned min_reads = 16;
+
+    config* cfg = config::get_instance();
+    const size_t ndisks = ndisks_;
+
+    std::vector<double> seconds(cfg->max_device_id(), 0.0);
+    std::vector<size_t> files(seconds.size(), 0);
+    bool any = false;
+
+    for (size_t i = 0; i < ndisks; ++i)
+    {
+        const file_stats* fs = disk_files_[i]->get_file_stats();
+        const size_t devid = disk_files_[i]->get_device_id();
+        if (devid >= seconds.size())
+            continue;
+
+        double time = 0.0;
+        if (fs && fs->get_read_count() >= min_reads && fs->get_read_bytes() > 0)
+        {
+            time = fs->get_read_time() * static_cast<double>(block_size)
+                   / static_cast<double>(fs->get_read_bytes());
+        }
+        else if (i < cfg->disks_number() && cfg->disk(i).bandwidth != 0)
+        {
+            time = static_cast<double>(block_size)
+                   / static_cast<double>(cfg->disk(i).bandwidth);
+        }
+        if (time <= 0.0)
+            continue;
+
+        // files sharing a device: average their estimates
+        seconds[devid] += time;
+        ++files[devid];
+        any = true;
+    }
+
+    if (!any)
+        return std::vector<double>();
+
+    for (size_t d = 0; d < seconds.size(); ++d)
+    {
+        if (files[d] > 1)
+            seconds[d] /= static_cast<double>(files[d]);
+    }
+    return seconds;
+}
+
+size_t block_manager::disks_number() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return ndisks_;
+}
+
 uint64_t block_manager::total_bytes() const
 {
     std::unique_lock<std::mutex> lock(mutex_);
@@ -106,6 +397,13 @@ uint64_t block_manager::total_bytes() const
     return total;
 }
 
+uint64_t block_manager::total_bytes(size_t disk) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(disk < ndisks_);
+    return block_allocators_[disk]->total_bytes();
+}
+
 uint64_t block_manager::free_bytes() const
 {
     std::unique_lock<std::mutex> lock(mutex_);
@@ -113,29 +411,196 @@ uint64_t block_manager::free_bytes() const
     uint64_t total = 0;
 
     for (size_t i = 0; i < ndisks_; ++i)
-        total += block_allocators_[i]->free_bytes();
+        total += block_allocators_[i]->free_bytes() + cached_bytes(i);
 
     return total;
 }
 
-uint64_t block_manager::total_allocation() const
+uint64_t block_manager::free_bytes(size_t disk) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(disk < ndisks_);
+    return block_allocators_[disk]->free_bytes() + cached_bytes(disk);
+}
+
+bool block_manager::has_available_space(size_t disk, uint64_t bytes) const
 {
     std::unique_lock<std::mutex> lock(mutex_);
+    assert(disk < ndisks_);
+    return !draining_[disk] &&
+           block_allocators_[disk]->has_available_space(bytes);
+}
+
+uint64_t block_manager::total_allocation() const
+{
     return total_allocation_;
 }
 
 uint64_t block_manager::current_allocation() const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
     return current_allocation_;
 }
 
 uint64_t block_manager::maximum_allocation() const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
     return maximum_allocation_;
 }
 
+void block_manager::add_allocation(uint64_t bytes)
+{
+    total_allocation_ += bytes;
+    const uint64_t current = current_allocation_ += bytes;
+
+    uint64_t maximum = maximum_allocation_;
+    while (maximum < current &&
+           !maximum_allocation_.compare_exchange_weak(maximum, current)) { }
+}
+
+//! number of blocks of given size a magazine holds, zero if not cached
+static uint64_t magazine_capacity(uint64_t size)
+{
+    if (size == 0)
+        return 0;
+    const uint64_t blocks = block_manager::magazine_bytes / size;
+    if (blocks < 2)
+        return 0;
+    if (blocks > block_manager::magazine_blocks)
+        return block_manager::magazine_blocks;
+    return blocks;
+}
+
+bool block_manager::alloc_cached(size_t disk, uint64_t size, uint64_t& offset)
+{
+    const uint64_t capacity = magazine_capacity(size);
+    if (capacity == 0 || disk >= ndisks_ || draining_[disk])
+        return false;
+
+    bid_magazines& mags = s_local_magazines;
+    std::unique_lock<std::mutex> lock(mags.mutex_);
+
+    if (mags.owner_ != this)
+    {
+        // first use by this thread: register magazines
+        lock.unlock();
+        std::unique_lock<std::mutex> reg_lock(s_magazines_mutex);
+        lock.lock();
+        if (mags.owner_ != this) {
+            assert(mags.owner_ == nullptr);
+            mags.owner_ = this;
+            magazines_.push_back(&mags);
+        }
+    }
+
+    std::vector<uint64_t>& mag = mags.magazines_[std::make_pair(disk, size)];
+
+    if (mag.empty())
+    {
+        // refill half of the magazine with a contiguous run of blocks
+        const uint64_t refill = capacity / 2;
+        if (!block_allocators_[disk]->has_available_space(refill * size))
+            return false;
+
+        std::vector<BID<0> > bids(
+            refill, BID<0>(nullptr, 0, static_cast<size_t>(size)));
+        try {
+            block_allocators_[disk]->new_blocks(bids.begin(), bids.end());
+        }
+        catch (bad_ext_alloc&) {
+            return false;
+        }
+
+        for (size_t i = bids.size(); i > 0; --i)
+            mag.push_back(bids[i - 1].offset);
+    }
+
+    offset = mag.back();
+    mag.pop_back();
+    return true;
+}
+
+bool block_manager::free_cached(size_t disk, uint64_t size, uint64_t offset)
+{
+    const uint64_t capacity = magazine_capacity(size);
+    if (capacity == 0)
+        return false;
+
+    bid_magazines& mags = s_local_magazines;
+    std::unique_lock<std::mutex> lock(mags.mutex_);
+
+    // magazines are registered on first allocation by this thread
+    if (mags.owner_ != this)
+        return false;
+
+    std::vector<uint64_t>& mag = mags.magazines_[std::make_pair(disk, size)];
+    mag.push_back(offset);
+
+    if (mag.size() > capacity)
+    {
+        // drain the older half of the magazine
+        const size_t drain = mag.size() / 2;
+        for (size_t i = 0; i < drain; ++i) {
+            block_allocators_[disk]->delete_block(
+                BID<0>(nullptr, mag[i], static_cast<size_t>(size)));
+        }
+        mag.erase(mag.begin(), mag.begin() + drain);
+    }
+
+    return true;
+}
+
+bool block_manager::reserve_extent(
+    size_t disk, uint64_t bytes, uint64_t& offset)
+{
+    if (disk >= ndisks_ || draining_[disk] ||
+        !block_allocators_[disk]->has_available_space(bytes))
+        return false;
+
+    try {
+        offset = block_allocators_[disk]->new_region(bytes);
+    }
+    catch (bad_ext_alloc&) {
+        return false;
+    }
+    return true;
+}
+
+void block_manager::release_extent(
+    size_t disk, uint64_t offset, uint64_t bytes)
+{
+    assert(disk < ndisks_);
+    block_allocators_[disk]->delete_region(offset, bytes);
+}
+
+uint64_t block_manager::drain_magazines()
+{
+    std::unique_lock<std::mutex> reg_lock(s_magazines_mutex);
+
+    uint64_t bytes = 0;
+    for (bid_magazines* mags : magazines_) {
+        std::unique_lock<std::mutex> lock(mags->mutex_);
+        bytes += mags->drain();
+    }
+
+    TLX_LOG << "block_manager: drained " << bytes << " bytes from magazines";
+    return bytes;
+}
+
+uint64_t block_manager::cached_bytes(size_t disk) const
+{
+    std::unique_lock<std::mutex> reg_lock(s_magazines_mutex);
+
+    uint64_t bytes = 0;
+    for (bid_magazines* mags : magazines_)
+    {
+        std::unique_lock<std::mutex> lock(mags->mutex_);
+        for (const auto& mag : mags->magazines_) {
+            if (mag.first.first == disk)
+                bytes += mag.first.second * mag.second.size();
+        }
+    }
+    return bytes;
+}
+
 } // namespace foxxll
 
 /**************************************************************************/
@@ -16,6 +16,7 @@
 #define FOXXLL_MNG_BLOCK_MANAGER_HEADER
 
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iterator>
 #include <memory>
@@ -23,14 +24,18 @@
 #include <string>
 #include <vector>
 
+#include <foxxll/common/error_handling.hpp>
 #include <foxxll/common/utils.hpp>
 #include <foxxll/config.hpp>
 #include <foxxll/defines.hpp>
 #include <foxxll/io/create_file.hpp>
+#include <foxxll/io/device_topology.hpp>
 #include <foxxll/io/file.hpp>
 #include <foxxll/io/request.hpp>
 #include <foxxll/mng/bid.hpp>
 #include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_catalog.hpp>
+#include <foxxll/mng/compact_bid_array.hpp>
 #include <foxxll/mng/config.hpp>
 #include <foxxll/mng/disk_block_allocator.hpp>
 #include <foxxll/singleton.hpp>
@@ -45,10 +50,23 @@ namespace foxxll {
 //! \addtogroup foxxll_mnglayer
 //! \{
 
+class bid_magazines;
+class extent_reservation;
+
 /*!
  * Block manager class.
  *
  * Manages allocation and deallocation of blocks in multiple/single disk setting
+ *
+ * Single blocks of up to magazine_bytes / 2 bytes are allocated from and
+ * deallocated into per-thread magazines of free blocks, which are refilled
+ * from and drained to the disk_block_allocator objects in bulk. Hence, threads
+ * allocating blocks one by one do not contend for locks. Cached blocks count
+ * as free space, and are returned when a disk runs out of space.
+ *
+ * Disks may be added while the block manager is running, see add_disk(), and
+ * marked as draining to stop new allocations on them, see set_draining().
+ *
  * \remarks is a singleton
  */
 class block_manager : public singleton<block_manager>
@@ -94,6 +112,23 @@ public:
         new_blocks(functor, &bid, std::next(&bid, 1), alloc_offset);
     }
 
+    /*!
+     * Allocates \b count new blocks according to the strategy given by \b
+     * functor and appends their identifiers to the compact sequence \b bids.
+     * Blocks are allocated in batches, such that the BIDs never exist
+     * uncompressed all at once.
+     *
+     * \param functor object of model of \b allocation_strategy concept
+     * \param bids compact BID sequence to append to
+     * \param count number of blocks to allocate
+     * \param alloc_offset advance for \b functor to line up partial allocations
+     */
+    template <typename DiskAssignFunctor, size_t BlockSize>
+    void new_blocks(
+        const DiskAssignFunctor& functor,
+        compact_bid_array<BlockSize>& bids, size_t count,
+        size_t alloc_offset = 0);
+
     //! Deallocates blocks.
     //!
     //! Deallocates blocks in the range [ \b bid_begin, \b bid_end)
@@ -108,15 +143,140 @@ public:
     template <size_t BlockSize>
     void delete_block(const BID<BlockSize>& bid);
 
+    //! Deallocates all blocks of a compact BID sequence and clears it.
+    template <size_t BlockSize>
+    void delete_blocks(compact_bid_array<BlockSize>& bids);
+
+    /*!
+     * Copies the contents of blocks without passing them through user buffers.
+     *
+     * Copies block \b src_begin[i] into block \b dst_begin[i] for all blocks
+     * in the range [ \b src_begin, \b src_end). The target blocks must be
+     * allocated and have the same sizes as the source blocks. Runs of blocks
+     * which are contiguous in both the source and the target file are copied
+     * with a single request, unless one of the files does not support
+     * multi-block requests. Depending on the file implementation the copy
+     * is done by reflinks, in-kernel copies, or a buffered fallback.
+     *
+     * \param src_begin iterator object of \b bid_iterator concept
+     * \param src_end iterator object of \b bid_iterator concept
+     * \param dst_begin iterator object of \b bid_iterator concept
+     * \param on_complete I/O completion handler called for each request
+     * \return requests of the issued copies, wait for them with wait_all()
+     */
+    template <typename SrcBIDIterator, typename DstBIDIterator>
+    std::vector<request_ptr> copy_blocks(
+        SrcBIDIterator src_begin, SrcBIDIterator src_end,
+        DstBIDIterator dst_begin,
+        const completion_handler& on_complete = completion_handler());
+
+    //! Copies the contents of block \b src into block \b dst, see
+    //! copy_blocks().
+    template <size_t BlockSize>
+    request_ptr copy_block(
+        const BID<BlockSize>& src, const BID<BlockSize>& dst,
+        const completion_handler& on_complete = completion_handler())
+    {
+        return src.storage->acopy(
+            dst.storage, src.offset, dst.offset, src.size, on_complete);
+    }
+
+    //! \name Persistent Catalog
+    //! \{
+
+    /*!
+     * Store the BID sequence [ \b bid_begin, \b bid_end) in the catalog under
+     * \b name, replacing a sequence of the same name. All blocks must have
+     * the same size and reside on disks configured with the "catalog" option.
+     * The catalog is written by catalog_commit() and when the block_manager
+     * is destroyed; a later process with the same disk configuration
+     * reattaches to the sequences and their blocks, see block_catalog.
+     */
+    template <typename BIDIterator>
+    void catalog_store(const std::string& name,
+                       BIDIterator bid_begin, BIDIterator bid_end);
+
+    //! Append the BIDs of a catalogued sequence to bids, returns false if no
+    //! such sequence exists.
+    template <size_t BlockSize>
+    bool catalog_load(const std::string& name,
+                      std::vector<BID<BlockSize> >& bids) const;
+
+    //! Remove a sequence from the catalog, its blocks are not deallocated.
+    //! Returns false if no such sequence exists.
+    bool catalog_erase(const std::string& name);
+
+    //! names of all catalogued sequences
+    std::vector<std::string> catalog_names() const;
+
+    //! write the catalog superblocks of all disks, throws io_error
+    void catalog_commit();
+
+    //! \}
+
+    //! \name Runtime Disk Management
+    //! \{
+
+    /*!
+     * Add a disk to the running block manager and return its index. The disk
+     * is appended to the config, such that allocation strategies constructed
+     * afterwards include it; strategies constructed earlier keep using the
+     * previous disks. Hot-added disks start empty, even with the "catalog"
+     * option. Throws if max_disks disks are in use.
+     */
+    size_t add_disk(const disk_config& cfg);
+
+    /*!
+     * Mark a disk as draining, or make it available again. Draining disks
+     * receive no new blocks: allocations directed to them by a strategy are
+     * redirected to the other disks, and blocks cached for them are returned.
+     * Existing blocks stay in place until they are deleted or evacuated by a
+     * block_rebalancer.
+     */
+    void set_draining(size_t disk, bool draining = true);
+
+    //! whether a disk is draining, lock-free
+    bool is_draining(size_t disk) const;
+
+    //! \}
+
+    //! return the file object of a disk, lock-free
+    file * disk_file(size_t disk) const;
+
+    //! return the physical device backing a disk, lock-free
+    const device_topology& disk_device(size_t disk) const;
+
+    /*!
+     * Estimated seconds each device needs to read a block of block_size
+     * bytes, indexed by device id, for heterogeneous prefetch schedules. The
+     * read statistics of the disk files are used once they cover enough
+     * requests, before that the configured bandwidth. Zero for devices with
+     * neither, empty if no device has an estimate.
+     */
+    std::vector<double> device_service_times(size_t block_size) const;
+
     //! \name Statistics
     //! \{
 
+    //! return number of managed disks
+    size_t disks_number() const;
+
     //! return total number of bytes available in all disks
     uint64_t total_bytes() const;
 
+    //! return number of bytes available on a disk
+    uint64_t total_bytes(size_t disk) const;
+
     //! Return total number of free bytes
     uint64_t free_bytes() const;
 
+    //! Return number of free bytes on a disk
+    uint64_t free_bytes(size_t disk) const;
+
+    //! Return whether a disk can take further blocks of given total size,
+    //! false for draining disks
+    bool has_available_space(size_t disk, uint64_t bytes) const;
+
     //! return total requested allocation in bytes
     uint64_t total_allocation() const;
 
@@ -130,11 +290,26 @@ public:
 
     ~block_manager();
 
+    //! maximum number of bytes cached per thread, disk and block size
+    static constexpr uint64_t magazine_bytes = 16 * 1024 * 1024;
+
+    //! maximum number of blocks cached per thread, disk and block size
+    static constexpr uint64_t magazine_blocks = 64;
+
+    //! number of disks which can be managed with hot-added disks
+    static constexpr size_t max_disks = 255;
+
 private:
     friend class singleton<block_manager>;
+    friend class bid_magazines;
+    friend class extent_reservation;
 
-    //! number of managed disks
-    size_t ndisks_;
+    //! number of managed disks, grows when disks are added
+    std::atomic<size_t> ndisks_ { 0 };
+
+    //! number of disk slots, the per-disk arrays are never reallocated such
+    //! that lock-free accessors stay valid while disks are added
+    size_t capacity_;
 
     //! vector of opened disk files
     tlx::simple_vector<file_ptr> disk_files_;
@@ -142,14 +317,33 @@ private:
     //! one block allocator per disk
     tlx::simple_vector<disk_block_allocator*> block_allocators_;
 
+    //! physical device backing each disk
+    tlx::simple_vector<device_topology> devices_;
+
+    //! disks which receive no new blocks
+    std::unique_ptr<std::atomic<bool>[]> draining_;
+
+    //! whether the queue of a disk was assigned automatically and may be
+    //! shared with later disks on the same device
+    std::vector<bool> shared_queue_;
+
+    //! named BID sequences persisted on disks with a catalog
+    block_catalog catalog_;
+
+    //! paths of the disks with a catalog, empty for other disks
+    std::vector<std::string> catalog_paths_;
+
     //! total requested allocation in bytes
-    uint64_t total_allocation_ = 0;
+    std::atomic<uint64_t> total_allocation_ { 0 };
 
     //! currently allocated bytes
-    uint64_t current_allocation_ = 0;
+    std::atomic<uint64_t> current_allocation_ { 0 };
 
     //! maximum number of bytes allocated during program run.
-    uint64_t maximum_allocation_ = 0;
+    std::atomic<uint64_t> maximum_allocation_ { 0 };
+
+    //! magazines of all threads, protected by a global registry mutex
+    std::vector<bid_magazines*> magazines_;
 
     //! private construction from singleton
     block_manager();
@@ -159,6 +353,50 @@ private:
 
     //! log creation and destruction of blocks
     static constexpr bool verbose_block_life_cycle = false;
+
+    //! open disk number i with configuration cfg, expects ndisks_ == i
+    void open_disk(size_t i, disk_config& cfg);
+
+    //! account for newly allocated bytes
+    void add_allocation(uint64_t bytes);
+
+    //! Take a free block of given size on a disk from the calling thread's
+    //! magazine, returns false if the block size is not cached or the disk is
+    //! out of space.
+    bool alloc_cached(size_t disk, uint64_t size, uint64_t& offset);
+
+    //! Put a free block into the calling thread's magazine, returns false if
+    //! the block size is not cached.
+    bool free_cached(size_t disk, uint64_t size, uint64_t offset);
+
+    //! return all blocks in all magazines to the disk allocators, returns the
+    //! number of bytes returned
+    uint64_t drain_magazines();
+
+    //! number of bytes cached in magazines for a disk
+    uint64_t cached_bytes(size_t disk) const;
+
+    //! Reserve a contiguous region on a disk without accounting it as
+    //! allocated, returns false if the disk has no such region.
+    bool reserve_extent(size_t disk, uint64_t bytes, uint64_t& offset);
+
+    //! return an unused part of a reserved region
+    void release_extent(size_t disk, uint64_t offset, uint64_t bytes);
+
+    //! construct a catalogued BID of fixed size
+    template <size_t BlockSize>
+    static void assign_bid(BID<BlockSize>& bid, file* storage,
+                           uint64_t offset, uint64_t /* size */)
+    {
+        bid = BID<BlockSize>(storage, offset);
+    }
+
+    //! construct a catalogued BID of variable size
+    static void assign_bid(BID<0>& bid, file* storage,
+                           uint64_t offset, uint64_t size)
+    {
+        bid = BID<0>(storage, offset, static_cast<size_t>(size));
+    }
 };
 
 template <typename DiskAssignFunctor, typename BIDIterator>
@@ -167,36 +405,67 @@ void block_manager::new_blocks(
     BIDIterator bid_begin, BIDIterator bid_end,
     size_t alloc_offset)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-
     using BIDType = typename std::iterator_traits<BIDIterator>::value_type;
 
+    // single blocks are served from the calling thread's magazines
+    if (bid_end - bid_begin == 1)
+    {
+        const size_t disk_id = functor(alloc_offset);
+        uint64_t offset;
+
+        if (alloc_cached(disk_id, bid_begin->size, offset))
+        {
+            bid_begin->storage = disk_files_[disk_id].get();
+            bid_begin->offset = offset;
+
+            TLX_LOGC(verbose_block_life_cycle) << "BLC:new    " << *bid_begin;
+            add_allocation(bid_begin->size);
+            return;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
     // choose disks for each block, sum up bytes allocated on a disk
 
-    tlx::simple_vector<size_t> disk_blocks(ndisks_);
-    tlx::simple_vector<uint64_t> disk_bytes(ndisks_);
-    std::vector<std::vector<size_t> > disk_out(ndisks_);
+    const size_t ndisks = ndisks_;
+    tlx::simple_vector<size_t> disk_blocks(ndisks);
+    tlx::simple_vector<uint64_t> disk_bytes(ndisks);
+    std::vector<std::vector<size_t> > disk_out(ndisks);
 
     disk_blocks.fill(0);
     disk_bytes.fill(0);
 
     size_t bid_size = static_cast<size_t>(bid_end - bid_begin);
+    bool drained = false;
 
     BIDIterator bid = bid_begin;
     for (size_t i = 0; i < bid_size; ++i, ++bid)
     {
         size_t disk_id = functor(alloc_offset + i);
 
-        if (!block_allocators_[disk_id]->has_available_space(
+        if (!drained && !draining_[disk_id] &&
+            !block_allocators_[disk_id]->has_available_space(
+                disk_bytes[disk_id] + bid->size))
+        {
+            // blocks cached in magazines may make up the missing space
+            drain_magazines();
+            drained = true;
+        }
+
+        if (draining_[disk_id] ||
+            !block_allocators_[disk_id]->has_available_space(
                 disk_bytes[disk_id] + bid->size
             ))
         {
-            // find disk (cyclically) that has enough free space for block
+            // find disk (cyclically) that is not draining and has enough free
+            // space for block
 
-            for (size_t adv = 1; adv < ndisks_; ++adv)
+            for (size_t adv = 1; adv < ndisks; ++adv)
             {
-                size_t try_disk_id = (disk_id + adv) % ndisks_;
-                if (block_allocators_[try_disk_id]->has_available_space(
+                size_t try_disk_id = (disk_id + adv) % ndisks;
+                if (!draining_[try_disk_id] &&
+                    block_allocators_[try_disk_id]->has_available_space(
                         disk_bytes[try_disk_id] + bid->size
                     ))
                 {
@@ -217,8 +486,9 @@ void block_manager::new_blocks(
     // allocate blocks on disks in sequence, then scatter blocks into output
 
     tlx::simple_vector<BIDType> bids;
+    uint64_t allocated = 0;
 
-    for (size_t d = 0; d < ndisks_; ++d)
+    for (size_t d = 0; d < ndisks; ++d)
     {
         if (disk_blocks[d] == 0) continue;
         bids.resize(disk_blocks[d]);
@@ -239,19 +509,37 @@ void block_manager::new_blocks(
             TLX_LOGC(verbose_block_life_cycle) << "BLC:new    " << bids[i];
             bid_begin[bid_perm[i]] = bids[i];
 
-            total_allocation_ += bids[i].size;
-            current_allocation_ += bids[i].size;
+            allocated += bids[i].size;
         }
     }
 
-    maximum_allocation_ = std::max(maximum_allocation_, current_allocation_);
+    add_allocation(allocated);
+}
+
+template <typename DiskAssignFunctor, size_t BlockSize>
+void block_manager::new_blocks(
+    const DiskAssignFunctor& functor,
+    compact_bid_array<BlockSize>& bids, size_t count,
+    size_t alloc_offset)
+{
+    // batches of at most 4 MiB of BIDs
+    const size_t batch_blocks = 4 * 1024 * 1024 / sizeof(BID<BlockSize>);
+    tlx::simple_vector<BID<BlockSize> > batch(std::min(count, batch_blocks));
+
+    for (size_t done = 0; done < count; )
+    {
+        const size_t n = std::min(count - done, batch.size());
+        new_blocks(functor, batch.begin(), batch.begin() + n,
+                   alloc_offset + done);
+        for (size_t i = 0; i < n; ++i)
+            bids.push_back(batch[i]);
+        done += n;
+    }
 }
 
 template <size_t BlockSize>
 void block_manager::delete_block(const BID<BlockSize>& bid)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-
     if (!bid.valid()) {
         TLX_LOG << "Warning: invalid block to be deleted.";
         return;
@@ -261,10 +549,62 @@ void block_manager::delete_block(const BID<BlockSize>& bid)
 
     TLX_LOGC(verbose_block_life_cycle) << "BLC:delete " << bid;
     assert(bid.storage->get_allocator_id() >= 0);
-    block_allocators_[bid.storage->get_allocator_id()]->delete_block(bid);
-    disk_files_[bid.storage->get_allocator_id()]->discard(bid.offset, bid.size);
+    const size_t disk_id = static_cast<size_t>(bid.storage->get_allocator_id());
+
+    disk_files_[disk_id]->discard(bid.offset, bid.size);
 
-    current_allocation_ -= BlockSize;
+    if (!free_cached(disk_id, bid.size, bid.offset))
+        block_allocators_[disk_id]->delete_block(bid);
+
+    current_allocation_ -= bid.size;
+}
+
+template <typename SrcBIDIterator, typename DstBIDIterator>
+std::vector<request_ptr> block_manager::copy_blocks(
+    SrcBIDIterator src_begin, SrcBIDIterator src_end,
+    DstBIDIterator dst_begin, const completion_handler& on_complete)
+{
+    std::vector<request_ptr> reqs;
+
+    while (src_begin != src_end)
+    {
+        assert(src_begin->valid() && dst_begin->valid());
+        assert(src_begin->size == dst_begin->size);
+
+        file* src_file = src_begin->storage;
+        file* dst_file = dst_begin->storage;
+        const uint64_t src_offset = src_begin->offset;
+        const uint64_t dst_offset = dst_begin->offset;
+        uint64_t bytes = src_begin->size;
+
+        // extend run while both sides stay contiguous in the same file,
+        // unless a file cannot serve requests spanning several blocks
+        const bool merge = src_file->supports_multiblock_requests() &&
+                           dst_file->supports_multiblock_requests();
+
+        for (++src_begin, ++dst_begin; src_begin != src_end;
+             ++src_begin, ++dst_begin)
+        {
+            if (!merge ||
+                src_begin->storage != src_file ||
+                dst_begin->storage != dst_file ||
+                src_begin->offset != src_offset + bytes ||
+                dst_begin->offset != dst_offset + bytes)
+                break;
+
+            bytes += src_begin->size;
+        }
+
+        TLX_LOGC(verbose_block_life_cycle)
+            << "BLC:copy   [" << src_file << "]" << src_offset
+            << " -> [" << dst_file << "]" << dst_offset << " / " << bytes;
+
+        reqs.push_back(
+            src_file->acopy(dst_file, src_offset, dst_offset,
+                            static_cast<size_t>(bytes), on_complete));
+    }
+
+    return reqs;
 }
 
 template <typename BIDIterator>
@@ -275,6 +615,68 @@ void block_manager::delete_blocks(
         delete_block(*it);
 }
 
+template <typename BIDIterator>
+void block_manager::catalog_store(
+    const std::string& name, BIDIterator bid_begin, BIDIterator bid_end)
+{
+    block_catalog::sequence seq;
+    seq.blocks.reserve(static_cast<size_t>(bid_end - bid_begin));
+
+    // catalog_paths_ grows with disks added at runtime
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (BIDIterator it = bid_begin; it != bid_end; ++it)
+    {
+        const int disk = it->valid() ? it->storage->get_allocator_id()
+                         : file::NO_ALLOCATOR;
+        if (disk < 0 || static_cast<size_t>(disk) >= ndisks_ ||
+            catalog_paths_[disk].empty())
+        {
+            FOXXLL_THROW_INVALID_ARGUMENT(
+                "Block of sequence " << name << " is not on a disk with catalog.");
+        }
+        if (!seq.blocks.empty() && it->size != seq.block_size) {
+            FOXXLL_THROW_INVALID_ARGUMENT(
+                "Blocks of sequence " << name << " differ in size.");
+        }
+
+        seq.block_size = it->size;
+        seq.blocks.emplace_back(static_cast<size_t>(disk), it->offset);
+    }
+    lock.unlock();
+
+    catalog_.put(name, std::move(seq));
+}
+
+template <size_t BlockSize>
+bool block_manager::catalog_load(
+    const std::string& name, std::vector<BID<BlockSize> >& bids) const
+{
+    block_catalog::sequence seq;
+    if (!catalog_.get(name, seq))
+        return false;
+
+    if (BlockSize != 0 && !seq.blocks.empty() && seq.block_size != BlockSize) {
+        FOXXLL_THROW_INVALID_ARGUMENT(
+            "Sequence " << name << " has blocks of size " << seq.block_size);
+    }
+
+    bids.reserve(bids.size() + seq.blocks.size());
+    for (const block_catalog::location& loc : seq.blocks) {
+        BID<BlockSize> bid;
+        assign_bid(bid, disk_files_[loc.first].get(), loc.second,
+                   seq.block_size);
+        bids.push_back(bid);
+    }
+    return true;
+}
+
+template <size_t BlockSize>
+void block_manager::delete_blocks(compact_bid_array<BlockSize>& bids)
+{
+    delete_blocks(bids.begin(), bids.end());
+    bids.clear();
+}
+
 //! \}
 
 } // namespace foxxll
@@ -0,0 +1,343 @@
+/***************************************************************************
+ *  foxxll/mng/block_merger.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_BLOCK_MERGER_HEADER
+#define FOXXLL_MNG_BLOCK_MERGER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/types.hpp>
+#include <foxxll/mng/async_schedule.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/block_prefetcher.hpp>
+#include <foxxll/mng/config.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Merges k sorted runs of blocks into one sorted sequence.
+ *
+ * Each run is given by the BIDs of its blocks together with the first
+ * element of each block. As a block is needed by the merge exactly when the
+ * output reaches its first element, sorting all blocks by their first
+ * elements yields the order in which the merge consumes them (forecasting).
+ * One block_prefetcher reads this sequence ahead with an optimal prefetch
+ * schedule, and a loser tree selects the smallest element of all runs.
+ *
+ * A run whose block is exhausted competes in the loser tree with the first
+ * element of its next block and only pulls the block from the prefetcher
+ * when it wins, such that blocks are pulled in forecast order. Equal
+ * elements are taken from the run with the smaller index first.
+ */
+template <typename BlockType,
+          typename CompareType = std::less<typename BlockType::value_type> >
+class block_merger
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using value_type = typename block_type::value_type;
+    using bid_type = typename block_type::bid_type;
+    using value_cmp = CompareType;
+
+    //! a block of a run and its first element
+    struct trigger_entry
+    {
+        bid_type bid;
+        value_type key;
+    };
+
+    //! a sorted run, all blocks but the last are full
+    struct run_type
+    {
+        std::vector<trigger_entry> blocks;
+        //! number of elements in the run
+        external_size_type size = 0;
+    };
+
+protected:
+    using bid_vector_type = std::vector<bid_type>;
+    using bid_iterator_type = typename bid_vector_type::iterator;
+    using schedule_type = windowed_prefetch_schedule<bid_iterator_type>;
+    using prefetcher_type =
+              block_prefetcher<block_type, bid_iterator_type, schedule_type>;
+
+    //! merge state of a run
+    struct run_state
+    {
+        //! current block, nullptr while waiting for the next block
+        block_type* block = nullptr;
+        //! remaining elements of the current block
+        const value_type* current = nullptr;
+        const value_type* end = nullptr;
+        //! index of the next block in the run
+        size_t next_block = 0;
+    };
+
+    std::vector<run_type> runs_;
+    std::vector<run_state> states_;
+
+    //! BIDs and runs of all blocks in consumption order
+    bid_vector_type consume_bids_;
+    std::vector<size_t> consume_runs_;
+
+    std::unique_ptr<prefetcher_type> prefetcher_;
+
+    value_cmp cmp_;
+
+    //! number of leaves of the loser tree, a power of two
+    size_t leaves_ = 1;
+
+    //! current smallest element of each run, the first element of the next
+    //! block while waiting for it, nullptr if the run is finished
+    std::vector<const value_type*> heads_;
+
+    //! the winner at index 0, the loser of each inner node below
+    std::vector<size_t> tree_;
+
+    //! elements not merged yet
+    external_size_type remaining_ = 0;
+
+    //! whether run a precedes run b, finished runs come last
+    bool less(size_t a, size_t b) const
+    {
+        const value_type* ka = heads_[a];
+        const value_type* kb = heads_[b];
+        if (!ka)
+            return false;
+        if (!kb)
+            return true;
+        if (cmp_(*ka, *kb))
+            return true;
+        if (cmp_(*kb, *ka))
+            return false;
+        return a < b;
+    }
+
+    //! build the subtree at node, returns its winner
+    size_t build(size_t node)
+    {
+        if (node >= leaves_)
+            return node - leaves_;
+
+        const size_t left = build(2 * node);
+        const size_t right = build(2 * node + 1);
+        if (less(left, right)) {
+            tree_[node] = right;
+            return left;
+        }
+        tree_[node] = left;
+        return right;
+    }
+
+    //! play the games on the path of the changed run up to the root
+    void replay(size_t run)
+    {
+        size_t winner = run;
+        for (size_t node = (run + leaves_) / 2; node > 0; node /= 2)
+        {
+            if (less(tree_[node], winner))
+                std::swap(tree_[node], winner);
+        }
+        tree_[0] = winner;
+    }
+
+    //! number of elements in block i of a run
+    static size_t block_elements(const run_type& run, size_t i)
+    {
+        const external_size_type rest =
+            run.size - external_size_type(i) * block_type::size;
+        return rest < block_type::size ? static_cast<size_t>(rest)
+               : size_t(block_type::size);
+    }
+
+    //! wait for the next block of a run, after the run won with its key
+    void pull(size_t r)
+    {
+        run_state& s = states_[r];
+        assert(consume_runs_[prefetcher_->pos()] == r);
+
+        s.block = prefetcher_->pull_block();
+        s.current = s.block->begin();
+        s.end = s.current + block_elements(runs_[r], s.next_block);
+        ++s.next_block;
+
+        // the forecast is only correct with the true first elements
+        assert(!cmp_(*s.current, *heads_[r]) && !cmp_(*heads_[r], *s.current));
+        heads_[r] = s.current;
+    }
+
+    //! give back an exhausted block, the run then waits for its next block
+    void exhausted(size_t r)
+    {
+        run_state& s = states_[r];
+        prefetcher_->block_released(s.block);
+        s.block = nullptr;
+
+        const run_type& run = runs_[r];
+        heads_[r] = s.next_block < run.blocks.size()
+                    ? &run.blocks[s.next_block].key : nullptr;
+    }
+
+public:
+    /*!
+     * Computes the consumption order and starts prefetching.
+     *
+     * \param runs sorted runs to merge, the first element of each block must
+     * be given with its BID
+     * \param nbuffers number of block buffers, the runs hold one each and the
+     * others are used for reading ahead
+     * \param cmp comparator the runs are sorted by
+     */
+    block_merger(std::vector<run_type> runs, size_t nbuffers,
+                 value_cmp cmp = value_cmp())
+        : runs_(std::move(runs)), states_(runs_.size()), cmp_(cmp)
+    {
+        const size_t k = runs_.size();
+
+        // consumption order: blocks sorted by first element, then by run
+        std::vector<std::pair<size_t, size_t> > order;
+        for (size_t r = 0; r < k; ++r)
+        {
+            const run_type& run = runs_[r];
+            assert(run.blocks.size() ==
+                   (run.size + block_type::size - 1) / block_type::size);
+            remaining_ += run.size;
+            for (size_t i = 0; i < run.blocks.size(); ++i)
+                order.emplace_back(r, i);
+        }
+        std::sort(order.begin(), order.end(),
+                  [this](const std::pair<size_t, size_t>& a,
+                         const std::pair<size_t, size_t>& b) {
+                      const value_type& ka = runs_[a.first].blocks[a.second].key;
+                      const value_type& kb = runs_[b.first].blocks[b.second].key;
+                      if (cmp_(ka, kb))
+                          return true;
+                      if (cmp_(kb, ka))
+                          return false;
+                      return a < b;
+                  });
+
+        consume_bids_.reserve(order.size());
+        consume_runs_.reserve(order.size());
+        for (const std::pair<size_t, size_t>& o : order)
+        {
+            consume_bids_.push_back(runs_[o.first].blocks[o.second].bid);
+            consume_runs_.push_back(o.first);
+        }
+
+        while (leaves_ < k)
+            leaves_ *= 2;
+        heads_.assign(leaves_, nullptr);
+        for (size_t r = 0; r < k; ++r)
+        {
+            if (!runs_[r].blocks.empty())
+                heads_[r] = &runs_[r].blocks[0].key;
+        }
+        tree_.resize(leaves_);
+        tree_[0] = build(1);
+
+        TLX_LOG << "block_merger: " << k << " runs, " << consume_bids_.size()
+                << " blocks, " << remaining_ << " elements";
+
+        if (consume_bids_.empty())
+            return;
+
+        // while pulling a block, the other runs may hold a block each
+        const size_t ndisks = config::get_instance()->disks_number();
+        nbuffers = std::max(nbuffers, k - 1 + 2 * ndisks);
+        const size_t readahead = nbuffers - (k - 1);
+
+        prefetcher_.reset(new prefetcher_type(
+                              consume_bids_.begin(), consume_bids_.end(),
+                              schedule_type(
+                                  consume_bids_.begin(), consume_bids_.end(),
+                                  readahead,
+                                  config::get_instance()->max_device_id(), 0,
+                                  block_manager::get_instance()->device_service_times(
+                                      block_type::raw_size)),
+                              nbuffers));
+    }
+
+    //! non-copyable: delete copy-constructor
+    block_merger(const block_merger&) = delete;
+    //! non-copyable: delete assignment operator
+    block_merger& operator = (const block_merger&) = delete;
+
+    //! Returns the number of elements not merged yet.
+    external_size_type size() const { return remaining_; }
+
+    //! Returns whether all elements have been merged.
+    bool empty() const { return remaining_ == 0; }
+
+    //! Merges the next elements into [first, last), stopping early when the
+    //! runs are exhausted.
+    //! \return end of the merged elements
+    template <typename OutputIterator>
+    OutputIterator merge(OutputIterator first, OutputIterator last)
+    {
+        while (first != last && remaining_ != 0)
+        {
+            const size_t r = tree_[0];
+            run_state& s = states_[r];
+            if (!s.block)
+                pull(r);
+
+            *first = *s.current;
+            ++first;
+            --remaining_;
+
+            if (TLX_UNLIKELY(++s.current == s.end))
+                exhausted(r);
+            else
+                heads_[r] = s.current;
+
+            replay(r);
+        }
+        return first;
+    }
+
+    //! Merges all remaining elements into a stream offering next_span() and
+    //! commit(), like buf_ostream. The last block of the stream may be
+    //! incomplete and is left to the caller.
+    template <typename OutputStream>
+    void merge(OutputStream& out)
+    {
+        while (remaining_ != 0)
+        {
+            auto span = out.next_span();
+            auto end = merge(span.first, span.second);
+            out.commit(static_cast<size_t>(end - span.first));
+        }
+    }
+
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_BLOCK_MERGER_HEADER
+
+/**************************************************************************/
@@ -17,11 +17,14 @@
 
 #include <algorithm>
 #include <queue>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <foxxll/common/onoff_switch.hpp>
 #include <foxxll/io/iostats.hpp>
 #include <foxxll/io/request.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 namespace foxxll {
 
@@ -52,7 +55,11 @@ public:
 //!
 //! \c block_prefetcher overlaps I/Os with consumption of read data.
 //! Utilizes optimal asynchronous prefetch scheduling (by Peter Sanders et.al.)
-template <typename BlockType, typename BidIteratorType>
+//! The prefetch order is an array or a windowed_prefetch_schedule, indexed
+//! in increasing order. Besides it, the state is O(number of buffers), not
+//! O(sequence length): completions are tracked per read buffer.
+template <typename BlockType, typename BidIteratorType,
+          typename PrefetchSeqType = size_t*>
 class block_prefetcher
 {
     constexpr static bool debug = false;
@@ -60,6 +67,7 @@ class block_prefetcher
 public:
     using block_type = BlockType;
     using bid_iterator_type = BidIteratorType;
+    using prefetch_seq_type = PrefetchSeqType;
 
     using bid_type = typename block_type::bid_type;
 
@@ -68,7 +76,7 @@ protected:
     bid_iterator_type consume_seq_end;
     size_t seq_length;
 
-    size_t* prefetch_seq;
+    prefetch_seq_type prefetch_seq;
 
     size_t nextread;
     size_t nextconsume;
@@ -79,21 +87,33 @@ protected:
     request_ptr* read_reqs;
     bid_type* read_bids;
 
+    //! completion of the read into each buffer
     onoff_switch* completed;
-    size_t* pref_buffer;
+    //! buffer of each block in reading or read but not yet consumed, by
+    //! position in the consumption sequence
+    std::unordered_map<size_t, size_t> pref_buffer;
 
     completion_handler do_after_fetch;
 
+    //! budget the read buffers are charged to, if any
+    memory_budget::account* budget_;
+
     block_type * wait(size_t iblock)
     {
         TLX_LOG << "block_prefetcher: waiting block " << iblock;
+        size_t ibuffer;
         {
             stats::scoped_wait_timer wait_timer(stats::WAIT_OP_READ);
 
-            completed[iblock].wait_for_on();
+            typename std::unordered_map<size_t, size_t>::iterator it =
+                pref_buffer.find(iblock);
+            assert(it != pref_buffer.end());
+            ibuffer = it->second;
+            pref_buffer.erase(it);
+
+            completed[ibuffer].wait_for_on();
         }
         TLX_LOG << "block_prefetcher: finished waiting block " << iblock;
-        size_t ibuffer = pref_buffer[iblock];
         TLX_LOG << "block_prefetcher: returning buffer " << ibuffer;
         assert(ibuffer < nreadblocks);
         return (read_buffers + ibuffer);
@@ -104,37 +124,40 @@ public:
     //! \param _cons_begin \c bid_iterator pointing to the \c bid of the first block to be consumed
     //! \param _cons_end \c bid_iterator pointing to the \c bid of the ( \b last + 1 ) block of consumption sequence
     //! \param _pref_seq gives the prefetch order, is a pointer to the integer array that contains
-    //!        the indices of the blocks in the consumption sequence
+    //!        the indices of the blocks in the consumption sequence, or a schedule object taken over
     //! \param _prefetch_buf_size amount of prefetch buffers to use
     //! \param do_after_fetch unknown
+    //! \param budget account the read buffers are charged to, blocking until
+    //!        they fit. The account must outlive the prefetcher.
     block_prefetcher(
         bid_iterator_type _cons_begin,
         bid_iterator_type _cons_end,
-        size_t* _pref_seq,
+        prefetch_seq_type _pref_seq,
         size_t _prefetch_buf_size,
-        completion_handler do_after_fetch = completion_handler())
+        completion_handler do_after_fetch = completion_handler(),
+        memory_budget::account* budget = nullptr)
         : consume_seq_begin(_cons_begin),
           consume_seq_end(_cons_end),
           seq_length(_cons_end - _cons_begin),
-          prefetch_seq(_pref_seq),
+          prefetch_seq(std::move(_pref_seq)),
           nextread(std::min(_prefetch_buf_size, seq_length)),
           nextconsume(0),
           nreadblocks(nextread),
-          do_after_fetch(do_after_fetch)
+          do_after_fetch(do_after_fetch),
+          budget_(budget)
     {
         TLX_LOG << "block_prefetcher: seq_length=" << seq_length;
         TLX_LOG << "block_prefetcher: _prefetch_buf_size=" << _prefetch_buf_size;
         assert(seq_length > 0);
         assert(_prefetch_buf_size > 0);
         size_t i;
+        if (budget_)
+            budget_->acquire(nreadblocks * block_type::raw_size);
         read_buffers = new block_type[nreadblocks];
         read_reqs = new request_ptr[nreadblocks];
         read_bids = new bid_type[nreadblocks];
-        pref_buffer = new size_t[seq_length];
-
-        std::fill(pref_buffer, pref_buffer + seq_length, -1);
-
-        completed = new onoff_switch[seq_length];
+        completed = new onoff_switch[nreadblocks];
+        pref_buffer.reserve(nreadblocks);
 
         for (i = 0; i < nreadblocks; ++i)
         {
@@ -146,7 +169,7 @@ public:
                 " @ " << read_bids[i];
             read_reqs[i] = read_buffers[i].read(
                     read_bids[i],
-                    set_switch_handler(*(completed + prefetch_seq[i]), do_after_fetch)
+                    set_switch_handler(completed[i], do_after_fetch)
                 );
             pref_buffer[prefetch_seq[i]] = i;
         }
@@ -164,12 +187,12 @@ public:
         TLX_LOG << "block_prefetcher: pulling a block";
         return wait(nextconsume++);
     }
-    //! Exchanges buffers between prefetcher and application.
-    //! \param buffer pointer to the consumed buffer. After call if return value is true \c buffer
-    //!        contains valid pointer to the next unconsumed prefetched buffer.
-    //! \remark parameter \c buffer must be value returned by \c pull_block() or \c block_consumed() methods
-    //! \return \c false if there are no blocks to prefetch left, \c true if consumption sequence is not emptied
-    bool block_consumed(block_type*& buffer)
+    //! Gives a consumed buffer back for prefetching without pulling the next
+    //! block, which is taken later with pull_block(). Consumers holding
+    //! several blocks at once use this instead of block_consumed().
+    //! \param buffer pointer to the consumed buffer, must be value returned by
+    //!        \c pull_block() or \c block_consumed() methods
+    void block_released(block_type* buffer)
     {
         size_t ibuffer = buffer - read_buffers;
         TLX_LOG << "block_prefetcher: buffer " << ibuffer << " consumed";
@@ -185,16 +208,28 @@ public:
             TLX_LOG << "block_prefetcher: prefetching block " << next_2_prefetch;
 
             assert(next_2_prefetch < seq_length);
-            assert(!completed[next_2_prefetch].is_on());
+            assert(pref_buffer.find(next_2_prefetch) == pref_buffer.end());
 
+            // the previous read into the buffer has completed above
+            completed[ibuffer].off();
             pref_buffer[next_2_prefetch] = ibuffer;
             read_bids[ibuffer] =
                 bid_type(*(consume_seq_begin + next_2_prefetch));
             read_reqs[ibuffer] = read_buffers[ibuffer].read(
                     read_bids[ibuffer],
-                    set_switch_handler(*(completed + next_2_prefetch), do_after_fetch)
+                    set_switch_handler(completed[ibuffer], do_after_fetch)
                 );
         }
+    }
+
+    //! Exchanges buffers between prefetcher and application.
+    //! \param buffer pointer to the consumed buffer. After call if return value is true \c buffer
+    //!        contains valid pointer to the next unconsumed prefetched buffer.
+    //! \remark parameter \c buffer must be value returned by \c pull_block() or \c block_consumed() methods
+    //! \return \c false if there are no blocks to prefetch left, \c true if consumption sequence is not emptied
+    bool block_consumed(block_type*& buffer)
+    {
+        block_released(buffer);
 
         if (nextconsume >= seq_length)
             return false;
@@ -227,8 +262,10 @@ public:
         delete[] read_reqs;
         delete[] read_bids;
         delete[] completed;
-        delete[] pref_buffer;
         delete[] read_buffers;
+
+        if (budget_)
+            budget_->release(nreadblocks * block_type::raw_size);
     }
 };
 
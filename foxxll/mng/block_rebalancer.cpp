@@ -0,0 +1,281 @@
+/***************************************************************************
+ *  foxxll/mng/block_rebalancer.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/mng/block_rebalancer.hpp>
+
+namespace foxxll {
+
+block_rebalancer::block_rebalancer(uint64_t bytes_per_second,
+                                   size_t batch_blocks)
+    : bytes_per_second_(bytes_per_second),
+      batch_blocks_(std::max<size_t>(batch_blocks, 1))
+{ }
+
+block_rebalancer::~block_rebalancer()
+{
+    stop();
+}
+
+void block_rebalancer::add_registration(const registration_ptr& reg)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    registrations_.push_back(reg);
+    cv_.notify_all();
+}
+
+void block_rebalancer::unregister(const registration_ptr& reg)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        registrations_.erase(
+            std::remove(registrations_.begin(), registrations_.end(), reg),
+            registrations_.end());
+    }
+    // waits for copies in flight, the remapping is then discarded
+    rebalance_registration::exclusive_lock_type lock(reg->mutex_);
+    reg->active_ = false;
+}
+
+void block_rebalancer::start()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (running_)
+        return;
+    running_ = true;
+    thread_ = std::thread([this]() { worker(); });
+}
+
+void block_rebalancer::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+        cv_.notify_all();
+    }
+    thread_.join();
+}
+
+rebalance_registration::move_list block_rebalancer::plan_moves(
+    const std::vector<int>& disks, const std::vector<size_t>& room,
+    size_t max_moves, const std::vector<bool>& evacuate)
+{
+    const size_t ndisks = room.size();
+    rebalance_registration::move_list moves;
+    if (ndisks < 2)
+        return moves;
+
+    std::vector<size_t> count(ndisks, 0);
+    size_t total = 0;
+    for (const int d : disks) {
+        if (d >= 0 && static_cast<size_t>(d) < ndisks) {
+            ++count[d];
+            ++total;
+        }
+    }
+
+    // evacuated disks keep no blocks, other disks which cannot receive blocks
+    // keep at most their fair share, the remaining blocks are spread evenly
+    // over the others
+    const size_t nevacuate = static_cast<size_t>(
+        std::count(evacuate.begin(), evacuate.end(), true));
+    const size_t fair =
+        nevacuate < ndisks ? total / (ndisks - nevacuate) : 0;
+    std::vector<size_t> quota(ndisks, 0);
+    std::vector<size_t> receivers;
+    size_t rest = total;
+    for (size_t d = 0; d < ndisks; ++d) {
+        if (d < evacuate.size() && evacuate[d]) {
+            continue;
+        }
+        else if (room[d] != 0) {
+            receivers.push_back(d);
+        }
+        else {
+            quota[d] = std::min(count[d], fair);
+            rest -= quota[d];
+        }
+    }
+    if (receivers.empty())
+        return moves;
+
+    // hand out the remainder to receivers already holding most blocks
+    std::stable_sort(receivers.begin(), receivers.end(),
+                     [&count](size_t a, size_t b) {
+                         return count[a] > count[b];
+                     });
+    for (size_t r = 0; r < receivers.size(); ++r) {
+        quota[receivers[r]] = rest / receivers.size() +
+                              (r < rest % receivers.size() ? 1 : 0);
+    }
+
+    // a disk receives no more blocks than it has room for
+    std::vector<size_t> surplus(ndisks, 0), deficit(ndisks, 0);
+    for (size_t d = 0; d < ndisks; ++d) {
+        if (count[d] > quota[d])
+            surplus[d] = count[d] - quota[d];
+        else
+            deficit[d] = std::min(quota[d] - count[d], room[d]);
+    }
+
+    // walk the sequence and move surplus blocks, avoiding the disks of the
+    // neighbouring blocks to keep consecutive blocks on distinct disks
+    std::vector<int> placed = disks;
+    for (size_t i = 0; i < placed.size() && moves.size() < max_moves; ++i)
+    {
+        const int d = placed[i];
+        if (d < 0 || static_cast<size_t>(d) >= ndisks || surplus[d] == 0)
+            continue;
+
+        const int prev = (i > 0) ? placed[i - 1] : -1;
+        const int next = (i + 1 < placed.size()) ? placed[i + 1] : -1;
+
+        size_t target = ndisks;
+        for (size_t t = 0; t < ndisks; ++t) {
+            if (deficit[t] == 0)
+                continue;
+            const bool neighbour =
+                static_cast<int>(t) == prev || static_cast<int>(t) == next;
+            if (target == ndisks || !neighbour) {
+                target = t;
+                if (!neighbour)
+                    break;
+            }
+        }
+        if (target == ndisks)
+            break;
+
+        --surplus[d], --deficit[target];
+        placed[i] = static_cast<int>(target);
+        moves.emplace_back(i, target);
+    }
+
+    return moves;
+}
+
+uint64_t block_rebalancer::rebalance(rebalance_registration& reg)
+{
+    block_manager* bm = block_manager::get_instance();
+
+    std::vector<int> disks;
+    uint64_t generation;
+    const uint64_t block_size = reg.disk_assignment(disks, generation);
+    if (block_size == 0)
+        return 0;
+
+    // blocks on draining disks are moved off them, a disk without autogrow
+    // receives at most the blocks fitting into its free space
+    std::vector<size_t> room(bm->disks_number(), 0);
+    std::vector<bool> evacuate(room.size());
+    for (size_t d = 0; d < room.size(); ++d) {
+        if (bm->has_available_space(d, batch_blocks_ * block_size))
+            room[d] = batch_blocks_;
+        else if (bm->has_available_space(d, block_size))
+            room[d] = static_cast<size_t>(bm->free_bytes(d) / block_size);
+        evacuate[d] = bm->is_draining(d);
+    }
+
+    rebalance_registration::move_list moves =
+        plan_moves(disks, room, batch_blocks_, evacuate);
+    if (moves.empty())
+        return 0;
+
+    const uint64_t bytes = reg.migrate(moves, generation);
+    if (bytes != 0) {
+        migrated_blocks_ += moves.size();
+        migrated_bytes_ += bytes;
+    }
+
+    TLX_LOG << "block_rebalancer: migrated " << moves.size()
+            << " blocks, " << bytes << " bytes";
+
+    return bytes;
+}
+
+uint64_t block_rebalancer::rebalance_once()
+{
+    std::vector<registration_ptr> regs;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        regs = registrations_;
+    }
+
+    uint64_t bytes = 0;
+    for (const registration_ptr& reg : regs)
+        bytes += rebalance(*reg);
+    return bytes;
+}
+
+bool block_rebalancer::wait_for_budget(uint64_t bytes)
+{
+    if (bytes_per_second_ == 0)
+        return true;
+
+    const double now = timestamp();
+    budget_time_ = std::max(budget_time_, now) +
+                   static_cast<double>(bytes) /
+                   static_cast<double>(bytes_per_second_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto delay = std::chrono::duration<double>(budget_time_ - now);
+    return !cv_.wait_for(lock, delay, [this]() { return !running_; });
+}
+
+void block_rebalancer::worker()
+{
+    std::vector<registration_ptr> regs;
+
+    for ( ; ; )
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!running_)
+                return;
+            regs = registrations_;
+        }
+
+        uint64_t bytes = 0;
+        for (const registration_ptr& reg : regs) {
+            // a failed batch is retried in the next round
+            uint64_t moved = 0;
+            try {
+                moved = rebalance(*reg);
+            }
+            catch (const std::exception& e) {
+                TLX_LOG1 << "block_rebalancer: migration failed: "
+                         << e.what();
+            }
+            bytes += moved;
+            if (!wait_for_budget(moved))
+                return;
+        }
+        regs.clear();
+
+        if (bytes == 0) {
+            // balanced: sleep until new registrations or stop
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, std::chrono::seconds(1));
+        }
+    }
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
@@ -0,0 +1,342 @@
+/***************************************************************************
+ *  foxxll/mng/block_rebalancer.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_BLOCK_REBALANCER_HEADER
+#define FOXXLL_MNG_BLOCK_REBALANCER_HEADER
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/io/file.hpp>
+#include <foxxll/io/request.hpp>
+#include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_manager.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * A BID sequence registered with a block_rebalancer.
+ *
+ * The rebalancer may replace the BIDs of the sequence at any time. Users must
+ * hold lock() while they read BIDs and until I/O on them has completed, and
+ * must hold lock_exclusive() while they modify BIDs or write into the blocks.
+ * Migrations overlapping an exclusive lock are discarded.
+ */
+class rebalance_registration
+{
+public:
+    using mutex_type = std::shared_timed_mutex;
+    using shared_lock_type = std::shared_lock<mutex_type>;
+    using exclusive_lock_type = std::unique_lock<mutex_type>;
+
+    //! pairs (position in sequence, target disk)
+    using move_list = std::vector<std::pair<size_t, size_t> >;
+
+    explicit rebalance_registration(size_t size) : size_(size) { }
+
+    //! non-copyable: delete copy-constructor
+    rebalance_registration(const rebalance_registration&) = delete;
+    //! non-copyable: delete assignment operator
+    rebalance_registration& operator = (const rebalance_registration&) = delete;
+
+    virtual ~rebalance_registration() = default;
+
+    //! Lock preventing the BIDs from being remapped while it is held.
+    shared_lock_type lock()
+    {
+        return shared_lock_type(mutex_);
+    }
+
+    //! Lock required to modify the BIDs or the contents of their blocks.
+    exclusive_lock_type lock_exclusive()
+    {
+        exclusive_lock_type lock(mutex_);
+        ++generation_;
+        return lock;
+    }
+
+    //! number of BIDs in the sequence
+    size_t size() const { return size_; }
+
+protected:
+    friend class block_rebalancer;
+
+    mutex_type mutex_;
+
+    //! number of BIDs in the sequence
+    size_t size_;
+
+    //! incremented by each exclusive lock, invalidates running migrations
+    uint64_t generation_ = 0;
+
+    //! cleared when the sequence is unregistered
+    bool active_ = true;
+
+    //! store the disk of each block into disks, or file::NO_ALLOCATOR for
+    //! invalid or unmanaged blocks, and the current generation into
+    //! generation; returns the size of a block in bytes
+    virtual uint64_t disk_assignment(
+        std::vector<int>& disks, uint64_t& generation) = 0;
+
+    //! copy the blocks to their target disks and remap their BIDs, returns
+    //! the number of bytes migrated. Nothing is migrated if the BIDs were
+    //! modified since disk_assignment() returned generation.
+    virtual uint64_t migrate(const move_list& moves, uint64_t generation) = 0;
+};
+
+//! rebalance_registration for a random access sequence of BIDs.
+template <typename BIDIterator>
+class rebalance_registration_impl final : public rebalance_registration
+{
+    using bid_type = typename std::iterator_traits<BIDIterator>::value_type;
+
+    //! begin of the registered sequence
+    BIDIterator begin_;
+
+public:
+    rebalance_registration_impl(BIDIterator begin, BIDIterator end)
+        : rebalance_registration(static_cast<size_t>(end - begin)),
+          begin_(begin)
+    { }
+
+protected:
+    uint64_t disk_assignment(
+        std::vector<int>& disks, uint64_t& generation) final
+    {
+        shared_lock_type lock(mutex_);
+        generation = generation_;
+
+        uint64_t block_size = 0;
+        disks.resize(size_);
+        for (size_t i = 0; i < size_; ++i)
+        {
+            const bid_type& bid = begin_[i];
+            if (bid.valid() && bid.is_managed()) {
+                disks[i] = bid.storage->get_allocator_id();
+                block_size = bid.size;
+            }
+            else {
+                disks[i] = file::NO_ALLOCATOR;
+            }
+        }
+        return block_size;
+    }
+
+    uint64_t migrate(const move_list& moves, uint64_t generation) final
+    {
+        block_manager* bm = block_manager::get_instance();
+
+        std::vector<bid_type> old_bids(moves.size());
+        std::vector<bid_type> new_bids(moves.size());
+
+        {
+            // shared lock: readers may continue, writers wait for the copies.
+            // The moves were planned on the BIDs of generation, which may
+            // have been deleted or replaced since.
+            shared_lock_type lock(mutex_);
+            if (!active_ || generation != generation_) return 0;
+
+            std::vector<request_ptr> reqs;
+            reqs.reserve(moves.size());
+            try {
+                for (size_t m = 0; m < moves.size(); ++m)
+                {
+                    old_bids[m] = begin_[moves[m].first];
+                    assert(old_bids[m].valid() && old_bids[m].is_managed());
+                    new_bids[m] = old_bids[m];
+                    bm->new_blocks(single_disk(moves[m].second),
+                                   &new_bids[m], &new_bids[m] + 1);
+                    reqs.push_back(bm->copy_block(old_bids[m], new_bids[m]));
+                }
+                wait_all(reqs.begin(), reqs.end());
+            }
+            catch (...) {
+                // let the issued copies finish, then drop their targets
+                for (request_ptr& req : reqs) {
+                    try { req->wait(); }
+                    catch (...) { }
+                }
+                bm->delete_blocks(new_bids.begin(),
+                                  new_bids.begin() + reqs.size());
+                throw;
+            }
+        }
+
+        // atomically remap the BIDs, unless they were modified meanwhile
+        exclusive_lock_type lock(mutex_);
+
+        if (!active_ || generation != generation_) {
+            bm->delete_blocks(new_bids.begin(), new_bids.end());
+            return 0;
+        }
+
+        uint64_t bytes = 0;
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            begin_[moves[m].first] = new_bids[m];
+            bm->delete_block(old_bids[m]);
+            bytes += old_bids[m].size;
+        }
+        return bytes;
+    }
+};
+
+/*!
+ * Background migration of blocks between disks to even out the per-disk load
+ * of registered BID sequences.
+ *
+ * Data stays on the disks where it was allocated, e.g. after single_disk
+ * allocations or a full disk forced fallbacks. Striped scans of such sequences
+ * are limited by the most loaded disk. The rebalancer moves blocks of each
+ * registered sequence from overloaded to underloaded disks, such that every
+ * disk holds about the same number of blocks of it, within an I/O budget.
+ * Blocks are copied with block_manager::copy_blocks() and the BIDs are
+ * remapped atomically afterwards, see rebalance_registration. Blocks on disks
+ * marked as draining with block_manager::set_draining() are evacuated.
+ */
+class block_rebalancer
+{
+    static constexpr bool debug = false;
+
+public:
+    using registration_ptr = std::shared_ptr<rebalance_registration>;
+
+    /*!
+     * Construct a rebalancer, the background thread is started by start().
+     *
+     * \param bytes_per_second I/O budget for migrations, zero is unlimited
+     * \param batch_blocks maximum number of blocks copied concurrently
+     */
+    explicit block_rebalancer(uint64_t bytes_per_second = 0,
+                              size_t batch_blocks = 16);
+
+    //! non-copyable: delete copy-constructor
+    block_rebalancer(const block_rebalancer&) = delete;
+    //! non-copyable: delete assignment operator
+    block_rebalancer& operator = (const block_rebalancer&) = delete;
+
+    //! stops the background thread
+    ~block_rebalancer();
+
+    //! Register the BID sequence [begin, end) for rebalancing. The sequence
+    //! must stay valid until it is unregistered.
+    template <typename BIDIterator>
+    registration_ptr register_bids(BIDIterator begin, BIDIterator end)
+    {
+        registration_ptr reg =
+            std::make_shared<rebalance_registration_impl<BIDIterator> >(
+                begin, end);
+        add_registration(reg);
+        return reg;
+    }
+
+    //! Unregister a BID sequence. Waits for running migrations of it.
+    void unregister(const registration_ptr& reg);
+
+    //! start background migration
+    void start();
+
+    //! stop background migration, waits for the current batch to finish
+    void stop();
+
+    //! Run one synchronous rebalancing step on all registered sequences,
+    //! returns the number of bytes migrated (zero if balanced).
+    uint64_t rebalance_once();
+
+    //! \name Statistics
+    //! \{
+
+    //! number of blocks migrated so far
+    uint64_t migrated_blocks() const { return migrated_blocks_; }
+
+    //! number of bytes migrated so far
+    uint64_t migrated_bytes() const { return migrated_bytes_; }
+
+    //! \}
+
+    /*!
+     * Compute a list of moves evening out the disk load of one sequence.
+     *
+     * \param disks disk of each block, negative for blocks to ignore
+     * \param room number of blocks each disk may receive, zero if it cannot
+     * receive blocks
+     * \param max_moves maximum number of moves to return
+     * \param evacuate whether all blocks are to be moved off a disk
+     */
+    static rebalance_registration::move_list plan_moves(
+        const std::vector<int>& disks, const std::vector<size_t>& room,
+        size_t max_moves,
+        const std::vector<bool>& evacuate = std::vector<bool>());
+
+private:
+    //! I/O budget for migrations in bytes per second, zero is unlimited
+    uint64_t bytes_per_second_;
+
+    //! maximum number of blocks copied concurrently
+    size_t batch_blocks_;
+
+    //! protects registrations_ and the thread state
+    std::mutex mutex_;
+
+    //! wakes the background thread
+    std::condition_variable cv_;
+
+    //! list of registered sequences
+    std::vector<registration_ptr> registrations_;
+
+    //! background thread
+    std::thread thread_;
+
+    //! background thread should run
+    bool running_ = false;
+
+    //! earliest time the next migration may start, due to the I/O budget
+    double budget_time_ = 0.0;
+
+    std::atomic<uint64_t> migrated_blocks_ { 0 };
+    std::atomic<uint64_t> migrated_bytes_ { 0 };
+
+    //! add a registration and wake the background thread
+    void add_registration(const registration_ptr& reg);
+
+    //! rebalance one batch of one sequence, returns bytes migrated
+    uint64_t rebalance(rebalance_registration& reg);
+
+    //! sleep until the I/O budget allows further migrations, returns false
+    //! if interrupted by stop()
+    bool wait_for_budget(uint64_t bytes);
+
+    //! main loop of the background thread
+    void worker();
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_BLOCK_REBALANCER_HEADER
+
+/**************************************************************************/
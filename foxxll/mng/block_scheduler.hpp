@@ -32,6 +32,7 @@
 #include <tlx/unused.hpp>
 
 #include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 #include <foxxll/mng/typed_block.hpp>
 
 #include <foxxll/common/addressable_queues.hpp>
@@ -332,6 +333,9 @@ protected:
     block_manager* bm;
     block_scheduler_algorithm<SwappableBlockType>* algo;
 
+    //! budget the internal_blocks are charged to, if any
+    memory_budget::account* budget_;
+
     //! Get an internal_block from the freelist or a newly allocated one if available.
     //! \return Pointer to the internal_block. nullptr if none available.
     internal_block_type * get_free_internal_block()
@@ -347,6 +351,8 @@ protected:
         {
             // => more internal_blocks can be allocated
             size_t num_blocks = std::min(max_internal_blocks_alloc_at_once, remaining_internal_blocks);
+            if (budget_)
+                budget_->acquire(num_blocks * sizeof(internal_block_type));
             remaining_internal_blocks -= num_blocks;
             internal_block_type* iblocks = new internal_block_type[num_blocks];
             internal_blocks_blocks.push(iblocks);
@@ -368,11 +374,14 @@ protected:
 public:
     //! Create a block_scheduler with empty prediction sequence in simple mode.
     //! \param max_internal_memory Amount of internal memory (in bytes) the scheduler is allowed to use for acquiring, prefetching and caching.
-    explicit block_scheduler(const size_t max_internal_memory)
+    //! \param budget account the internal_blocks are charged to when they are allocated. The account must outlive the scheduler.
+    explicit block_scheduler(const size_t max_internal_memory,
+                             memory_budget::account* budget = nullptr)
         : max_internal_blocks(div_ceil(max_internal_memory, sizeof(internal_block_type))),
           remaining_internal_blocks(max_internal_blocks),
           bm(block_manager::get_instance()),
-          algo(0)
+          algo(0),
+          budget_(budget)
     {
         algo = new block_scheduler_algorithm_online_lru<SwappableBlockType>(*this);
     }
@@ -408,6 +417,10 @@ public:
             delete[] internal_blocks_blocks.top();
             internal_blocks_blocks.pop();
         }
+        if (budget_) {
+            budget_->release(
+                (max_internal_blocks - remaining_internal_blocks) * sizeof(internal_block_type));
+        }
     }
 
     //! Acquire the given block.
@@ -14,10 +14,14 @@
 #define FOXXLL_MNG_BUF_ISTREAM_HEADER
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <foxxll/mng/async_schedule.hpp>
+#include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/config.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 #include <tlx/define/likely.hpp>
 
@@ -44,24 +48,27 @@ private:
     buf_istream() { }
 
 protected:
-    using prefetcher_type = block_prefetcher<block_type, bid_iterator_type>;
+    using schedule_type = windowed_prefetch_schedule<bid_iterator_type>;
+    using prefetcher_type = block_prefetcher<block_type, bid_iterator_type, schedule_type>;
     prefetcher_type* prefetcher;
     size_t current_elem;
     block_type* current_blk;
-    size_t* prefetch_seq;
 #ifdef BUF_ISTREAM_CHECK_END
     bool not_finished;
 #endif
 
 public:
     using reference = typename block_type::reference;
+    using iterator = typename block_type::iterator;
     using self_type = buf_istream<block_type, bid_iterator_type>;
 
     //! Constructs input stream object.
     //! \param begin \c bid_iterator pointing to the first block of the stream
     //! \param end \c bid_iterator pointing to the ( \b last + 1 ) block of the stream
     //! \param nbuffers number of buffers for internal use
-    buf_istream(bid_iterator_type begin, bid_iterator_type end, size_t nbuffers)
+    //! \param budget account the buffers are charged to, must outlive the stream
+    buf_istream(bid_iterator_type begin, bid_iterator_type end, size_t nbuffers,
+                memory_budget::account* budget = nullptr)
         : current_elem(0)
 #ifdef BUF_ISTREAM_CHECK_END
           , not_finished(true)
@@ -69,21 +76,17 @@ public:
     {
         const size_t ndisks = config::get_instance()->disks_number();
         const size_t mdevid = config::get_instance()->max_device_id();
-        const size_t seq_length = end - begin;
-        prefetch_seq = new size_t[seq_length];
+        const std::vector<double> service_times =
+            block_manager::get_instance()->device_service_times(
+                block_type::raw_size);
 
-        // obvious schedule
-        //for(size_t i = 0; i < seq_length; ++i)
-        //      prefetch_seq[i] = i;
-
-        // optimal schedule
+        // optimal schedule for the measured disk speeds, computed window by
+        // window while prefetching
         nbuffers = std::max(2 * ndisks, size_t(nbuffers - 1));
-        compute_prefetch_schedule(
-            begin, end, prefetch_seq,
-            nbuffers, mdevid
-        );
-
-        prefetcher = new prefetcher_type(begin, end, prefetch_seq, nbuffers);
+        prefetcher = new prefetcher_type(
+            begin, end,
+            schedule_type(begin, end, nbuffers, mdevid, 0, service_times),
+            nbuffers, completion_handler(), budget);
 
         current_blk = prefetcher->pull_block();
     }
@@ -152,11 +155,46 @@ public:
         return *this;
     }
 
+    //! Returns the unread records of the current block as [first, last) for
+    //! processing in place. The span is never empty before the end of the
+    //! stream, at a block boundary it covers the whole block.
+    std::pair<iterator, iterator> next_span()
+    {
+#ifdef BUF_ISTREAM_CHECK_END
+        assert(not_finished);
+#endif
+        return std::make_pair(
+            current_blk->begin() + current_elem, current_blk->end());
+    }
+
+    //! Marks the first n records of next_span() as read, moving on to the
+    //! next block once all of them are.
+    //! \return reference to itself after the advance
+    self_type& consume(size_t n)
+    {
+#ifdef BUF_ISTREAM_CHECK_END
+        assert(not_finished);
+#endif
+        assert(current_elem + n <= block_type::size);
+
+        current_elem += n;
+
+        if (current_elem >= block_type::size)
+        {
+            current_elem = 0;
+#ifdef BUF_ISTREAM_CHECK_END
+            not_finished = prefetcher->block_consumed(current_blk);
+#else
+            prefetcher->block_consumed(current_blk);
+#endif
+        }
+        return *this;
+    }
+
     //! Frees used internal objects.
     ~buf_istream()
     {
         delete prefetcher;
-        delete[] prefetch_seq;
     }
 };
 
@@ -15,11 +15,15 @@
 #define FOXXLL_MNG_BUF_ISTREAM_REVERSE_HEADER
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <foxxll/mng/async_schedule.hpp>
 #include <foxxll/mng/bid.hpp>
+#include <foxxll/mng/block_manager.hpp>
 #include <foxxll/mng/block_prefetcher.hpp>
 #include <foxxll/mng/config.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 #include <tlx/define/likely.hpp>
 
@@ -50,11 +54,11 @@ private:
     buf_istream_reverse() { }
 
 protected:
-    using prefetcher_type = block_prefetcher<block_type, typename bid_vector_type::iterator>;
+    using schedule_type = windowed_prefetch_schedule<typename bid_vector_type::iterator>;
+    using prefetcher_type = block_prefetcher<block_type, typename bid_vector_type::iterator, schedule_type>;
     prefetcher_type* prefetcher;
     size_t current_elem;
     block_type* current_blk;
-    size_t* prefetch_seq;
 #ifdef BUF_ISTREAM_CHECK_END
     bool not_finished;
 #endif
@@ -62,13 +66,16 @@ protected:
 
 public:
     using reference = typename block_type::reference;
+    using iterator = typename block_type::iterator;
     using self_type = buf_istream_reverse<block_type, bid_iterator_type>;
 
     //! Constructs input stream object, reading [first,last) blocks in reverse.
     //! \param begin \c bid_iterator pointing to the first block of the stream
     //! \param end \c bid_iterator pointing to the ( \b last + 1 ) block of the stream
     //! \param nbuffers number of buffers for internal use
-    buf_istream_reverse(bid_iterator_type begin, bid_iterator_type end, size_t nbuffers)
+    //! \param budget account the buffers are charged to, must outlive the stream
+    buf_istream_reverse(bid_iterator_type begin, bid_iterator_type end, size_t nbuffers,
+                        memory_budget::account* budget = nullptr)
         : current_elem(0),
 #ifdef BUF_ISTREAM_CHECK_END
           not_finished(true),
@@ -81,18 +88,20 @@ public:
         // calculate prefetch sequence
         const size_t ndisks = config::get_instance()->disks_number();
         const size_t mdevid = config::get_instance()->max_device_id();
+        const std::vector<double> service_times =
+            block_manager::get_instance()->device_service_times(
+                block_type::raw_size);
 
-        prefetch_seq = new size_t[bids_.size()];
-
-        // optimal schedule
+        // optimal schedule for the measured disk speeds, computed window by
+        // window while prefetching
         nbuffers = std::max(2 * ndisks, nbuffers - 1);
-        compute_prefetch_schedule(
-            bids_.begin(), bids_.end(), prefetch_seq,
-            nbuffers, mdevid
-        );
 
         // create stream prefetcher
-        prefetcher = new prefetcher_type(bids_.begin(), bids_.end(), prefetch_seq, nbuffers);
+        prefetcher = new prefetcher_type(
+            bids_.begin(), bids_.end(),
+            schedule_type(bids_.begin(), bids_.end(), nbuffers, mdevid,
+                          0, service_times),
+            nbuffers, completion_handler(), budget);
 
         // fetch block: last in sequence
         current_blk = prefetcher->pull_block();
@@ -170,11 +179,49 @@ public:
         return *this;
     }
 
+    //! Returns the unread records of the current block as [first, last) for
+    //! processing in place, they are read from last - 1 down to first. The
+    //! span is never empty before the end of the stream, at a block boundary
+    //! it covers the whole block.
+    std::pair<iterator, iterator> next_span()
+    {
+#ifdef BUF_ISTREAM_CHECK_END
+        assert(not_finished);
+#endif
+        return std::make_pair(
+            current_blk->begin(), current_blk->begin() + current_elem + 1);
+    }
+
+    //! Marks the last n records of next_span() as read, moving on to the
+    //! previous block once all of them are.
+    //! \return reference to itself after the advance
+    self_type& consume(size_t n)
+    {
+#ifdef BUF_ISTREAM_CHECK_END
+        assert(not_finished);
+#endif
+        assert(n <= current_elem + 1);
+
+        if (n > current_elem)
+        {
+            current_elem = block_type::size - 1;
+#ifdef BUF_ISTREAM_CHECK_END
+            not_finished = prefetcher->block_consumed(current_blk);
+#else
+            prefetcher->block_consumed(current_blk);
+#endif
+        }
+        else
+        {
+            current_elem -= n;
+        }
+        return *this;
+    }
+
     //! Frees used internal objects.
     ~buf_istream_reverse()
     {
         delete prefetcher;
-        delete[] prefetch_seq;
     }
 };
 
@@ -13,7 +13,12 @@
 #ifndef FOXXLL_MNG_BUF_OSTREAM_HEADER
 #define FOXXLL_MNG_BUF_OSTREAM_HEADER
 
+#include <cassert>
+#include <utility>
+
+#include <foxxll/io/request.hpp>
 #include <foxxll/mng/buf_writer.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 #include <tlx/define/likely.hpp>
 
@@ -42,13 +47,21 @@ protected:
 public:
     using const_reference = typename block_type::const_reference;
     using reference = typename block_type::reference;
+    using iterator = typename block_type::iterator;
     using self_type = buf_ostream<block_type, bid_iterator_type>;
 
     //! Constructs output stream object.
     //! \param first_bid \c bid_iterator pointing to the first block of the stream
     //! \param nbuffers number of buffers for internal use
-    buf_ostream(bid_iterator_type first_bid, size_t nbuffers)
-        : writer(nbuffers, nbuffers / 2), current_bid(first_bid),
+    //! \param batch_size number of filled blocks collected before writing
+    //! them sorted by file and offset, adjacent blocks with a single request
+    //! (default: half of the buffers)
+    //! \param budget account the buffers are charged to, must outlive the stream
+    buf_ostream(bid_iterator_type first_bid, size_t nbuffers,
+                size_t batch_size = 0,
+                memory_budget::account* budget = nullptr)
+        : writer(nbuffers, batch_size ? batch_size : nbuffers / 2, budget),
+          current_bid(first_bid),
           current_elem(0)
     {
         current_blk = writer.get_free_block();
@@ -100,6 +113,43 @@ public:
         return *this;
     }
 
+    //! Returns the unwritten records of the current block as [first, last) to
+    //! be filled in place. The span is never empty, at a block boundary it
+    //! covers the whole block.
+    std::pair<iterator, iterator> next_span()
+    {
+        return std::make_pair(
+            current_blk->begin() + current_elem, current_blk->end());
+    }
+
+    //! Marks the first n records of next_span() as written, submitting the
+    //! block for writing once it is full.
+    //! \return reference to itself after the advance
+    self_type& commit(size_t n)
+    {
+        assert(current_elem + n <= block_type::size);
+
+        current_elem += n;
+
+        if (current_elem >= block_type::size)
+        {
+            current_elem = 0;
+            current_blk = writer.write(current_blk, *(current_bid++));
+        }
+        return *this;
+    }
+
+    //! Writes a whole block owned by the caller as the next block of the
+    //! stream, without copying it into the internal buffers. The stream must
+    //! be at a block boundary.
+    //! \warning \c block must not change until the returned request is
+    //! completed
+    request_ptr write_block(block_type& block)
+    {
+        assert(current_elem == 0);
+        return block.write(*(current_bid++));
+    }
+
     //! Fill current block with padding and flush
     self_type & fill(const_reference record)
     {
@@ -13,11 +13,14 @@
 #ifndef FOXXLL_MNG_BUF_WRITER_HEADER
 #define FOXXLL_MNG_BUF_WRITER_HEADER
 
-#include <queue>
+#include <algorithm>
+#include <functional>
 #include <vector>
 
 #include <foxxll/io/disk_queues.hpp>
+#include <foxxll/io/file.hpp>
 #include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 #include <tlx/define/likely.hpp>
 
@@ -47,42 +50,110 @@ protected:
     request_ptr* write_reqs;
     const size_t writebatchsize;
 
+    //! budget the write buffers are charged to, if any
+    memory_budget::account* budget_;
+
     std::vector<size_t> free_write_blocks;            // contains free write blocks
     std::vector<size_t> busy_write_blocks;            // blocks that are in writing, notice that if block is not in free_
     // an not in busy then block is not yet filled
 
     struct batch_entry
     {
+        file* storage;
         int64_t offset;
         size_t ibuffer;
-        batch_entry(int64_t o, size_t b) : offset(o), ibuffer(b) { }
+        batch_entry(file* s, int64_t o, size_t b)
+            : storage(s), offset(o), ibuffer(b) { }
     };
     struct batch_entry_cmp
     {
         bool operator () (const batch_entry& a, const batch_entry& b) const
         {
-            return (a.offset > b.offset);
+            if (a.storage != b.storage)
+                return std::less<file*>()(a.storage, b.storage);
+            return (a.offset < b.offset);
         }
     };
 
-    using batch_type = std::priority_queue<batch_entry, std::vector<batch_entry>, batch_entry_cmp>;
-    batch_type batch_write_blocks;      // sorted sequence of blocks to write
+    using batch_type = std::vector<batch_entry>;
+    batch_type batch_write_blocks;      // blocks to write, sorted when flushed
+
+    //! Writes the batch sorted by file and offset. Runs of blocks which are
+    //! adjacent both in the file and in the buffer array are written with a
+    //! single request.
+    void flush_batch()
+    {
+        std::sort(batch_write_blocks.begin(), batch_write_blocks.end(),
+                  batch_entry_cmp());
+
+        for (size_t i = 0; i < batch_write_blocks.size(); )
+        {
+            const batch_entry& first = batch_write_blocks[i];
+            size_t j = i + 1;
+            if (first.storage->supports_multiblock_requests())
+            {
+                while (j < batch_write_blocks.size() &&
+                       batch_write_blocks[j].storage == first.storage &&
+                       batch_write_blocks[j].offset == first.offset +
+                       int64_t((j - i) * block_type::raw_size) &&
+                       batch_write_blocks[j].ibuffer == first.ibuffer + (j - i))
+                    ++j;
+            }
+
+            for (size_t k = i; k < j; ++k)
+            {
+                const size_t ibuffer = batch_write_blocks[k].ibuffer;
+                if (write_reqs[ibuffer].valid())
+                    write_reqs[ibuffer]->wait();
+            }
+
+            request_ptr req;
+            if (j - i == 1) {
+                req = write_buffers[first.ibuffer].write(write_bids[first.ibuffer]);
+            }
+            else {
+                TLX_LOG << "Merging " << j - i << " blocks into one write";
+                req = first.storage->awrite(
+                    write_buffers + first.ibuffer, first.offset,
+                    (j - i) * block_type::raw_size);
+            }
+
+            for (size_t k = i; k < j; ++k)
+            {
+                const size_t ibuffer = batch_write_blocks[k].ibuffer;
+                write_reqs[ibuffer] = req;
+                busy_write_blocks.push_back(ibuffer);
+            }
+            i = j;
+        }
+        batch_write_blocks.clear();
+    }
 
 public:
     //! Constructs an object.
     //! \param write_buf_size number of write buffers to use
     //! \param write_batch_size number of blocks to accumulate in
     //!        order to flush write requests (bulk buffered writing)
-    buffered_writer(size_t write_buf_size, size_t write_batch_size)
+    //! \param budget account the write buffers are charged to, blocking until
+    //!        they fit. The account must outlive the writer.
+    buffered_writer(size_t write_buf_size, size_t write_batch_size,
+                    memory_budget::account* budget = nullptr)
         : nwriteblocks((write_buf_size > 2) ? write_buf_size : 2),
-          writebatchsize(write_batch_size ? write_batch_size : 1)
+          // a full batch must leave a buffer to fill
+          writebatchsize(
+              std::min(std::max(write_batch_size, size_t(1)), nwriteblocks - 1)),
+          budget_(budget)
     {
+        if (budget_)
+            budget_->acquire(nwriteblocks * block_type::raw_size);
         write_buffers = new block_type[nwriteblocks];
         write_reqs = new request_ptr[nwriteblocks];
 
         write_bids = new bid_type[nwriteblocks];
 
-        for (size_t i = 0; i < nwriteblocks; i++)
+        // hand out buffers in ascending order, such that sequentially
+        // allocated blocks can be merged
+        for (size_t i = nwriteblocks; i-- > 0; )
             free_write_blocks.push_back(i);
 
         disk_queues::get_instance()->set_priority_op(request_queue::WRITE);
@@ -137,26 +208,12 @@ public:
     block_type * write(block_type* filled_block, const bid_type& bid)          // writes filled_block and returns a new block
     {
         if (batch_write_blocks.size() >= writebatchsize)
-        {
-            // flush batch
-            while (!batch_write_blocks.empty())
-            {
-                size_t ibuffer = batch_write_blocks.top().ibuffer;
-                batch_write_blocks.pop();
-
-                if (write_reqs[ibuffer].valid())
-                    write_reqs[ibuffer]->wait();
-
-                write_reqs[ibuffer] = write_buffers[ibuffer].write(write_bids[ibuffer]);
-
-                busy_write_blocks.push_back(ibuffer);
-            }
-        }
+            flush_batch();
         TLX_LOG << "Adding write request to batch";
 
         size_t ibuffer = filled_block - write_buffers;
         write_bids[ibuffer] = bid;
-        batch_write_blocks.push(batch_entry(bid.offset, ibuffer));
+        batch_write_blocks.push_back(batch_entry(bid.storage, bid.offset, ibuffer));
 
         return get_free_block();
     }
@@ -164,18 +221,7 @@ public:
     void flush()
     {
         size_t ibuffer;
-        while (!batch_write_blocks.empty())
-        {
-            ibuffer = batch_write_blocks.top().ibuffer;
-            batch_write_blocks.pop();
-
-            if (write_reqs[ibuffer].valid())
-                write_reqs[ibuffer]->wait();
-
-            write_reqs[ibuffer] = write_buffers[ibuffer].write(write_bids[ibuffer]);
-
-            busy_write_blocks.push_back(ibuffer);
-        }
+        flush_batch();
         for (auto it = busy_write_blocks.begin(); it != busy_write_blocks.end(); it++)
         {
             ibuffer = *it;
@@ -186,7 +232,7 @@ public:
         free_write_blocks.clear();
         busy_write_blocks.clear();
 
-        for (size_t i = 0; i < nwriteblocks; i++)
+        for (size_t i = nwriteblocks; i-- > 0; )
             free_write_blocks.push_back(i);
     }
 
@@ -194,18 +240,7 @@ public:
     ~buffered_writer()
     {
         size_t ibuffer;
-        while (!batch_write_blocks.empty())
-        {
-            ibuffer = batch_write_blocks.top().ibuffer;
-            batch_write_blocks.pop();
-
-            if (write_reqs[ibuffer].valid())
-                write_reqs[ibuffer]->wait();
-
-            write_reqs[ibuffer] = write_buffers[ibuffer].write(write_bids[ibuffer]);
-
-            busy_write_blocks.push_back(ibuffer);
-        }
+        flush_batch();
         for (auto it = busy_write_blocks.begin(); it != busy_write_blocks.end(); it++)
         {
             ibuffer = *it;
@@ -215,6 +250,9 @@ public:
         delete[] write_reqs;
         delete[] write_buffers;
         delete[] write_bids;
+
+        if (budget_)
+            budget_->release(nwriteblocks * block_type::raw_size);
     }
 };
 
@@ -0,0 +1,269 @@
+/***************************************************************************
+ *  foxxll/mng/compact_bid_array.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_COMPACT_BID_ARRAY_HEADER
+#define FOXXLL_MNG_COMPACT_BID_ARRAY_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include <foxxll/mng/bid.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * Read-only sequence of BIDs stored as runs of contiguous blocks.
+ *
+ * A run of width k stores k base BIDs; block j of the run lies Size bytes *
+ * (j / k) behind base j % k. A run of width one is a contiguous extent of one
+ * file, a run of width D covers a sequence striped over D disks on which each
+ * disk allocated contiguously. Sequences allocated by block_manager::new_blocks
+ * therefore need a few runs instead of one BID per block.
+ *
+ * Elements are returned by value, iterators are random access iterators over
+ * BID<Size> values and can be passed to buf_istream, buf_ostream,
+ * block_prefetcher and block_manager::delete_blocks().
+ */
+template <size_t Size>
+class compact_bid_array
+{
+    static_assert(Size != 0, "compact_bid_array requires a fixed block size");
+
+public:
+    using bid_type = BID<Size>;
+    using size_type = size_t;
+
+    //! maximum number of bases of a run, i.e. the longest stripe compressed
+    static constexpr size_t max_width = 64;
+
+    class const_iterator;
+
+    compact_bid_array() = default;
+
+    //! number of BIDs
+    size_t size() const { return size_; }
+
+    //! whether the sequence is empty
+    bool empty() const { return size_ == 0; }
+
+    //! number of runs the sequence is stored in
+    size_t num_runs() const { return runs_.size(); }
+
+    //! bytes of memory used by the encoding
+    size_t memory_usage() const
+    {
+        return runs_.capacity() * sizeof(run) +
+               bases_.capacity() * sizeof(bid_type);
+    }
+
+    //! remove all BIDs
+    void clear()
+    {
+        runs_.clear();
+        bases_.clear();
+        size_ = 0;
+    }
+
+    //! release unused capacity
+    void shrink_to_fit()
+    {
+        runs_.shrink_to_fit();
+        bases_.shrink_to_fit();
+    }
+
+    //! swap contents with another array
+    void swap(compact_bid_array& other)
+    {
+        runs_.swap(other.runs_);
+        bases_.swap(other.bases_);
+        std::swap(size_, other.size_);
+    }
+
+    //! append a BID, extending the last run if it continues its pattern
+    void push_back(const bid_type& bid)
+    {
+        if (!runs_.empty())
+        {
+            run& r = runs_.back();
+            const uint64_t j = size_ - r.first;
+
+            if (r.open)
+            {
+                // first cycle of the run: a continuation of the first base
+                // closes it, other BIDs become further bases
+                const bid_type& base0 = bases_[r.base];
+                if (bid.storage == base0.storage &&
+                    bid.offset == base0.offset + Size)
+                {
+                    r.open = false;
+                    ++size_;
+                    return;
+                }
+                if (r.width < max_width && r.base + r.width == bases_.size())
+                {
+                    bases_.push_back(bid);
+                    ++r.width;
+                    ++size_;
+                    return;
+                }
+            }
+            else if (bid == at(r, j))
+            {
+                ++size_;
+                return;
+            }
+        }
+
+        assert(bases_.size() < (size_t(1) << 31));
+
+        run r;
+        r.first = size_;
+        r.base = static_cast<uint32_t>(bases_.size());
+        r.width = 1;
+        r.open = true;
+        runs_.push_back(r);
+        bases_.push_back(bid);
+        ++size_;
+    }
+
+    //! BID at position i
+    bid_type operator [] (size_t i) const
+    {
+        assert(i < size_);
+        const run& r = *find_run(i);
+        return at(r, i - r.first);
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    //! a sequence of blocks following one stripe pattern
+    struct run {
+        //! position of the first block of the run in the sequence
+        uint64_t first;
+        //! index of the first base in bases_
+        uint32_t base : 31;
+        //! still in the first cycle, blocks become additional bases
+        uint32_t open : 1;
+        //! number of bases
+        uint32_t width;
+    };
+
+    //! runs ordered by position
+    std::vector<run> runs_;
+
+    //! bases of all runs
+    std::vector<bid_type> bases_;
+
+    //! number of BIDs
+    size_t size_ = 0;
+
+    //! block j of run r
+    bid_type at(const run& r, uint64_t j) const
+    {
+        const bid_type& base = bases_[r.base + j % r.width];
+        return bid_type(base.storage, base.offset + (j / r.width) * Size);
+    }
+
+    //! run containing position i
+    typename std::vector<run>::const_iterator find_run(size_t i) const
+    {
+        return std::upper_bound(
+            runs_.begin(), runs_.end(), static_cast<uint64_t>(i),
+            [](uint64_t pos, const run& r) { return pos < r.first; }) - 1;
+    }
+};
+
+//! Random access iterator of compact_bid_array, dereferences to BID values.
+template <size_t Size>
+class compact_bid_array<Size>::const_iterator
+{
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = BID<Size>;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+
+    //! proxy for operator ->, holds a copy of the BID
+    struct pointer {
+        value_type bid;
+        const value_type* operator -> () const { return &bid; }
+    };
+
+    const_iterator() = default;
+
+    const_iterator(const compact_bid_array* array, size_t pos)
+        : array_(array), pos_(pos) { }
+
+    reference operator * () const { return (*array_)[pos_]; }
+    pointer operator -> () const { return pointer { **this }; }
+    reference operator [] (difference_type n) const
+    {
+        return (*array_)[pos_ + n];
+    }
+
+    const_iterator& operator ++ () { ++pos_; return *this; }
+    const_iterator& operator -- () { --pos_; return *this; }
+    const_iterator operator ++ (int) { const_iterator t = *this; ++pos_; return t; }
+    const_iterator operator -- (int) { const_iterator t = *this; --pos_; return t; }
+
+    const_iterator& operator += (difference_type n) { pos_ += n; return *this; }
+    const_iterator& operator -= (difference_type n) { pos_ -= n; return *this; }
+
+    const_iterator operator + (difference_type n) const
+    {
+        return const_iterator(array_, pos_ + n);
+    }
+    friend const_iterator operator + (difference_type n, const const_iterator& it)
+    {
+        return it + n;
+    }
+    const_iterator operator - (difference_type n) const
+    {
+        return const_iterator(array_, pos_ - n);
+    }
+    difference_type operator - (const const_iterator& other) const
+    {
+        return static_cast<difference_type>(pos_) -
+               static_cast<difference_type>(other.pos_);
+    }
+
+    bool operator == (const const_iterator& o) const { return pos_ == o.pos_; }
+    bool operator != (const const_iterator& o) const { return pos_ != o.pos_; }
+    bool operator < (const const_iterator& o) const { return pos_ < o.pos_; }
+    bool operator > (const const_iterator& o) const { return pos_ > o.pos_; }
+    bool operator <= (const const_iterator& o) const { return pos_ <= o.pos_; }
+    bool operator >= (const const_iterator& o) const { return pos_ >= o.pos_; }
+
+private:
+    const compact_bid_array* array_ = nullptr;
+    size_t pos_ = 0;
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_COMPACT_BID_ARRAY_HEADER
+
+/**************************************************************************/
@@ -0,0 +1,394 @@
+/***************************************************************************
+ *  foxxll/mng/concurrent_prefetch_pool.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_CONCURRENT_PREFETCH_POOL_HEADER
+#define FOXXLL_MNG_CONCURRENT_PREFETCH_POOL_HEADER
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tlx/die/core.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/io/request.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Prefetching pool shared by multiple threads.
+ *
+ * Provides the interface of prefetch_pool, but all methods may be called
+ * concurrently. The hinted blocks and the free blocks are split into shards,
+ * each protected by its own mutex. A block is hinted in and read from the
+ * shard selected by the hash of its BID, such that consumers scanning
+ * different parts of a sequence rarely meet on the same lock. A hint takes a
+ * free block of its shard, or steals one from another shard if its own is
+ * empty, hence all consumers share one read-ahead budget.
+ *
+ * Unlike prefetch_pool there is no interaction with a write_pool, which is
+ * not thread-safe.
+ */
+template <class BlockType>
+class concurrent_prefetch_pool
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_type = typename block_type::bid_type;
+
+protected:
+    struct bid_hash
+    {
+        size_t operator () (const bid_type& bid) const noexcept
+        {
+            // consecutive blocks of a file go to consecutive shards
+            return size_t(bid.offset / block_type::raw_size) +
+                   (size_t(bid.storage) >> 4);
+        }
+    };
+
+    using busy_entry = std::pair<block_type*, request_ptr>;
+    using unordered_map_type =
+        typename std::unordered_map<bid_type, busy_entry, bid_hash>;
+
+    struct shard
+    {
+        //! protects the members of this shard
+        std::mutex mutex;
+
+        //! free prefetch blocks of this shard
+        std::vector<block_type*> free_blocks;
+
+        //! blocks that are in reading or already read but not retrieved
+        unordered_map_type busy_blocks;
+    };
+
+    //! the shards, allocated separately to keep their mutexes apart
+    std::vector<std::unique_ptr<shard> > shards_;
+
+    //! total number of free blocks in all shards
+    std::atomic<size_t> free_size_ { 0 };
+
+    //! total number of hinted blocks in all shards
+    std::atomic<size_t> busy_size_ { 0 };
+
+    //! shard receiving the next added block
+    std::atomic<size_t> next_shard_ { 0 };
+
+    shard& shard_of(const bid_type& bid)
+    {
+        return *shards_[bid_hash()(bid) % shards_.size()];
+    }
+
+    //! take a free block of shard s, expects its mutex to be locked
+    block_type * take_free(shard& s)
+    {
+        if (s.free_blocks.empty())
+            return nullptr;
+        block_type* block = s.free_blocks.back();
+        s.free_blocks.pop_back();
+        --free_size_;
+        return block;
+    }
+
+    //! put a free block into shard s, expects its mutex to be locked
+    void put_free(shard& s, block_type* block)
+    {
+        s.free_blocks.push_back(block);
+        ++free_size_;
+    }
+
+    //! take a free block from any shard other than home, locking one shard
+    //! at a time
+    block_type * steal_free(const shard* home)
+    {
+        for (std::unique_ptr<shard>& s : shards_)
+        {
+            if (free_size_ == 0)
+                break;
+            if (s.get() == home)
+                continue;
+            std::unique_lock<std::mutex> lock(s->mutex);
+            if (block_type* block = take_free(*s))
+                return block;
+        }
+        return nullptr;
+    }
+
+public:
+    /*!
+     * Constructs pool.
+     *
+     * \param init_size initial number of blocks in the pool
+     * \param num_shards number of independently locked shards
+     */
+    explicit concurrent_prefetch_pool(
+        size_t init_size = 1, size_t num_shards = 16)
+    {
+        tlx_die_unless(num_shards > 0);
+        shards_.reserve(num_shards);
+        for (size_t i = 0; i < num_shards; ++i)
+            shards_.emplace_back(new shard);
+        resize(init_size);
+    }
+
+    //! non-copyable: delete copy-constructor
+    concurrent_prefetch_pool(const concurrent_prefetch_pool&) = delete;
+    //! non-copyable: delete assignment operator
+    concurrent_prefetch_pool& operator = (const concurrent_prefetch_pool&) = delete;
+
+    //! Waits for completion of all ongoing read requests and frees memory.
+    virtual ~concurrent_prefetch_pool()
+    {
+        for (std::unique_ptr<shard>& s : shards_)
+        {
+            for (block_type* block : s->free_blocks)
+                delete block;
+
+            try
+            {
+                for (auto& entry : s->busy_blocks)
+                {
+                    entry.second.second->wait();
+                    delete entry.second.first;
+                }
+            }
+            catch (...)
+            { }
+        }
+    }
+
+    //! Returns number of owned blocks.
+    size_t size() const
+    {
+        return free_size_ + busy_size_;
+    }
+
+    //! Returns the number of free prefetching blocks.
+    size_t free_size() const
+    {
+        return free_size_;
+    }
+
+    //! Returns the number of busy prefetching blocks.
+    size_t busy_size() const
+    {
+        return busy_size_;
+    }
+
+    //! Returns the number of shards.
+    size_t num_shards() const
+    {
+        return shards_.size();
+    }
+
+    //! Add a new block to prefetch pool, enlarges size of pool.
+    void add(block_type*& block)
+    {
+        shard& s = *shards_[next_shard_++ % shards_.size()];
+        std::unique_lock<std::mutex> lock(s.mutex);
+        put_free(s, block);
+        block = nullptr; // prevent caller from using the block any further
+    }
+
+    //! Take out a block from the pool, one unhinted free block must be
+    //! available.
+    //! \return pointer to the block. Ownership of the block goes to the caller.
+    block_type * steal()
+    {
+        block_type* block = steal_free(nullptr);
+        tlx_die_unless(block != nullptr);
+        return block;
+    }
+
+    //! Take out a free block from the pool if one is available.
+    //! \return pointer to the block, or nullptr. Ownership of the block goes
+    //! to the caller.
+    block_type * try_steal()
+    {
+        return steal_free(nullptr);
+    }
+
+    /*!
+     * Gives a hint for prefetching a block, the block may or may not be read
+     * into a prefetch buffer.
+     *
+     * \param bid address of a block to be prefetched
+     * \return \c true if the block is already hinted or there was a free
+     * block to prefetch it, \c false otherwise
+     */
+    bool hint(bid_type bid)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+
+        // if block is already hinted, no need to hint it again
+        if (s.busy_blocks.find(bid) != s.busy_blocks.end()) {
+            TLX_LOG << "concurrent_prefetch_pool::hint bid=" << bid << " was already cached";
+            return true;
+        }
+
+        block_type* block = take_free(s);
+        if (!block)
+        {
+            lock.unlock();
+            block = steal_free(&s);
+            if (!block) {
+                TLX_LOG << "concurrent_prefetch_pool::hint bid=" << bid << " => no free blocks for prefetching";
+                return false;
+            }
+            lock.lock();
+
+            // another thread may have hinted the block meanwhile
+            if (s.busy_blocks.find(bid) != s.busy_blocks.end()) {
+                put_free(s, block);
+                return true;
+            }
+        }
+
+        TLX_LOG << "concurrent_prefetch_pool::hint bid=" << bid << " => prefetching";
+        request_ptr req = block->read(bid);
+        s.busy_blocks[bid] = busy_entry(block, req);
+        ++busy_size_;
+        return true;
+    }
+
+    //! Cancel a hint request in case the block is no longer desired.
+    bool invalidate(bid_type bid)
+    {
+        shard& s = shard_of(bid);
+        busy_entry entry;
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            typename unordered_map_type::iterator it = s.busy_blocks.find(bid);
+            if (it == s.busy_blocks.end())
+                return false;
+            entry = it->second;
+            s.busy_blocks.erase(it);
+            --busy_size_;
+        }
+
+        entry.second->cancel();
+        entry.second->wait();
+
+        std::unique_lock<std::mutex> lock(s.mutex);
+        put_free(s, entry.first);
+        return true;
+    }
+
+    //! Checks if a block is in the hinted block set.
+    bool in_prefetching(bid_type bid)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+        return s.busy_blocks.find(bid) != s.busy_blocks.end();
+    }
+
+    //! Returns the request pointer for a hinted block, or an invalid nullptr
+    //! request in case it was not requested due to lack of prefetch buffers.
+    request_ptr find(bid_type bid)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+        typename unordered_map_type::iterator it = s.busy_blocks.find(bid);
+        if (it == s.busy_blocks.end())
+            return request_ptr(); // invalid pointer
+        return it->second.second;
+    }
+
+    //! Returns true if the blocks was hinted and the request is finished.
+    bool poll(bid_type bid)
+    {
+        request_ptr req = find(bid);
+        return req.valid() ? req->poll() : false;
+    }
+
+    /*!
+     * Reads block. If this block is cached block is not read but passed from
+     * the cache. If several threads read the same hinted block, only the
+     * first one receives the prefetched copy.
+     *
+     * \param block block object, where data to be read to. If block was cached
+     * \c block 's ownership goes to the pool and block from cache is returned
+     * in \c block value.
+     *
+     * \param bid address of the block
+     *
+     * \warning \c block parameter must be allocated dynamically using \c new .
+     *
+     * \return request pointer object of read operation
+     */
+    request_ptr read(block_type*& block, bid_type bid)
+    {
+        shard& s = shard_of(bid);
+        std::unique_lock<std::mutex> lock(s.mutex);
+
+        typename unordered_map_type::iterator it = s.busy_blocks.find(bid);
+        if (it == s.busy_blocks.end())
+        {
+            lock.unlock();
+            // not cached
+            TLX_LOG << "concurrent_prefetch_pool::read bid=" << bid << " => no copy in cache, retrieving to " << block;
+            return block->read(bid);
+        }
+
+        // cached
+        TLX_LOG << "concurrent_prefetch_pool::read bid=" << bid << " => copy in cache exists";
+        put_free(s, block);
+        block = it->second.first;
+        request_ptr result = it->second.second;
+        s.busy_blocks.erase(it);
+        --busy_size_;
+        return result;
+    }
+
+    //! Resizes size of the pool.
+    //! \param new_size desired size of the pool. If some
+    //! blocks are used for prefetching, these blocks can't be freed.
+    //! Only free blocks (not in prefetching) can be freed by reducing
+    //! the size of the pool calling this method.
+    //! \return new size of the pool
+    size_t resize(size_t new_size)
+    {
+        // spread new blocks evenly over the shards
+        while (size() < new_size)
+        {
+            block_type* block = new block_type;
+            add(block);
+        }
+
+        while (size() > new_size)
+        {
+            block_type* block = steal_free(nullptr);
+            if (!block)
+                break;
+            delete block;
+        }
+        return size();
+    }
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_CONCURRENT_PREFETCH_POOL_HEADER
+
+/**************************************************************************/
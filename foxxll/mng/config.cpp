@@ -47,7 +47,7 @@ static inline bool exist_file(const std::string& path)
 }
 
 config::config()
-    : is_initialized(false)
+    : first_flash(0), is_initialized(false)
 { }
 
 config::~config()
@@ -68,8 +68,6 @@ void config::initialize()
     TLX_LOG1 << get_version_string_long();
     print_library_version_mismatch();
 
-    first_flash = 0;
-
     // if disks_list is empty, then try to load disk configuration files
     if (disks_list.size() == 0)
     {
@@ -180,9 +178,44 @@ void config::load_config_file(const std::string& config_path)
 
 config& config::add_disk(const disk_config& cfg)
 {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // put flash devices after regular disks
+    if (cfg.flash) {
+        disks_list.push_back(cfg);
+    }
+    else {
+        disks_list.insert(disks_list.begin() + first_flash, cfg);
+        ++first_flash;
+    }
+    return *this;
+}
+
+void config::reserve_disks(size_t n)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    disks_list.reserve(n);
+}
+
+config& config::append_disk(const disk_config& cfg)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (disks_list.size() >= disks_list.capacity()) {
+        FOXXLL_THROW_INVALID_ARGUMENT(
+            "Cannot append disk '" << cfg.path << "', no room was reserved.");
+    }
+    if (!cfg.flash && first_flash != disks_list.size()) {
+        FOXXLL_THROW_INVALID_ARGUMENT(
+            "Cannot append regular disk '" << cfg.path << "' after "
+                                           << disks_list.size() - first_flash
+                                           << " flash devices.");
+    }
+
+    // within the reserved room, the entries stay in place
     disks_list.push_back(cfg);
-    // no flash disks anymore
-    ++first_flash;
+    if (!cfg.flash)
+        ++first_flash;
     return *this;
 }
 
@@ -205,12 +238,14 @@ void config::update_max_device_id(unsigned int devid)
 std::pair<unsigned, unsigned> config::regular_disk_range() const
 {
     assert(is_initialized);
+    std::unique_lock<std::mutex> lock(mutex_);
     return std::pair<unsigned, unsigned>(0, first_flash);
 }
 
 std::pair<unsigned, unsigned> config::flash_range() const
 {
     assert(is_initialized);
+    std::unique_lock<std::mutex> lock(mutex_);
     return std::pair<unsigned, unsigned>(
         first_flash, static_cast<unsigned>(disks_list.size())
     );
@@ -219,6 +254,7 @@ std::pair<unsigned, unsigned> config::flash_range() const
 disk_config& config::disk(size_t disk)
 {
     check_initialized();
+    std::unique_lock<std::mutex> lock(mutex_);
     assert(disk < disks_list.size());
     return disks_list[disk];
 }
@@ -273,6 +309,7 @@ const std::string& config::disk_io_impl(size_t disk) const
 external_size_type config::total_size() const
 {
     assert(is_initialized);
+    std::unique_lock<std::mutex> lock(mutex_);
 
     external_size_type total_size = 0;
 
@@ -290,6 +327,10 @@ external_size_type config::total_size() const
 disk_config::disk_config()
     : size(0),
       autogrow(true),
+      autogrow_chunk(default_autogrow_chunk),
+      bandwidth(0),
+      size_classes(false),
+      catalog(false),
       delete_on_exit(false),
       direct(DIRECT_TRY),
       flash(false),
@@ -306,6 +347,10 @@ disk_config::disk_config(const std::string& _path, external_size_type _size,
       size(_size),
       io_impl(_io_impl),
       autogrow(true),
+      autogrow_chunk(default_autogrow_chunk),
+      bandwidth(0),
+      size_classes(false),
+      catalog(false),
       delete_on_exit(false),
       direct(DIRECT_TRY),
       flash(false),
@@ -321,6 +366,10 @@ disk_config::disk_config(const std::string& _path, external_size_type _size,
 disk_config::disk_config(const std::string& line)
     : size(0),
       autogrow(true),
+      autogrow_chunk(default_autogrow_chunk),
+      bandwidth(0),
+      size_classes(false),
+      catalog(false),
       delete_on_exit(false),
       direct(DIRECT_TRY),
       flash(false),
@@ -354,6 +403,10 @@ void disk_config::parse_line(const std::string& line)
     // *** Set Default Extra Options ***
 
     autogrow = true; // was default for a long time, have to keep it this way
+    autogrow_chunk = default_autogrow_chunk;
+    bandwidth = 0;
+    size_classes = false;
+    catalog = false;
     delete_on_exit = false;
     direct = DIRECT_TRY;
     // flash is already set
@@ -419,6 +472,9 @@ void disk_config::parse_fileio()
 
     std::vector<std::string> param = tlx::split(' ', paramstr);
 
+    // whether deletion was requested explicitly, see catalog below
+    bool delete_requested = false;
+
     for (std::vector<std::string>::const_iterator p = param.begin();
          p != param.end(); ++p)
     {
@@ -447,9 +503,46 @@ void disk_config::parse_fileio()
                 );
             }
         }
+        else if (eq[0] == "alloc")
+        {
+            if (eq[1] == "extent") size_classes = false;
+            else if (eq[1] == "sizeclass") size_classes = true;
+            else
+            {
+                FOXXLL_THROW(
+                    std::runtime_error,
+                    "Invalid parameter '" << *p << "' in disk configuration file."
+                );
+            }
+        }
+        else if (eq[0] == "autogrow_chunk")
+        {
+            if (!tlx::parse_si_iec_units(eq[1], &autogrow_chunk, 'M')) {
+                FOXXLL_THROW(
+                    std::runtime_error,
+                    "Invalid parameter '" << *p << "' in disk configuration file."
+                );
+            }
+        }
+        else if (eq[0] == "bandwidth")
+        {
+            if (!tlx::parse_si_iec_units(eq[1], &bandwidth)) {
+                FOXXLL_THROW(
+                    std::runtime_error,
+                    "Invalid parameter '" << *p << "' in disk configuration file."
+                );
+            }
+        }
+        else if (*p == "catalog")
+        {
+            // the file and its catalog must outlive the process
+            catalog = true;
+            delete_on_exit = false;
+        }
         else if (*p == "delete" || *p == "delete_on_exit")
         {
             delete_on_exit = true;
+            delete_requested = true;
         }
         else if (*p == "direct" || *p == "nodirect" || eq[0] == "direct")
         {
@@ -471,6 +564,11 @@ void disk_config::parse_fileio()
                 );
             }
         }
+        else if (*p == "flash")
+        {
+            // written by fileio_string() in addition to the flash= prefix
+            flash = true;
+        }
         else if (eq[0] == "queue")
         {
             if (io_impl == "linuxaio") {
@@ -542,6 +640,29 @@ void disk_config::parse_fileio()
             );
         }
     }
+
+    // the catalog would outlive the blocks it refers to, in any token order
+    if (catalog && (delete_requested || unlink_on_open)) {
+        FOXXLL_THROW(
+            std::runtime_error,
+            "Parameter 'catalog' cannot be combined with "
+                << (unlink_on_open ? "'unlink'" : "'delete_on_exit'")
+                << " in disk configuration file."
+        );
+    }
+}
+
+//! format a byte count with the largest IEC unit dividing it exactly, such
+//! that parsing it does not apply the default unit of sizes (MiB)
+static std::string format_exact_size(external_size_type bytes)
+{
+    static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+
+    size_t u = 0;
+    while (bytes != 0 && bytes % 1024 == 0 && u + 1 < sizeof(units) / sizeof(units[0]))
+        bytes /= 1024, ++u;
+
+    return to_str(bytes) + units[u];
 }
 
 std::string disk_config::fileio_string() const
@@ -553,6 +674,18 @@ std::string disk_config::fileio_string() const
     if (!autogrow)
         oss << " autogrow=no";
 
+    if (size_classes)
+        oss << " alloc=sizeclass";
+
+    if (autogrow_chunk != default_autogrow_chunk)
+        oss << " autogrow_chunk=" << format_exact_size(autogrow_chunk);
+
+    if (bandwidth != 0)
+        oss << " bandwidth=" << bandwidth;
+
+    if (catalog)
+        oss << " catalog";
+
     if (delete_on_exit)
         oss << " delete_on_exit";
 
@@ -597,6 +730,12 @@ std::string disk_config::fileio_string() const
     return oss.str();
 }
 
+std::string disk_config::config_line() const
+{
+    return (flash ? "flash=" : "disk=") + path + "," +
+           format_exact_size(size) + "," + fileio_string();
+}
+
 } // namespace foxxll
 
 /**************************************************************************/
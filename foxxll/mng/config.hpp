@@ -17,6 +17,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -70,6 +71,10 @@ public:
     //! return formatted fileio name and optional configuration parameters
     std::string fileio_string() const;
 
+    //! return a disk=\<path>,\<size>,\<fileio> line which parse_line() turns
+    //! back into this configuration
+    std::string config_line() const;
+
 public:
     //! \name Optional Disk / File I/O Implementation Parameters
     //! \{
@@ -77,6 +82,26 @@ public:
     //! autogrow file if more disk space is needed, automatically set if size == 0.
     bool autogrow;
 
+    //! minimum number of bytes by which autogrow extends the file. Growth is
+    //! geometric beyond this, and happens in the background when possible.
+    external_size_type autogrow_chunk;
+
+    //! default value of autogrow_chunk
+    static constexpr external_size_type default_autogrow_chunk = 64 * 1024 * 1024;
+
+    //! read bandwidth of the device in bytes per second (bandwidth=), e.g. as
+    //! measured by foxxll_tool calibrate. Zero if unknown. Used to weigh the
+    //! disks in prefetch schedules until live statistics are available.
+    external_size_type bandwidth;
+
+    //! use size class free lists for fixed-size blocks instead of coalescing
+    //! all free space (alloc=sizeclass), see disk_block_allocator.
+    bool size_classes;
+
+    //! keep a persistent catalog of named BID sequences next to the file, such
+    //! that later processes can reattach to them, see block_manager.
+    bool catalog;
+
     //! delete file on program exit (default for autoconfigurated files)
     bool delete_on_exit;
 
@@ -124,6 +149,10 @@ class config : public singleton<config>
     //! In disks_list, flash devices come after all regular disks
     unsigned first_flash;
 
+    //! protects the length of disks_list and first_flash against disks
+    //! appended at runtime, the entries themselves never move
+    mutable std::mutex mutex_;
+
     //! Finished initializing config
     bool is_initialized;
 
@@ -162,9 +191,20 @@ public:
     //! Add a disk to the configuration list.
     //!
     //! \warning This function should only be used during initialization, as it
-    //! has no effect after construction of block_manager.
+    //! has no effect after construction of block_manager. Use
+    //! block_manager::add_disk() to add disks at runtime. Regular disks are
+    //! inserted before all flash devices.
     config & add_disk(const disk_config& cfg);
 
+    //! Reserve room for n disks, such that appending disks does not move the
+    //! entries of disks already in use. Called by block_manager.
+    void reserve_disks(size_t n);
+
+    //! Append a disk at runtime, called by block_manager::add_disk(). Disks
+    //! are identified by their position, hence a regular disk can only be
+    //! appended as long as there are no flash devices.
+    config & append_disk(const disk_config& cfg);
+
     //! \}
 
 protected:
@@ -195,6 +235,7 @@ public:
     size_t disks_number()
     {
         check_initialized();
+        std::unique_lock<std::mutex> lock(mutex_);
         return disks_list.size();
     }
 
@@ -11,7 +11,10 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <algorithm>
 #include <cassert>
+#include <exception>
+#include <iterator>
 #include <map>
 #include <ostream>
 #include <utility>
@@ -23,6 +26,280 @@
 
 namespace foxxll {
 
+disk_block_allocator::disk_block_allocator(file* storage, const disk_config& cfg)
+    : cfg_bytes_(cfg.size),
+      storage_(storage),
+      autogrow_(cfg.autogrow),
+      autogrow_chunk_(cfg.autogrow_chunk),
+      size_classes_(cfg.size_classes),
+      keep_size_(cfg.catalog)
+{
+    // initial growth to configured file size, files with a catalog keep the
+    // blocks of earlier processes beyond it
+    uint64_t initial_bytes = cfg.size;
+    if (keep_size_)
+        initial_bytes = std::max<uint64_t>(initial_bytes, storage_->size());
+
+    if (initial_bytes != 0) {
+        storage_->set_size(initial_bytes);
+        add_free_region(0, initial_bytes);
+        disk_bytes_ = initial_bytes;
+    }
+}
+
+disk_block_allocator::~disk_block_allocator()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        grow_terminate_ = true;
+        grow_cv_.notify_all();
+    }
+    if (grow_thread_.joinable())
+        grow_thread_.join();
+
+    if (!keep_size_ && disk_bytes_ > cfg_bytes_) { // reduce to original size
+        storage_->set_size(cfg_bytes_);
+    }
+}
+
+uint64_t disk_block_allocator::growth_size(uint64_t shortage) const
+{
+    if (!autogrow_)
+        return shortage;
+
+    // geometric growth: at least a quarter of the current file size, but
+    // not arbitrarily much space at once
+    const uint64_t step = std::min<uint64_t>(
+        disk_bytes_ / 4, static_cast<uint64_t>(max_growth_step));
+    uint64_t bytes = std::max(std::max(shortage, autogrow_chunk_), step);
+    return (bytes + BlockAlignment - 1) / BlockAlignment * BlockAlignment;
+}
+
+void disk_block_allocator::grow_file(
+    std::unique_lock<std::mutex>& lock, uint64_t shortage)
+{
+    grow_cv_.wait(lock, [this]() { return !growing_; });
+
+    uint64_t extend_bytes = growth_size(shortage);
+    if (extend_bytes == 0)
+        return;
+
+    try {
+        storage_->preallocate(disk_bytes_, extend_bytes);
+    }
+    catch (const bad_ext_alloc& e) {
+        if (shortage == 0)
+            throw;
+        // the file system is nearly full: grow sparsely by the shortage only
+        TLX_LOG1 << "disk_block_allocator: preallocating " << extend_bytes
+                 << " bytes failed, growing by " << shortage
+                 << " bytes: " << e.what();
+        extend_bytes = shortage;
+        storage_->set_size(disk_bytes_ + extend_bytes);
+    }
+    add_free_region(disk_bytes_, extend_bytes);
+    disk_bytes_ += extend_bytes;
+}
+
+void disk_block_allocator::ensure_free_space(
+    std::unique_lock<std::mutex>& lock, uint64_t requested_size)
+{
+    // the background thread may already be providing the space
+    grow_cv_.wait(
+        lock, [this, requested_size]() {
+            return !growing_ || free_bytes_ >= requested_size;
+        });
+
+    if (free_bytes_ < requested_size)
+        grow_file(lock, requested_size);
+}
+
+void disk_block_allocator::check_low_space()
+{
+    if (!autogrow_ || growing_ || grow_request_ != 0 || grow_terminate_)
+        return;
+
+    // start growing when less than an eighth of the file is free
+    if (free_bytes_ >= disk_bytes_ / 8)
+        return;
+
+    grow_request_ = growth_size(0);
+
+    TLX_LOG << "disk_block_allocator: free:" << free_bytes_
+            << " total:" << disk_bytes_
+            << ", growing in background by " << grow_request_;
+
+    if (!grow_thread_.joinable())
+        grow_thread_ = std::thread([this]() { grow_worker(); });
+    grow_cv_.notify_all();
+}
+
+void disk_block_allocator::grow_worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for ( ; ; )
+    {
+        grow_cv_.wait(
+            lock, [this]() { return grow_request_ != 0 || grow_terminate_; });
+
+        if (grow_terminate_)
+            return;
+
+        const uint64_t offset = disk_bytes_;
+        const uint64_t bytes = grow_request_;
+        grow_request_ = 0;
+        growing_ = true;
+
+        lock.unlock();
+
+        bool success = true;
+        try {
+            storage_->preallocate(offset, bytes);
+        }
+        catch (const std::exception& e) {
+            // the next allocation retries synchronously and reports errors
+            TLX_LOG1 << "disk_block_allocator: background growth failed: "
+                     << e.what();
+            success = false;
+        }
+
+        lock.lock();
+
+        if (success) {
+            add_free_region(offset, bytes);
+            disk_bytes_ += bytes;
+        }
+        growing_ = false;
+        grow_cv_.notify_all();
+    }
+}
+
+uint64_t disk_block_allocator::new_region(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    auto find_region = [this, bytes]() {
+                           return std::find_if(
+                               free_space_.begin(), free_space_.end(),
+                               [bytes](const place& entry) {
+                                   return (entry.second >= bytes);
+                               });
+                       };
+
+    space_map_type::iterator space = find_region();
+
+    if (space == free_space_.end() && free_list_bytes_ != 0) {
+        reclaim_free_lists();
+        space = find_region();
+    }
+
+    if (space == free_space_.end() && autogrow_) {
+        grow_file(lock, bytes);
+        space = find_region();
+    }
+
+    if (space == free_space_.end()) {
+        FOXXLL_THROW(
+            bad_ext_alloc,
+            "No contiguous region of " << bytes << " bytes, " <<
+                free_bytes_ << " bytes free."
+        );
+    }
+
+    const uint64_t region_pos = space->first;
+    const uint64_t region_size = space->second;
+    free_space_.erase(space);
+
+    if (region_size > bytes)
+        free_space_[region_pos + bytes] = region_size - bytes;
+
+    free_bytes_ -= bytes;
+    check_low_space();
+
+    return region_pos;
+}
+
+void disk_block_allocator::delete_region(uint64_t offset, uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    add_free_region(offset, bytes);
+}
+
+void disk_block_allocator::claim_region(uint64_t offset, uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (free_list_bytes_ != 0)
+        reclaim_free_lists();
+
+    // free region containing offset
+    space_map_type::iterator space = free_space_.upper_bound(offset);
+    if (space == free_space_.begin() ||
+        (--space, space->first + space->second < offset + bytes))
+    {
+        FOXXLL_THROW(
+            bad_ext_alloc,
+            "Region [" << offset << ", " << offset + bytes <<
+                ") to claim is not free."
+        );
+    }
+
+    const uint64_t region_pos = space->first;
+    const uint64_t region_size = space->second;
+    free_space_.erase(space);
+
+    if (region_pos < offset)
+        free_space_[region_pos] = offset - region_pos;
+    if (offset + bytes < region_pos + region_size)
+        free_space_[offset + bytes] = region_pos + region_size - offset - bytes;
+
+    free_bytes_ -= bytes;
+}
+
+void disk_block_allocator::reclaim_free_lists()
+{
+    TLX_LOG << "disk_block_allocator: reclaiming " << free_list_bytes_
+            << " bytes from free lists";
+
+    for (auto& list : free_lists_)
+    {
+        for (const uint64_t& offset : list.second) {
+            free_bytes_ -= list.first;
+            add_free_region(offset, list.first);
+        }
+        list.second.clear();
+    }
+    free_list_bytes_ = 0;
+    free_list_offsets_.clear();
+}
+
+void disk_block_allocator::add_free_list_block(
+    uint64_t block_pos, uint64_t block_size)
+{
+    // the block must neither be in a free list nor overlap free space
+    auto succ = free_space_.upper_bound(block_pos);
+    const bool overlaps_pred =
+        succ != free_space_.begin() &&
+        std::prev(succ)->first + std::prev(succ)->second > block_pos;
+    const bool overlaps_succ =
+        succ != free_space_.end() && block_pos + block_size > succ->first;
+
+    if (overlaps_pred || overlaps_succ ||
+        !free_list_offsets_.insert(block_pos).second)
+    {
+        FOXXLL_THROW2(
+            bad_ext_alloc, "disk_block_allocator::check_corruption",
+            "Error: double deallocation of external memory, trying to deallocate "
+            "block " << block_pos << " + " << block_size << " which is free already"
+        );
+    }
+
+    free_lists_[block_size].push_back(block_pos);
+    free_bytes_ += block_size;
+    free_list_bytes_ += block_size;
+}
+
 void disk_block_allocator::dump() const
 {
     uint64_t total = 0;
@@ -33,6 +310,13 @@ void disk_block_allocator::dump() const
         TLX_LOG1 << "Free chunk: begin: " << (cur->first) << " size: " << (cur->second);
         total += cur->second;
     }
+    for (const auto& list : free_lists_)
+    {
+        if (list.second.empty()) continue;
+        TLX_LOG1 << "Free list: block size: " << list.first
+                 << " blocks: " << list.second.size();
+        total += list.first * list.second.size();
+    }
     TLX_LOG1 << "Total bytes: " << total;
 }
 
@@ -18,10 +18,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <iterator>
 #include <map>
 #include <mutex>
 #include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <tlx/logger/core.hpp>
 
@@ -41,32 +47,33 @@ namespace foxxll {
  * This class manages allocation of blocks onto a single disk. It contains a map
  * of all currently allocated blocks. The block_manager selects which of the
  * disk_block_allocator objects blocks are drawn from.
+ *
+ * With autogrow, the file is extended in geometrically growing chunks of
+ * preallocated space, up to max_growth_step bytes. A background thread extends
+ * it before the free space runs out, such that new_blocks() rarely has to
+ * wait for the file system. If the file system has no room for a chunk, the
+ * file is extended sparsely by the missing bytes only.
+ *
+ * In size class mode (disk option alloc=sizeclass), freed blocks up to
+ * size_class_limit bytes are kept in per-size free lists instead of being
+ * coalesced into the free space map. Requests of uniformly sized blocks are
+ * served from these lists, which are refilled with slabs carved from the map,
+ * making allocation and deallocation of fixed-size blocks O(1) amortized. The
+ * lists are returned to the map when a request cannot be served otherwise.
  */
 class disk_block_allocator
 {
     constexpr static bool debug = false;
 
 public:
-    disk_block_allocator(file* storage, const disk_config& cfg)
-        : cfg_bytes_(cfg.size),
-          storage_(storage),
-          autogrow_(cfg.autogrow)
-    {
-        // initial growth to configured file size
-        grow_file(cfg.size);
-    }
+    disk_block_allocator(file* storage, const disk_config& cfg);
 
     //! non-copyable: delete copy-constructor
     disk_block_allocator(const disk_block_allocator&) = delete;
     //! non-copyable: delete assignment operator
     disk_block_allocator& operator = (const disk_block_allocator&) = delete;
 
-    ~disk_block_allocator()
-    {
-        if (disk_bytes_ > cfg_bytes_) { // reduce to original size
-            storage_->set_size(cfg_bytes_);
-        }
-    }
+    ~disk_block_allocator();
 
     //! Returns autogrow
     bool autogrow() const { return autogrow_; }
@@ -116,9 +123,35 @@ public:
                  << ">(pos=" << bid.offset << ", size=" << size_t(bid.size)
                  << "), free:" << free_bytes_ << " total:" << disk_bytes_;
 
+        const uint64_t size = bid.size;
+        if (size_classes_ && size <= size_class_limit) {
+            add_free_list_block(bid.offset, size);
+            return;
+        }
+
         add_free_region(bid.offset, bid.size);
     }
 
+    //! Allocate a contiguous region of given size, bypassing the size class
+    //! free lists, returns its offset. Throws bad_ext_alloc if out of space.
+    uint64_t new_region(uint64_t bytes);
+
+    //! Free a region or part of a region allocated by new_region().
+    void delete_region(uint64_t offset, uint64_t bytes);
+
+    //! Mark a free region at a given offset as allocated, e.g. blocks of an
+    //! earlier process. Throws bad_ext_alloc if it is not entirely free.
+    void claim_region(uint64_t offset, uint64_t bytes);
+
+    //! largest block size kept in size class free lists
+    static constexpr uint64_t size_class_limit = 64 * 1024 * 1024;
+
+    //! number of blocks carved from the free space map to refill a free list
+    static constexpr uint64_t size_class_slab = 64;
+
+    //! largest geometric growth step of autogrow
+    static constexpr uint64_t max_growth_step = 1024 * 1024 * 1024;
+
 private:
     //! pair (offset, size) used for free space calculation
     using place = std::pair<uint64_t, uint64_t>;
@@ -133,6 +166,31 @@ private:
     file* storage_;
     bool autogrow_;
 
+    //! minimum number of bytes to extend the file by
+    uint64_t autogrow_chunk_;
+
+    //! keep freed blocks in per-size free lists
+    bool size_classes_;
+    //! do not shrink the file, it holds catalogued blocks
+    bool keep_size_;
+    //! free lists of block offsets, by block size
+    std::unordered_map<uint64_t, std::vector<uint64_t> > free_lists_;
+    //! number of bytes in free_lists_, included in free_bytes_
+    uint64_t free_list_bytes_ = 0;
+    //! offsets of all blocks in free_lists_, to detect double deallocations
+    std::unordered_set<uint64_t> free_list_offsets_;
+
+    //! thread extending the file in the background, started on demand
+    std::thread grow_thread_;
+    //! signals background growth requests and their completion
+    std::condition_variable grow_cv_;
+    //! number of bytes the background thread should extend the file by
+    uint64_t grow_request_ = 0;
+    //! the file is currently being extended outside of mutex_
+    bool growing_ = false;
+    //! tell the background thread to exit
+    bool grow_terminate_ = false;
+
     void dump() const;
 
     void deallocation_error(
@@ -143,16 +201,36 @@ private:
     // expects the mutex_ to be locked to prevent concurrent access
     void add_free_region(uint64_t block_pos, uint64_t block_size);
 
-    // expects the mutex_ to be locked to prevent concurrent access
-    void grow_file(uint64_t extend_bytes)
-    {
-        if (extend_bytes == 0)
-            return;
+    //! put a freed block into the free list of its size class, with the
+    //! double deallocation checks of add_free_region(). Expects the mutex_
+    //! to be locked.
+    void add_free_list_block(uint64_t block_pos, uint64_t block_size);
 
-        storage_->set_size(disk_bytes_ + extend_bytes);
-        add_free_region(disk_bytes_, extend_bytes);
-        disk_bytes_ += extend_bytes;
-    }
+    //! number of bytes to extend the file by to satisfy a shortage
+    uint64_t growth_size(uint64_t shortage) const;
+
+    //! Extend the file by preallocating growth_size(shortage) bytes, or
+    //! sparsely by shortage bytes if the file system is out of space. Waits
+    //! for background growth to finish first. Expects the mutex_ to be
+    //! locked via lock.
+    void grow_file(std::unique_lock<std::mutex>& lock, uint64_t shortage);
+
+    //! Wait for background growth and extend the file synchronously if the
+    //! free space is still less than requested_size. Expects the mutex_ to be
+    //! locked via lock.
+    void ensure_free_space(
+        std::unique_lock<std::mutex>& lock, uint64_t requested_size);
+
+    //! trigger background growth if the free space runs low. Expects the
+    //! mutex_ to be locked to prevent concurrent access.
+    void check_low_space();
+
+    //! main loop of the background growth thread
+    void grow_worker();
+
+    //! Return all blocks in free lists to the free space map. Expects the
+    //! mutex_ to be locked to prevent concurrent access.
+    void reclaim_free_lists();
 };
 
 template <typename BIDIterator>
@@ -174,6 +252,39 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
         ", blocks: " << (end - begin) <<
         ", requested_size=" << requested_size;
 
+    // size class of uniformly sized blocks, or zero
+    uint64_t size_class = 0;
+
+    if (size_classes_ && begin != end && begin->size <= size_class_limit)
+    {
+        const uint64_t size = begin->size;
+        if (std::all_of(begin, end,
+                        [size](const typename std::iterator_traits<
+                                   BIDIterator>::value_type& bid) {
+                            return bid.size == size;
+                        }))
+        {
+            size_class = size;
+            std::vector<uint64_t>& list = free_lists_[size];
+            for ( ; begin != end && !list.empty(); ++begin)
+            {
+                begin->offset = list.back();
+                list.pop_back();
+                free_list_offsets_.erase(begin->offset);
+                free_bytes_ -= size;
+                free_list_bytes_ -= size;
+                requested_size -= size;
+            }
+            if (begin == end) {
+                check_low_space();
+                return;
+            }
+        }
+    }
+
+    if (free_bytes_ < requested_size && growing_)
+        ensure_free_space(lock, requested_size);
+
     if (free_bytes_ < requested_size)
     {
         if (!autogrow_) {
@@ -190,7 +301,7 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
             << " bytes requested, " << free_bytes_
             << " bytes free. Trying to extend the external memory space...";
 
-        grow_file(requested_size);
+        ensure_free_space(lock, requested_size);
     }
 
     // dump();
@@ -203,6 +314,18 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
             }
         );
 
+    if (space == free_space_.end() && free_list_bytes_ != 0)
+    {
+        reclaim_free_lists();
+
+        space = std::find_if(
+                free_space_.begin(), free_space_.end(),
+                [requested_size](const place& entry) {
+                    return (entry.second >= requested_size);
+                }
+            );
+    }
+
     if (space == free_space_.end() && begin + 1 == end)
     {
         if (!autogrow_) {
@@ -214,7 +337,7 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
                 " bytes free. Trying to extend the external memory space...";
         }
 
-        grow_file(begin->size);
+        grow_file(lock, begin->size);
 
         space = std::find_if(
                 free_space_.begin(), free_space_.end(),
@@ -230,9 +353,6 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
         uint64_t region_size = (*space).second;
         free_space_.erase(space);
 
-        if (region_size > requested_size)
-            free_space_[region_pos + requested_size] = region_size - requested_size;
-
         for (uint64_t pos = region_pos; begin != end; ++begin)
         {
             begin->offset = pos;
@@ -241,8 +361,31 @@ void disk_block_allocator::new_blocks(BIDIterator begin, BIDIterator end)
 
         assert(free_bytes_ >= requested_size);
         free_bytes_ -= requested_size;
+        region_pos += requested_size;
+        region_size -= requested_size;
+
+        if (size_class != 0)
+        {
+            // refill the free list with a slab of further blocks
+            uint64_t slab = region_size / size_class;
+            if (slab > size_class_slab)
+                slab = size_class_slab;
+            std::vector<uint64_t>& list = free_lists_[size_class];
+            for (uint64_t i = slab; i > 0; --i) {
+                list.push_back(region_pos + (i - 1) * size_class);
+                free_list_offsets_.insert(list.back());
+            }
+            free_list_bytes_ += slab * size_class;
+            region_pos += slab * size_class;
+            region_size -= slab * size_class;
+        }
+
+        if (region_size > 0)
+            free_space_[region_pos] = region_size;
         //dump();
 
+        check_low_space();
+
         return;
     }
 
@@ -0,0 +1,79 @@
+/***************************************************************************
+ *  foxxll/mng/extent_reservation.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+
+#include <foxxll/mng/extent_reservation.hpp>
+
+namespace foxxll {
+
+extent_reservation::extent_reservation(uint64_t extent_bytes)
+    : bm_(block_manager::get_instance()),
+      extent_bytes_(extent_bytes)
+{ }
+
+extent_reservation::~extent_reservation()
+{
+    release();
+}
+
+void extent_reservation::release()
+{
+    for (size_t disk = 0; disk < extents_.size(); ++disk)
+    {
+        extent& e = extents_[disk];
+        if (e.end != e.begin)
+            bm_->release_extent(disk, e.begin, e.end - e.begin);
+        e = extent();
+    }
+}
+
+uint64_t extent_reservation::reserved_bytes() const
+{
+    uint64_t bytes = 0;
+    for (const extent& e : extents_)
+        bytes += e.end - e.begin;
+    return bytes;
+}
+
+bool extent_reservation::carve(size_t disk, uint64_t size, uint64_t& offset)
+{
+    if (extents_.size() <= disk)
+        extents_.resize(disk + 1);
+
+    extent& e = extents_[disk];
+
+    if (e.end - e.begin < size)
+    {
+        // return the tail, it usually merges with the next extent
+        if (e.end != e.begin)
+            bm_->release_extent(disk, e.begin, e.end - e.begin);
+        e = extent();
+
+        const uint64_t bytes = std::max(extent_bytes_, size);
+        uint64_t begin;
+        if (!bm_->reserve_extent(disk, bytes, begin))
+            return false;
+
+        e.begin = begin;
+        e.end = begin + bytes;
+    }
+
+    offset = e.begin;
+    e.begin += size;
+    bm_->add_allocation(size);
+    return true;
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
@@ -0,0 +1,129 @@
+/***************************************************************************
+ *  foxxll/mng/extent_reservation.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_EXTENT_RESERVATION_HEADER
+#define FOXXLL_MNG_EXTENT_RESERVATION_HEADER
+
+#include <iterator>
+#include <vector>
+
+#include <foxxll/mng/bid.hpp>
+#include <foxxll/mng/block_manager.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * Allocates the blocks of a sequential stream from contiguous extents.
+ *
+ * Blocks allocated one at a time by block_manager are interleaved with those
+ * of other streams. An extent_reservation reserves a large contiguous region
+ * per disk and carves consecutive blocks from it, such that the blocks of the
+ * stream on each disk are physically sequential. Unused tails of the extents
+ * are returned by release() or the destructor. The blocks themselves are
+ * ordinary blocks and are deleted via block_manager::delete_block().
+ *
+ * If a disk cannot provide an extent, blocks are allocated by block_manager
+ * as usual. An extent_reservation is not thread-safe.
+ */
+class extent_reservation
+{
+public:
+    //! default size of extents reserved per disk
+    static constexpr uint64_t default_extent_bytes = 64 * 1024 * 1024;
+
+    //! create a reservation which reserves extents of given size
+    explicit extent_reservation(uint64_t extent_bytes = default_extent_bytes);
+
+    //! non-copyable: delete copy-constructor
+    extent_reservation(const extent_reservation&) = delete;
+    //! non-copyable: delete assignment operator
+    extent_reservation& operator = (const extent_reservation&) = delete;
+
+    //! returns unused reserved space
+    ~extent_reservation();
+
+    /*!
+     * Allocates new blocks from the extents, with disks chosen by \b functor
+     * as in block_manager::new_blocks().
+     *
+     * \param functor object of model of \b allocation_strategy concept
+     * \param bid_begin bidirectional BID iterator object
+     * \param bid_end bidirectional BID iterator object
+     * \param alloc_offset advance for \b functor to line up partial allocations
+     */
+    template <typename DiskAssignFunctor, typename BIDIterator>
+    void new_blocks(
+        const DiskAssignFunctor& functor,
+        BIDIterator bid_begin, BIDIterator bid_end,
+        size_t alloc_offset = 0)
+    {
+        for (size_t i = 0; bid_begin != bid_end; ++bid_begin, ++i)
+        {
+            const size_t disk = functor(alloc_offset + i);
+            uint64_t offset;
+
+            if (carve(disk, bid_begin->size, offset)) {
+                bid_begin->storage = bm_->disk_file(disk);
+                bid_begin->offset = offset;
+            }
+            else {
+                // no extent available: regular allocation
+                bm_->new_blocks(functor, bid_begin, std::next(bid_begin),
+                                alloc_offset + i);
+            }
+        }
+    }
+
+    //! Allocates a new block from the extents, see new_blocks().
+    template <typename DiskAssignFunctor, size_t BlockSize>
+    void new_block(const DiskAssignFunctor& functor,
+                   BID<BlockSize>& bid, size_t alloc_offset = 0)
+    {
+        new_blocks(functor, &bid, &bid + 1, alloc_offset);
+    }
+
+    //! Return the unused tails of all extents to the block manager.
+    void release();
+
+    //! number of reserved but not yet allocated bytes
+    uint64_t reserved_bytes() const;
+
+private:
+    //! unused part [begin, end) of the extent on a disk
+    struct extent
+    {
+        uint64_t begin = 0, end = 0;
+    };
+
+    block_manager* bm_;
+
+    //! size of extents to reserve
+    uint64_t extent_bytes_;
+
+    //! current extent of each disk
+    std::vector<extent> extents_;
+
+    //! Allocate a block of given size from the extent of a disk, reserving a
+    //! new extent if necessary. Returns false if no extent can be reserved.
+    bool carve(size_t disk, uint64_t size, uint64_t& offset);
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_EXTENT_RESERVATION_HEADER
+
+/**************************************************************************/
@@ -0,0 +1,267 @@
+/***************************************************************************
+ *  foxxll/mng/memory_budget.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/common/exceptions.hpp>
+#include <foxxll/mng/memory_budget.hpp>
+
+namespace foxxll {
+
+/******************************************************************************/
+// memory_budget::account
+
+memory_budget::account::account(const std::string& name)
+    : budget_(memory_budget::get_instance()), name_(name)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    budget_->accounts_.push_back(this);
+}
+
+memory_budget::account::~account()
+{
+    assert(used_ == 0);
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    std::vector<account*>& list = budget_->accounts_;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+bool memory_budget::account::try_borrow(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    if (budget_->limit_ == 0)
+        return false;
+    if (budget_->take(*this, bytes)) {
+        borrowed_ += bytes;
+        borrower_ = std::this_thread::get_id();
+        return true;
+    }
+
+    ++waits_;
+    budget_->request_reclaim(this, bytes);
+    return false;
+}
+
+bool memory_budget::account::try_borrow_spare(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    if (budget_->limit_ == 0 || !budget_->take(*this, bytes))
+        return false;
+    borrowed_ += bytes;
+    borrower_ = std::this_thread::get_id();
+    return true;
+}
+
+void memory_budget::account::acquire(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    if (budget_->limit_ != 0 && bytes > budget_->limit_) {
+        FOXXLL_THROW(bad_parameter,
+                     "Account " << name_ << " requests " << bytes
+                                << " bytes, the memory budget is only "
+                                << budget_->limit_ << " bytes.");
+    }
+    if (budget_->take(*this, bytes))
+        return;
+
+    ++waits_;
+    const std::thread::id self = std::this_thread::get_id();
+
+    // other accounts give borrowed memory back when they are used next, ask
+    // again periodically as they may have grown meanwhile
+    do {
+        budget_->request_reclaim(this, bytes);
+
+        // accounts which borrowed on this thread cannot be used while it
+        // waits, let them give back their memory now
+        std::vector<std::function<void()> > reclaimers;
+        for (const account* a : budget_->accounts_) {
+            if (a != this && a->borrower_ == self && a->reclaim_ > 0 &&
+                a->reclaimer_)
+                reclaimers.push_back(a->reclaimer_);
+        }
+        if (!reclaimers.empty()) {
+            lock.unlock();
+            for (const std::function<void()>& reclaimer : reclaimers)
+                reclaimer();
+            lock.lock();
+            if (budget_->take(*this, bytes))
+                return;
+        }
+
+        uint64_t reclaimable = 0;
+        for (const account* a : budget_->accounts_) {
+            if (a != this && a->borrower_ != self)
+                reclaimable += a->borrowed_;
+        }
+        if (budget_->used_ - reclaimable + bytes > budget_->limit_) {
+            FOXXLL_THROW(resource_error,
+                         "Account " << name_ << " requests " << bytes
+                                    << " bytes, but other accounts hold "
+                                    << budget_->used_ - reclaimable
+                                    << " bytes of the memory budget of "
+                                    << budget_->limit_
+                                    << " bytes which cannot be reclaimed.");
+        }
+
+        budget_->cv_.wait_for(lock, std::chrono::milliseconds(100));
+    } while (!budget_->take(*this, bytes));
+}
+
+void memory_budget::account::set_reclaimer(std::function<void()> reclaimer)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    reclaimer_ = std::move(reclaimer);
+}
+
+void memory_budget::account::release(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    budget_->give(*this, bytes);
+}
+
+void memory_budget::account::release_borrowed(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(budget_->mutex_);
+    assert(borrowed_ >= bytes);
+    borrowed_ -= bytes;
+    budget_->give(*this, bytes);
+}
+
+/******************************************************************************/
+// memory_budget
+
+bool memory_budget::take(account& acc, uint64_t bytes)
+{
+    if (limit_ != 0 && used_ + bytes > limit_)
+        return false;
+
+    used_ += bytes;
+    const uint64_t used = acc.used_ += bytes;
+    if (used > acc.peak_)
+        acc.peak_ = used;
+    return true;
+}
+
+void memory_budget::give(account& acc, uint64_t bytes)
+{
+    assert(acc.used_ >= bytes && used_ >= bytes);
+    acc.used_ -= bytes;
+    used_ -= bytes;
+
+    const uint64_t reclaim = acc.reclaim_;
+    acc.reclaim_ = reclaim > bytes ? reclaim - bytes : 0;
+
+    cv_.notify_all();
+}
+
+void memory_budget::request_reclaim(const account* acc, uint64_t bytes)
+{
+    if (limit_ == 0 || used_ + bytes <= limit_)
+        return;
+    const uint64_t shortage = used_ + bytes - limit_;
+
+    uint64_t others = 0;
+    for (const account* a : accounts_) {
+        if (a != acc)
+            others += a->borrowed_;
+    }
+    if (others == 0)
+        return;
+
+    // each account gives back its share of the shortage from its borrowed
+    // memory
+    for (account* a : accounts_)
+    {
+        if (a == acc || a->borrowed_ == 0)
+            continue;
+        const uint64_t share = std::min<uint64_t>(
+            a->borrowed_, (shortage * a->borrowed_ + others - 1) / others);
+        if (share > a->reclaim_)
+            a->reclaim_ = share;
+    }
+}
+
+void memory_budget::set_limit(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    limit_ = bytes;
+    request_reclaim(nullptr, 0);
+    cv_.notify_all();
+
+    TLX_LOG1 << "memory_budget: limit set to " << bytes << " bytes";
+}
+
+uint64_t memory_budget::limit() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return limit_;
+}
+
+uint64_t memory_budget::used() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return used_;
+}
+
+std::vector<memory_budget::usage> memory_budget::report() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<usage> result;
+    for (const account* a : accounts_)
+        result.push_back(usage { a->name_, a->used_, a->peak_, a->waits_ });
+    return result;
+}
+
+//! read a cgroup limit file, zero if it does not exist or is unlimited
+static uint64_t read_cgroup_limit(const char* path)
+{
+    std::ifstream in(path);
+    std::string value;
+    if (!(in >> value) || value == "max")
+        return 0;
+
+    const uint64_t limit = std::strtoull(value.c_str(), nullptr, 10);
+    // cgroup v1 reports a huge page-aligned number if unlimited
+    return limit >= (uint64_t(1) << 60) ? 0 : limit;
+}
+
+uint64_t memory_budget::cgroup_limit()
+{
+    // cgroup v2, then v1
+    const uint64_t limit = read_cgroup_limit("/sys/fs/cgroup/memory.max");
+    if (limit != 0)
+        return limit;
+    return read_cgroup_limit("/sys/fs/cgroup/memory/memory.limit_in_bytes");
+}
+
+std::ostream& operator << (std::ostream& o, const memory_budget::usage& u)
+{
+    return o << u.name << ": " << u.used << " bytes used, peak " << u.peak
+             << " bytes, " << u.waits << " waits";
+}
+
+} // namespace foxxll
+
+/**************************************************************************/
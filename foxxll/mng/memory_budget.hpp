@@ -0,0 +1,197 @@
+/***************************************************************************
+ *  foxxll/mng/memory_budget.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_MEMORY_BUDGET_HEADER
+#define FOXXLL_MNG_MEMORY_BUDGET_HEADER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <foxxll/singleton.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * Process-wide limit on the memory of block buffers.
+ *
+ * Components draw their buffers from the budget through an account, which
+ * records their usage. Memory is not partitioned between the accounts: a
+ * component may use whatever the others leave free. Memory is either
+ * acquired, for the blocks a component needs, or borrowed, for additional
+ * blocks it can do without. When an acquisition does not fit, the budget
+ * asks the other accounts to give borrowed memory back, see
+ * account::reclaim_requested(), and acquire() blocks until it fits, which
+ * throttles the component. Pools poll their reclaim request when they are
+ * used, hence they shrink lazily and never from a foreign thread. Accounts
+ * which borrowed on the waiting thread itself cannot be used meanwhile, so
+ * acquire() calls their reclaimer, see account::set_reclaimer(). A pool
+ * given an account charges all blocks it allocates, and gives back only the
+ * additional blocks borrowed beyond its own size.
+ *
+ * The limit is zero (unlimited) by default, then nothing can be borrowed.
+ * Set it with set_limit(), e.g. to a share of cgroup_limit() when running in
+ * a memory constrained container.
+ *
+ * \remarks is a singleton
+ */
+class memory_budget : public singleton<memory_budget>
+{
+    friend class singleton<memory_budget>;
+
+public:
+    /*!
+     * Usage of the budget by one component, registered on construction and
+     * unregistered on destruction. All memory must be released before.
+     */
+    class account
+    {
+    public:
+        explicit account(const std::string& name);
+
+        //! non-copyable: delete copy-constructor
+        account(const account&) = delete;
+        //! non-copyable: delete assignment operator
+        account& operator = (const account&) = delete;
+
+        ~account();
+
+        //! Borrow bytes from the budget if they fit, otherwise ask the other
+        //! accounts to give memory back and return false. Borrowed memory is
+        //! given back on reclaim_requested(). Fails if the budget is
+        //! unlimited, as nothing would ever ask for the memory.
+        bool try_borrow(uint64_t bytes);
+
+        //! Borrow bytes from the budget if they fit, without asking the other
+        //! accounts for memory or counting a wait. For speculative uses, e.g.
+        //! prefetch hints. Fails if the budget is unlimited.
+        bool try_borrow_spare(uint64_t bytes);
+
+        //! Take bytes from the budget, blocking until other accounts give
+        //! back enough borrowed memory. Throws bad_parameter if bytes exceed
+        //! the limit, and resource_error if they do not fit even if the
+        //! other accounts give back all memory they can.
+        void acquire(uint64_t bytes);
+
+        //! Set a function giving back borrowed memory as reclaim_requested()
+        //! asks. If this account last borrowed on the thread of a waiting
+        //! acquire(), it is called from there, as the account cannot be used
+        //! until that returns. An empty function removes the reclaimer.
+        void set_reclaimer(std::function<void()> reclaimer);
+
+        //! return acquired bytes to the budget
+        void release(uint64_t bytes);
+
+        //! return borrowed bytes to the budget
+        void release_borrowed(uint64_t bytes);
+
+        //! number of bytes the budget asks this account to give back
+        uint64_t reclaim_requested() const { return reclaim_; }
+
+        //! name given on construction
+        const std::string & name() const { return name_; }
+
+        //! currently acquired and borrowed bytes
+        uint64_t used() const { return used_; }
+
+        //! currently borrowed bytes
+        uint64_t borrowed() const { return borrowed_; }
+
+        //! maximum number of bytes acquired at once
+        uint64_t peak() const { return peak_; }
+
+        //! number of acquisitions which did not fit immediately
+        uint64_t waits() const { return waits_; }
+
+    private:
+        friend class memory_budget;
+
+        memory_budget* budget_;
+        std::string name_;
+
+        std::atomic<uint64_t> used_ { 0 };
+        std::atomic<uint64_t> borrowed_ { 0 };
+        std::atomic<uint64_t> peak_ { 0 };
+        std::atomic<uint64_t> waits_ { 0 };
+        std::atomic<uint64_t> reclaim_ { 0 };
+
+        //! gives back borrowed memory, see set_reclaimer()
+        std::function<void()> reclaimer_;
+
+        //! thread which last borrowed memory
+        std::thread::id borrower_;
+    };
+
+    //! usage of one account, see report()
+    struct usage
+    {
+        std::string name;
+        uint64_t used, peak, waits;
+    };
+
+    //! Set the limit in bytes, zero is unlimited. Lowering it below the
+    //! current usage asks all accounts to give memory back.
+    void set_limit(uint64_t bytes);
+
+    //! limit in bytes, zero is unlimited
+    uint64_t limit() const;
+
+    //! bytes acquired by all accounts
+    uint64_t used() const;
+
+    //! usage of all registered accounts
+    std::vector<usage> report() const;
+
+    //! Memory limit of the cgroup of this process in bytes, zero if there is
+    //! none or it cannot be determined.
+    static uint64_t cgroup_limit();
+
+private:
+    memory_budget() = default;
+
+    //! take bytes for an account if they fit, expects mutex_ to be locked
+    bool take(account& acc, uint64_t bytes);
+
+    //! return bytes of an account, expects mutex_ to be locked
+    void give(account& acc, uint64_t bytes);
+
+    //! ask all accounts but acc to give back borrowed memory such that bytes
+    //! more fit, expects mutex_ to be locked
+    void request_reclaim(const account* acc, uint64_t bytes);
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+
+    uint64_t limit_ = 0;
+    uint64_t used_ = 0;
+
+    std::vector<account*> accounts_;
+};
+
+std::ostream& operator << (std::ostream& o, const memory_budget::usage& u);
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_MEMORY_BUDGET_HEADER
+
+/**************************************************************************/
@@ -0,0 +1,146 @@
+/***************************************************************************
+ *  foxxll/mng/packed_bid.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_PACKED_BID_HEADER
+#define FOXXLL_MNG_PACKED_BID_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+#include <foxxll/common/error_handling.hpp>
+#include <foxxll/io/request.hpp>
+#include <foxxll/mng/bid.hpp>
+#include <foxxll/mng/block_manager.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_mnglayer
+//! \{
+
+/*!
+ * Block identifier of a block managed by block_manager, packed into 64 bits.
+ *
+ * The upper 8 bits hold the disk number plus one, zero denotes an invalid
+ * BID, the lower 56 bits hold the offset in units of BlockAlignment. The file
+ * pointer is looked up when converting to a BID<Size>, which happens
+ * implicitly when a packed_bid is passed to typed_block::read/write or to the
+ * pools, so arrays of packed_bid take half the memory of arrays of BID<Size>.
+ * Self managed files cannot be referenced.
+ */
+template <size_t Size>
+class packed_bid
+{
+    static_assert(Size != 0, "packed_bid requires a fixed block size");
+
+public:
+    //! Block size
+    static constexpr size_t size = Size;
+
+    //! number of bits of the disk number
+    static constexpr unsigned disk_bits = 8;
+
+    //! number of bits of the offset in units of BlockAlignment
+    static constexpr unsigned offset_bits = 64 - disk_bits;
+
+    //! maximum number of disks which can be referenced
+    static constexpr size_t max_disks = (size_t(1) << disk_bits) - 1;
+
+    packed_bid() = default;
+
+    //! pack a BID of a block allocated by block_manager
+    explicit packed_bid(const BID<Size>& bid)
+    {
+        if (!bid.valid())
+            return;
+
+        const int disk = bid.storage->get_allocator_id();
+        if (disk < 0 || static_cast<size_t>(disk) >= max_disks)
+            FOXXLL_THROW_INVALID_ARGUMENT(
+                "packed_bid can only reference blocks of managed disks");
+        if (bid.offset % BlockAlignment != 0 ||
+            (bid.offset / BlockAlignment) >> offset_bits != 0)
+            FOXXLL_THROW_INVALID_ARGUMENT(
+                "packed_bid offset is unaligned or out of range");
+
+        value_ = (static_cast<uint64_t>(disk + 1) << offset_bits) |
+                 (bid.offset / BlockAlignment);
+    }
+
+    bool valid() const { return value_ != 0; }
+
+    //! disk number of the block
+    size_t disk() const
+    {
+        assert(valid());
+        return static_cast<size_t>(value_ >> offset_bits) - 1;
+    }
+
+    //! offset of the block within its disk file
+    external_size_type offset() const
+    {
+        return (value_ & ((uint64_t(1) << offset_bits) - 1)) * BlockAlignment;
+    }
+
+    //! full BID with file pointer, invalid BIDs unpack to the default BID
+    BID<Size> unpack() const
+    {
+        if (!valid())
+            return BID<Size>();
+        return BID<Size>(
+            block_manager::get_instance()->disk_file(disk()), offset());
+    }
+
+    //! implicit conversion for I/O and the pools
+    operator BID<Size>() const { return unpack(); }
+
+    //! raw 64-bit representation
+    uint64_t value() const { return value_; }
+
+    bool operator == (const packed_bid& b) const { return value_ == b.value_; }
+    bool operator != (const packed_bid& b) const { return value_ != b.value_; }
+    bool operator < (const packed_bid& b) const { return value_ < b.value_; }
+
+private:
+    uint64_t value_ = 0;
+};
+
+template <size_t Size>
+std::ostream& operator << (std::ostream& s, const packed_bid<Size>& bid)
+{
+    if (!bid.valid())
+        return s << "[packed|?]";
+    return s << "[packed|" << bid.disk() << "]0x" << std::hex << bid.offset()
+             << "/0x" << Size << std::dec;
+}
+
+//! \}
+
+} // namespace foxxll
+
+namespace std {
+
+template <size_t Size>
+struct hash<foxxll::packed_bid<Size> >
+{
+    size_t operator () (const foxxll::packed_bid<Size>& bid) const noexcept
+    {
+        return std::hash<uint64_t>()(bid.value());
+    }
+};
+
+} // namespace std
+
+#endif // !FOXXLL_MNG_PACKED_BID_HEADER
+
+/**************************************************************************/
@@ -0,0 +1,318 @@
+/***************************************************************************
+ *  foxxll/mng/parallel_buf_istream.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_PARALLEL_BUF_ISTREAM_HEADER
+#define FOXXLL_MNG_PARALLEL_BUF_ISTREAM_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/io/iostats.hpp>
+#include <foxxll/io/request.hpp>
+#include <foxxll/mng/async_schedule.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Input stream of blocks shared by several consumer threads.
+ *
+ * One set of buffers is read ahead for the whole BID sequence, in the order
+ * of a single (windowed) prefetch schedule. Consumers take blocks with
+ * pull() as they become available and give the buffers back with release(),
+ * so faster threads simply process more blocks. In ordered mode the blocks
+ * are handed out in sequence order, otherwise in the order their reads
+ * complete.
+ *
+ * All methods are thread-safe. A consumer should release its block before
+ * pulling the next one, and there should be more buffers than consumers.
+ */
+template <typename BlockType, typename BidIteratorType>
+class parallel_buf_istream
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using bid_iterator_type = BidIteratorType;
+
+protected:
+    using schedule_type = windowed_prefetch_schedule<bid_iterator_type>;
+
+    //! a block in reading or read but not yet pulled
+    struct slot
+    {
+        block_type* block;
+        request_ptr req;
+        bool done = false;
+    };
+
+    bid_iterator_type begin_;
+    const size_t length_;
+    const bool ordered_;
+
+    //! number of buffers owned
+    const size_t nbuffers_;
+
+    schedule_type schedule_;
+
+    //! protects all members below
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    //! position in the prefetch schedule of the next read
+    size_t nextread_ = 0;
+
+    //! number of blocks pulled
+    size_t pulled_ = 0;
+
+    //! number of reads issued but not completed
+    size_t pending_ = 0;
+
+    //! unused buffers
+    std::vector<block_type*> free_;
+
+    //! blocks in reading or read, by index in the sequence
+    std::unordered_map<size_t, slot> slots_;
+
+    //! read blocks in completion order, if not ordered
+    std::deque<size_t> ready_;
+
+    //! blocks taken from the schedule whose read could not be submitted,
+    //! the earliest last
+    std::vector<size_t> unread_;
+
+    //! issue reads into the free buffers, expects lock to hold mutex_
+    void fill(std::unique_lock<std::mutex>& lock)
+    {
+        std::vector<std::pair<size_t, block_type*> > batch;
+        while (!free_.empty() && (!unread_.empty() || nextread_ < length_))
+        {
+            size_t index;
+            if (!unread_.empty()) {
+                index = unread_.back();
+                unread_.pop_back();
+            }
+            else {
+                index = schedule_[nextread_++];
+            }
+            block_type* block = free_.back();
+            free_.pop_back();
+
+            slots_[index].block = block;
+            ++pending_;
+            batch.emplace_back(index, block);
+        }
+        if (batch.empty())
+            return;
+
+        // the completion handlers lock mutex_
+        lock.unlock();
+        size_t submitted = 0;
+        try {
+            for ( ; submitted < batch.size(); ++submitted)
+            {
+                const size_t index = batch[submitted].first;
+                TLX_LOG << "parallel_buf_istream: reading block " << index;
+                batch[submitted].second->read(
+                    *(begin_ + index),
+                    [this, index](request* req, bool /* success */) {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        slot& s = slots_[index];
+                        s.req = request_ptr(req);
+                        s.done = true;
+                        if (!ordered_)
+                            ready_.push_back(index);
+                        --pending_;
+                        cv_.notify_all();
+                    });
+            }
+        }
+        catch (...) {
+            // undo the reads not submitted, their blocks are read later
+            lock.lock();
+            for (size_t i = batch.size(); i-- > submitted; )
+            {
+                slots_.erase(batch[i].first);
+                free_.push_back(batch[i].second);
+                unread_.push_back(batch[i].first);
+                --pending_;
+            }
+            cv_.notify_all();
+            throw;
+        }
+        lock.lock();
+    }
+
+    //! wait for outstanding reads and free all buffers, expects lock to hold
+    //! mutex_
+    void free_buffers(std::unique_lock<std::mutex>& lock)
+    {
+        cv_.wait(lock, [this]() { return pending_ == 0; });
+
+        for (std::pair<const size_t, slot>& s : slots_)
+        {
+            try {
+                s.second.req->wait();
+            }
+            catch (...)
+            { }
+            free_.push_back(s.second.block);
+        }
+        slots_.clear();
+        for (block_type* block : free_)
+            delete block;
+        free_.clear();
+    }
+
+public:
+    /*!
+     * Constructs the stream and immediately starts prefetching.
+     *
+     * \param begin \c bid_iterator pointing to the first block of the stream
+     * \param end \c bid_iterator pointing to the ( \b last + 1 ) block of the stream
+     * \param nbuffers number of buffers shared by all consumers
+     * \param ordered hand out blocks in sequence order
+     */
+    parallel_buf_istream(bid_iterator_type begin, bid_iterator_type end,
+                         size_t nbuffers, bool ordered = false)
+        : begin_(begin), length_(end - begin), ordered_(ordered),
+          nbuffers_(std::max(2 * config::get_instance()->disks_number(), nbuffers)),
+          schedule_(begin, end, nbuffers_,
+                    config::get_instance()->max_device_id(), 0,
+                    block_manager::get_instance()->device_service_times(
+                        block_type::raw_size))
+    {
+        free_.reserve(nbuffers_);
+        for (size_t i = 0; i < nbuffers_; ++i)
+            free_.push_back(new block_type);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        try {
+            fill(lock);
+        }
+        catch (...) {
+            free_buffers(lock);
+            throw;
+        }
+    }
+
+    //! non-copyable: delete copy-constructor
+    parallel_buf_istream(const parallel_buf_istream&) = delete;
+    //! non-copyable: delete assignment operator
+    parallel_buf_istream& operator = (const parallel_buf_istream&) = delete;
+
+    /*!
+     * Takes the next block to process, waiting for its read to complete.
+     *
+     * \param block set to the read block, owned by the stream until it is
+     * given back with release(). If the read failed, the error is thrown and
+     * the block stays with the stream.
+     * \param index set to the index of the block in the sequence
+     * \return \c false if all blocks have been pulled
+     */
+    bool pull(block_type*& block, size_t& index)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (pulled_ >= length_)
+            return false;
+
+        if (ordered_)
+            index = pulled_;
+        ++pulled_;
+
+        {
+            stats::scoped_wait_timer wait_timer(stats::WAIT_OP_READ);
+            if (ordered_)
+            {
+                cv_.wait(lock, [this, index]() {
+                             typename std::unordered_map<size_t, slot>::iterator
+                             it = slots_.find(index);
+                             return it != slots_.end() && it->second.done;
+                         });
+            }
+            else
+            {
+                cv_.wait(lock, [this]() { return !ready_.empty(); });
+                index = ready_.front();
+                ready_.pop_front();
+            }
+        }
+
+        typename std::unordered_map<size_t, slot>::iterator it = slots_.find(index);
+        block = it->second.block;
+        request_ptr req = it->second.req;
+        slots_.erase(it);
+        lock.unlock();
+
+        TLX_LOG << "parallel_buf_istream: pulled block " << index;
+        // the request finishes after its completion handler, reports errors
+        try {
+            req->wait();
+        }
+        catch (...) {
+            // the failed block is not handed out, its buffer reads ahead
+            lock.lock();
+            free_.push_back(block);
+            fill(lock);
+            block = nullptr;
+            throw;
+        }
+        return true;
+    }
+
+    //! Gives a block taken by pull() back for reading ahead.
+    void release(block_type* block)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_.push_back(block);
+        fill(lock);
+    }
+
+    //! number of blocks in the sequence
+    size_t size() const { return length_; }
+
+    //! number of buffers shared by the consumers
+    size_t buffers() const { return nbuffers_; }
+
+    //! whether blocks are handed out in sequence order
+    bool ordered() const { return ordered_; }
+
+    //! Waits for outstanding reads and frees the buffers. All pulled blocks
+    //! must have been released.
+    ~parallel_buf_istream()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        assert(free_.size() + slots_.size() == nbuffers_);
+        free_buffers(lock);
+    }
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_PARALLEL_BUF_ISTREAM_HEADER
+
+/**************************************************************************/
@@ -0,0 +1,327 @@
+/***************************************************************************
+ *  foxxll/mng/partition_writer.hpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#ifndef FOXXLL_MNG_PARTITION_WRITER_HEADER
+#define FOXXLL_MNG_PARTITION_WRITER_HEADER
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+#include <tlx/logger/core.hpp>
+
+#include <foxxll/common/types.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_manager.hpp>
+#include <foxxll/mng/config.hpp>
+#include <foxxll/mng/memory_budget.hpp>
+#include <foxxll/mng/write_pool.hpp>
+
+namespace foxxll {
+
+//! \addtogroup foxxll_schedlayer
+//! \{
+
+/*!
+ * Scatters elements into many buckets on disk.
+ *
+ * Each bucket fills one block in memory at a time, which is written through
+ * a shared write_pool once full, with writes batched and sorted by file and
+ * offset. Only a limited number of bucket blocks is held in memory: if a
+ * bucket needs a block beyond the limit, the fullest partially filled blocks
+ * are spilled to disk. Hence the last block of each bucket and spilled
+ * blocks may be partially filled, the number of elements of each block is
+ * recorded with its BID.
+ *
+ * Additional bucket blocks may be drawn from a memory budget, they are
+ * spilled again when the budget asks for memory.
+ */
+template <typename BlockType, typename AllocStrategy = striping>
+class partition_writer
+{
+    constexpr static bool debug = false;
+
+public:
+    using block_type = BlockType;
+    using value_type = typename block_type::value_type;
+    using bid_type = typename block_type::bid_type;
+    using alloc_strategy_type = AllocStrategy;
+
+    //! blocks written for a bucket
+    struct bucket_type
+    {
+        std::vector<bid_type> bids;
+        //! number of elements in each block
+        std::vector<size_t> sizes;
+        //! number of elements in the bucket
+        external_size_type size = 0;
+    };
+
+protected:
+    //! block in memory of a bucket
+    struct buffer_type
+    {
+        block_type* block = nullptr;
+        size_t fill = 0;
+    };
+
+    std::vector<bucket_type> buckets_;
+    std::vector<buffer_type> buffers_;
+
+    //! blocks of the buckets and write buffers
+    write_pool<block_type> pool_;
+
+    alloc_strategy_type alloc_strategy_;
+
+    //! number of blocks allocated, advances the allocation strategy
+    size_t allocated_ = 0;
+
+    //! number of bucket blocks held in memory
+    size_t held_ = 0;
+
+    //! maximum number of bucket blocks held without the budget
+    const size_t max_held_;
+
+    //! budget additional bucket blocks are drawn from, if any
+    memory_budget::account* budget_ = nullptr;
+
+    //! number of blocks drawn from the budget
+    size_t borrowed_ = 0;
+
+    //! number of blocks of the writer charged to the budget
+    size_t charged_ = 0;
+
+    //! number of partially filled blocks written
+    size_t spilled_ = 0;
+
+    //! write the block of a bucket, full or not
+    void write_buffer(size_t b)
+    {
+        buffer_type& buf = buffers_[b];
+        bucket_type& bucket = buckets_[b];
+        assert(buf.block && buf.fill > 0);
+
+        bid_type bid;
+        block_manager::get_instance()->new_block(
+            alloc_strategy_, bid, allocated_++);
+
+        TLX_LOG << "partition_writer: bucket " << b << " writes " << buf.fill
+                << " elements to " << bid;
+
+        bucket.bids.push_back(bid);
+        bucket.sizes.push_back(buf.fill);
+        bucket.size += buf.fill;
+
+        pool_.write(buf.block, bid);
+        buf.fill = 0;
+        --held_;
+    }
+
+    //! write the n fullest partially filled blocks
+    void spill(size_t n)
+    {
+        std::vector<size_t> held;
+        held.reserve(held_);
+        for (size_t b = 0; b < buffers_.size(); ++b)
+        {
+            if (buffers_[b].block)
+                held.push_back(b);
+        }
+
+        n = std::min(n, held.size());
+        if (n == 0)
+            return;
+        std::nth_element(
+            held.begin(), held.begin() + (n - 1), held.end(),
+            [this](size_t a, size_t b) {
+                return buffers_[a].fill > buffers_[b].fill;
+            });
+
+        TLX_LOG << "partition_writer: spilling " << n << " of " << held.size()
+                << " blocks";
+
+        for (size_t i = 0; i < n; ++i)
+            write_buffer(held[i]);
+        spilled_ += n;
+    }
+
+    //! spill blocks drawn from the budget if it asks for memory
+    void give_back()
+    {
+        if (borrowed_ == 0 || budget_->reclaim_requested() == 0)
+            return;
+
+        const size_t n = std::min<size_t>(
+            borrowed_,
+            (budget_->reclaim_requested() + block_type::raw_size - 1) /
+            block_type::raw_size);
+
+        if (held_ + n > max_held_ + borrowed_)
+            spill(held_ + n - max_held_ - borrowed_);
+
+        // waits for the spilled writes to complete
+        pool_.resize(pool_.size() - n);
+        borrowed_ -= n;
+        budget_->release_borrowed(n * block_type::raw_size);
+    }
+
+    //! take a block for a bucket, spilling others if too many are held
+    void take_block(size_t b)
+    {
+        give_back();
+
+        if (held_ >= max_held_ + borrowed_)
+        {
+            if (budget_ && budget_->try_borrow(block_type::raw_size)) {
+                ++borrowed_;
+                pool_.resize(pool_.size() + 1);
+            }
+            else {
+                // spill a fraction at once to save repeated scans
+                spill(std::max<size_t>(1, held_ / 8));
+            }
+        }
+
+        buffers_[b].block = pool_.steal();
+        ++held_;
+    }
+
+public:
+    /*!
+     * Constructs a writer for the given number of buckets.
+     *
+     * \param nbuckets number of buckets
+     * \param nblocks maximum number of bucket blocks held in memory
+     * \param nwrite_buffers number of additional blocks for writing
+     * \param alloc_strategy allocation strategy of the written blocks
+     */
+    partition_writer(size_t nbuckets, size_t nblocks,
+                     size_t nwrite_buffers = 0,
+                     const alloc_strategy_type& alloc_strategy = alloc_strategy_type())
+        : buckets_(nbuckets), buffers_(nbuckets),
+          alloc_strategy_(alloc_strategy),
+          max_held_(std::max<size_t>(nblocks, 1))
+    {
+        if (nwrite_buffers == 0)
+            nwrite_buffers = 2 * config::get_instance()->disks_number();
+
+        pool_.resize(max_held_ + nwrite_buffers);
+        // written blocks are submitted sorted by file and offset
+        pool_.set_batch_size(nwrite_buffers / 2);
+    }
+
+    //! non-copyable: delete copy-constructor
+    partition_writer(const partition_writer&) = delete;
+    //! non-copyable: delete assignment operator
+    partition_writer& operator = (const partition_writer&) = delete;
+
+    /*!
+     * Charge the blocks of the writer to a memory budget, blocking until they
+     * fit, and draw additional bucket blocks from it instead of spilling
+     * partially filled blocks when the limit is reached. The additional
+     * blocks are spilled when the budget asks for memory. The account must
+     * outlive the writer.
+     */
+    void set_budget(memory_budget::account* account)
+    {
+        assert(borrowed_ == 0);
+        if (budget_) {
+            budget_->set_reclaimer(nullptr);
+            budget_->release(charged_ * block_type::raw_size);
+        }
+        budget_ = nullptr;
+        charged_ = 0;
+        if (account) {
+            account->acquire(pool_.size() * block_type::raw_size);
+            charged_ = pool_.size();
+            account->set_reclaimer([this]() { give_back(); });
+        }
+        budget_ = account;
+    }
+
+    //! Appends an element to a bucket.
+    void push(size_t b, const value_type& value)
+    {
+        assert(b < buffers_.size());
+        buffer_type& buf = buffers_[b];
+        if (TLX_UNLIKELY(!buf.block))
+            take_block(b);
+
+        buf.block->elem[buf.fill++] = value;
+        if (TLX_UNLIKELY(buf.fill == block_type::size))
+            write_buffer(b);
+    }
+
+    /*!
+     * Writes all partially filled blocks and waits for the writes to
+     * complete. Afterwards, the buckets are complete and no more elements
+     * may be pushed.
+     */
+    void finish()
+    {
+        for (size_t b = 0; b < buffers_.size(); ++b)
+        {
+            if (buffers_[b].block && buffers_[b].fill > 0)
+                write_buffer(b);
+            else if (buffers_[b].block) {
+                pool_.add(buffers_[b].block);
+                --held_;
+            }
+        }
+        assert(held_ == 0);
+
+        pool_.resize(0);
+        if (budget_) {
+            budget_->set_reclaimer(nullptr);
+            budget_->release(charged_ * block_type::raw_size);
+            budget_->release_borrowed(borrowed_ * block_type::raw_size);
+        }
+        charged_ = borrowed_ = 0;
+    }
+
+    //! Returns the number of buckets.
+    size_t buckets() const { return buckets_.size(); }
+
+    //! Returns the blocks written for a bucket, complete after finish().
+    const bucket_type& bucket(size_t b) const { return buckets_[b]; }
+
+    //! Takes over the blocks of all buckets after finish(), the caller is
+    //! responsible for deleting the blocks.
+    std::vector<bucket_type> release_buckets()
+    {
+        std::vector<bucket_type> result;
+        std::swap(result, buckets_);
+        return result;
+    }
+
+    //! Returns the number of bucket blocks held in memory.
+    size_t held() const { return held_; }
+
+    //! Returns the number of partially filled blocks written before finish().
+    size_t spilled() const { return spilled_; }
+
+    //! Writes outstanding blocks, if finish() was not called.
+    ~partition_writer()
+    {
+        if (pool_.size() != 0)
+            finish();
+    }
+};
+
+//! \}
+
+} // namespace foxxll
+
+#endif // !FOXXLL_MNG_PARTITION_WRITER_HEADER
+
+/**************************************************************************/
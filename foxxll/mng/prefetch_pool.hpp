@@ -22,6 +22,7 @@
 #include <tlx/logger/core.hpp>
 
 #include <foxxll/config.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 #include <foxxll/mng/write_pool.hpp>
 
 namespace foxxll {
@@ -75,15 +76,102 @@ protected:
     //! count number of free blocks, since traversing the std::list is slow.
     size_t free_blocks_size;
 
+    //! budget the blocks are charged to, if any
+    memory_budget::account* budget_ = nullptr;
+
+    //! number of blocks charged to the budget
+    size_t charged_ = 0;
+
+    //! number of additional blocks borrowed from the budget for hints,
+    //! included in charged_
+    size_t borrowed_ = 0;
+
+    //! maximum number of additional blocks borrowed from the budget
+    size_t max_borrowed_;
+
+    //! allocate a block, charged to the budget if any
+    block_type * new_block()
+    {
+        if (budget_) {
+            budget_->acquire(block_type::raw_size);
+            ++charged_;
+        }
+        return new block_type;
+    }
+
+    //! add a free block borrowed from the budget, returns false if it has no
+    //! memory to spare
+    bool borrow()
+    {
+        // hints are speculative: do not take memory from other accounts
+        if (!budget_ || borrowed_ >= max_borrowed_ ||
+            !budget_->try_borrow_spare(block_type::raw_size))
+            return false;
+        ++charged_;
+        free_blocks.push_back(new block_type);
+        ++free_blocks_size;
+        ++borrowed_;
+        return true;
+    }
+
+    //! delete a block leaving the pool, borrowed blocks first
+    void free_block(block_type* block)
+    {
+        delete block;
+        if (borrowed_ > 0) {
+            --borrowed_, --charged_;
+            budget_->release_borrowed(block_type::raw_size);
+        }
+        else if (charged_ > 0) {
+            --charged_;
+            budget_->release(block_type::raw_size);
+        }
+    }
+
+    //! let the budget reclaim borrowed blocks synchronously, see
+    //! memory_budget::account::set_reclaimer()
+    void register_reclaimer()
+    {
+        if (budget_)
+            budget_->set_reclaimer([this]() { give_back(); });
+    }
+
+    //! return all charged blocks to the budget
+    void uncharge()
+    {
+        if (budget_) {
+            budget_->set_reclaimer(nullptr);
+            budget_->release((charged_ - borrowed_) * block_type::raw_size);
+            budget_->release_borrowed(borrowed_ * block_type::raw_size);
+        }
+        charged_ = borrowed_ = 0;
+    }
+
+    //! free blocks drawn from the budget if it asks for memory
+    void give_back()
+    {
+        while (borrowed_ > 0 && free_blocks_size > 0 &&
+               budget_->reclaim_requested() > 0)
+        {
+            --free_blocks_size;
+            free_block(free_blocks.back());
+            free_blocks.pop_back();
+        }
+    }
+
 public:
     //! Constructs pool.
     //! \param init_size initial number of blocks in the pool
-    explicit prefetch_pool(size_t init_size = 1)
-        : free_blocks_size(init_size)
+    //! \param budget account the blocks are charged to, see set_budget()
+    explicit prefetch_pool(size_t init_size = 1,
+                           memory_budget::account* budget = nullptr)
+        : free_blocks_size(init_size), budget_(budget),
+          max_borrowed_(init_size)
     {
         size_t i = 0;
         for ( ; i < init_size; ++i)
-            free_blocks.push_back(new block_type);
+            free_blocks.push_back(new_block());
+        register_reclaimer();
     }
 
     //! non-copyable: delete copy-constructor
@@ -96,6 +184,12 @@ public:
         std::swap(free_blocks, obj.free_blocks);
         std::swap(busy_blocks, obj.busy_blocks);
         std::swap(free_blocks_size, obj.free_blocks_size);
+        std::swap(budget_, obj.budget_);
+        std::swap(charged_, obj.charged_);
+        std::swap(borrowed_, obj.borrowed_);
+        std::swap(max_borrowed_, obj.max_borrowed_);
+        register_reclaimer();
+        obj.register_reclaimer();
     }
 
     //! Waits for completion of all ongoing read requests and frees memory.
@@ -118,6 +212,8 @@ public:
         }
         catch (...)
         { }
+
+        uncharge();
     }
 
     //! Returns number of owned blocks.
@@ -138,6 +234,33 @@ public:
         return busy_blocks.size();
     }
 
+    /*!
+     * Charge the blocks of the pool to a memory budget, blocking until the
+     * current blocks fit. Blocks allocated later by resize() are charged,
+     * too. When no free block is left for a hint, an additional block is
+     * borrowed if the budget is limited and has memory to spare, up to
+     * set_max_borrowed() blocks. The additional blocks are freed again when
+     * the budget asks for memory. The account must outlive the pool.
+     */
+    void set_budget(memory_budget::account* account)
+    {
+        uncharge();
+        budget_ = nullptr;
+        if (account) {
+            account->acquire(size() * block_type::raw_size);
+            charged_ = size();
+        }
+        budget_ = account;
+        register_reclaimer();
+    }
+
+    //! Set the maximum number of additional blocks borrowed from the budget
+    //! for hints, by default the initial size of the pool.
+    void set_max_borrowed(size_t max_borrowed)
+    {
+        max_borrowed_ = max_borrowed;
+    }
+
     //! Add a new block to prefetch pool, enlarges size of pool.
     void add(block_type*& block)
     {
@@ -179,7 +302,7 @@ public:
             return true;
         }
 
-        if (free_blocks_size) //  only if we have a free block
+        if (free_blocks_size || borrow()) //  only if we have a free block
         {
             --free_blocks_size;
             block_type* block = free_blocks.back();
@@ -217,7 +340,7 @@ public:
             return true;
         }
 
-        if (free_blocks_size) //  only if we have a free block
+        if (free_blocks_size || borrow()) //  only if we have a free block
         {
             --free_blocks_size;
             block_type* block = free_blocks.back();
@@ -256,6 +379,7 @@ public:
         ++free_blocks_size;
         free_blocks.push_back(cache_el->second.first);
         busy_blocks.erase(cache_el);
+        give_back();
         return true;
     }
 
@@ -315,6 +439,7 @@ public:
         block = cache_el->second.first;
         request_ptr result = cache_el->second.second;
         busy_blocks.erase(cache_el);
+        give_back();
         return result;
     }
 
@@ -331,6 +456,7 @@ public:
             block = cache_el->second.first;
             request_ptr result = cache_el->second.second;
             busy_blocks.erase(cache_el);
+            give_back();
             return result;
         }
 
@@ -361,9 +487,10 @@ public:
         int64_t diff = int64_t(new_size) - int64_t(size());
         if (diff > 0)
         {
-            free_blocks_size += diff;
-            while (--diff >= 0)
-                free_blocks.push_back(new block_type);
+            while (--diff >= 0) {
+                free_blocks.push_back(new_block());
+                ++free_blocks_size;
+            }
 
             return size();
         }
@@ -372,7 +499,7 @@ public:
         {
             ++diff;
             --free_blocks_size;
-            delete free_blocks.back();
+            free_block(free_blocks.back());
             free_blocks.pop_back();
         }
         return size();
@@ -17,13 +17,23 @@
 #include <cassert>
 
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <tlx/define.hpp>
 
 #include <foxxll/config.hpp>
+#include <foxxll/io/iostats.hpp>
 #include <foxxll/io/request_operations.hpp>
+#include <foxxll/mng/memory_budget.hpp>
 
 #define FOXXLL_VERBOSE_WPOOL(msg) \
     TLX_LOG << "write_pool[" << static_cast<void*>(this) << "]" << msg
@@ -34,6 +44,13 @@ namespace foxxll {
 //! \{
 
 //! Implements dynamically resizable buffered writing pool.
+//!
+//! Blocks in writing are indexed by their BID, and completed writes are
+//! reported by the requests' completion handlers, such that no operation
+//! scans all blocks in writing.
+//!
+//! Optionally, writes are collected in a batch and submitted sorted by file
+//! and offset, see set_batch_size().
 template <class BlockType>
 class write_pool
 {
@@ -49,11 +66,14 @@ public:
         block_type* block;
         request_ptr req;
         bid_type bid;
+        //! number of the write, reported on completion
+        size_t serial;
 
-        busy_entry() : block(nullptr) { }
-        busy_entry(const busy_entry& a) : block(a.block), req(a.req), bid(a.bid) { }
-        busy_entry(block_type*& bl, request_ptr& r, bid_type& bi)
-            : block(bl), req(r), bid(bi) { }
+        busy_entry() : block(nullptr), serial(0) { }
+        busy_entry(const busy_entry& a)
+            : block(a.block), req(a.req), bid(a.bid), serial(a.serial) { }
+        busy_entry(block_type*& bl, request_ptr& r, bid_type& bi, size_t se = 0)
+            : block(bl), req(r), bid(bi), serial(se) { }
 
         operator request_ptr () { return req; }
     };
@@ -61,21 +81,84 @@ public:
     using busy_blocks_iterator = typename std::list<busy_entry>::iterator;
 
 protected:
+    struct bid_hash
+    {
+        size_t operator () (const bid_type& bid) const noexcept
+        {
+            return size_t(bid.storage) +
+                   size_t(bid.offset & 0xffffffff) +
+                   size_t(bid.offset >> 32);
+        }
+    };
+
+    using bid_index_type =
+              std::unordered_map<bid_type, busy_blocks_iterator, bid_hash>;
+    using serial_index_type = std::unordered_map<size_t, busy_blocks_iterator>;
+
+    //! serials of completed writes in completion order, filled by the
+    //! completion handlers, which may outlive the pool
+    struct completion_queue
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<size_t> serials;
+        //! number of writes completed so far
+        size_t count = 0;
+    };
+
     // contains free write blocks
     std::list<block_type*> free_blocks;
-    // blocks that are in writing
+    // blocks that are in writing, in order of issue
     std::list<busy_entry> busy_blocks;
 
+    //! busy blocks by BID, without stale writes overwritten by a later one
+    bid_index_type bid_index_;
+
+    //! busy blocks by serial, to find completed writes
+    serial_index_type serial_index_;
+
+    std::shared_ptr<completion_queue> completed_ =
+        std::make_shared<completion_queue>();
+
+    //! serial of the next write
+    size_t next_serial_ = 0;
+
+    //! writes not yet submitted, in order of arrival
+    std::vector<std::pair<block_type*, bid_type> > batch_;
+
+    //! positions of the batched writes by BID
+    std::unordered_map<bid_type, size_t, bid_hash> batch_index_;
+
+    //! number of writes to collect before submitting them
+    size_t batch_size_ = 0;
+
+    //! budget the blocks are charged to, if any
+    memory_budget::account* budget_ = nullptr;
+
+    //! number of blocks charged to the budget
+    size_t charged_ = 0;
+
+    //! number of additional blocks borrowed from the budget by steal(),
+    //! included in charged_
+    size_t borrowed_ = 0;
+
+    //! maximum number of additional blocks borrowed from the budget
+    size_t max_borrowed_;
+
 public:
     //! Constructs pool.
     //! \param init_size initial number of blocks in the pool
-    explicit write_pool(size_t init_size = 1)
+    //! \param budget account the blocks are charged to, see set_budget()
+    explicit write_pool(size_t init_size = 1,
+                        memory_budget::account* budget = nullptr)
+        : budget_(budget), max_borrowed_(init_size)
     {
         for (size_t i = 0; i < init_size; ++i)
         {
-            free_blocks.push_back(new block_type);
+            free_blocks.push_back(new_block());
             FOXXLL_VERBOSE_WPOOL("  create block=" << free_blocks.back());
         }
+        register_reclaimer();
     }
 
     //! non-copyable: delete copy-constructor
@@ -87,6 +170,19 @@ public:
     {
         std::swap(free_blocks, obj.free_blocks);
         std::swap(busy_blocks, obj.busy_blocks);
+        std::swap(bid_index_, obj.bid_index_);
+        std::swap(serial_index_, obj.serial_index_);
+        std::swap(completed_, obj.completed_);
+        std::swap(next_serial_, obj.next_serial_);
+        std::swap(batch_, obj.batch_);
+        std::swap(batch_index_, obj.batch_index_);
+        std::swap(batch_size_, obj.batch_size_);
+        std::swap(budget_, obj.budget_);
+        std::swap(charged_, obj.charged_);
+        std::swap(borrowed_, obj.borrowed_);
+        std::swap(max_borrowed_, obj.max_borrowed_);
+        register_reclaimer();
+        obj.register_reclaimer();
     }
 
     //! Waits for completion of all ongoing write requests and frees memory.
@@ -105,48 +201,133 @@ public:
 
         try
         {
+            flush();
             for (busy_blocks_iterator i2 = busy_blocks.begin(); i2 != busy_blocks.end(); ++i2)
             {
                 i2->req->wait();
-                if (free_blocks.empty())
-                    FOXXLL_VERBOSE_WPOOL("  delete busy block=(empty)");
-                else
-                    FOXXLL_VERBOSE_WPOOL("  delete busy block=" << free_blocks.back());
+                FOXXLL_VERBOSE_WPOOL("  delete busy block=" << i2->block);
                 delete i2->block;
             }
         }
         catch (...)
         { }
+
+        uncharge();
     }
 
     //! Returns number of owned blocks.
-    size_t size() const { return free_blocks.size() + busy_blocks.size(); }
+    size_t size() const
+    {
+        return free_blocks.size() + busy_blocks.size() + batch_.size();
+    }
 
     //! Passes a block to the pool for writing.
     //! \param block block to write. Ownership of the block goes to the pool.
     //! \c block must be allocated dynamically with using \c new .
     //! \param bid location, where to write
     //! \warning \c block must be allocated dynamically with using \c new .
-    //! \return request object of the write operation
+    //! \return request object of the write operation, invalid if the write
+    //! was added to the batch
     request_ptr write(block_type*& block, bid_type bid)
     {
         FOXXLL_VERBOSE_WPOOL("::write: " << block << " @ " << bid);
-        for (busy_blocks_iterator i2 = busy_blocks.begin(); i2 != busy_blocks.end(); ++i2)
+        if (batch_size_ <= 1)
         {
-            if (i2->bid == bid) {
-                assert(i2->block != block);
-                FOXXLL_VERBOSE_WPOOL("WAW dependency");
-                // try to cancel the obsolete request
-                i2->req->cancel();
-                // invalidate the bid of the stale write request,
-                // prevents prefetch_pool from stealing a stale block
-                i2->bid.storage = 0;
-            }
+            request_ptr result = submit(block, bid);
+            block = nullptr; // prevent caller from using the block any further
+            give_back();
+            return result;
         }
-        request_ptr result = block->write(bid);
-        busy_blocks.push_back(busy_entry(block, result, bid));
+
+        typename std::unordered_map<bid_type, size_t, bid_hash>::iterator it =
+            batch_index_.find(bid);
+        if (it != batch_index_.end())
+        {
+            // the batched write was not submitted yet, simply replace it
+            FOXXLL_VERBOSE_WPOOL("WAW dependency in batch");
+            std::pair<block_type*, bid_type>& entry = batch_[it->second];
+            assert(entry.first != block);
+            free_blocks.push_back(entry.first);
+            entry.first = block;
+        }
+        else
+        {
+            batch_index_[bid] = batch_.size();
+            batch_.emplace_back(block, bid);
+        }
+
         block = nullptr; // prevent caller from using the block any further
-        return result;
+        if (batch_.size() >= batch_size_)
+            flush();
+        give_back();
+        return request_ptr();
+    }
+
+    /*!
+     * Collect up to batch_size writes before submitting them sorted by file
+     * and offset, which saves seeks if blocks are allocated randomly. The
+     * batch is also submitted if a block is needed or by flush(). A batch
+     * size of zero or one submits each write immediately.
+     */
+    void set_batch_size(size_t batch_size)
+    {
+        batch_size_ = batch_size;
+        if (batch_.size() >= batch_size_)
+            flush();
+    }
+
+    //! Returns the number of writes collected before submitting them.
+    size_t batch_size() const { return batch_size_; }
+
+    //! Submits all batched writes, sorted by file and offset.
+    void flush()
+    {
+        if (batch_.empty())
+            return;
+
+        FOXXLL_VERBOSE_WPOOL("::flush : submitting " << batch_.size() << " writes");
+        std::sort(batch_.begin(), batch_.end(),
+                  [](const std::pair<block_type*, bid_type>& a,
+                     const std::pair<block_type*, bid_type>& b) {
+                      if (a.second.storage != b.second.storage)
+                          return std::less<file*>()(a.second.storage, b.second.storage);
+                      return a.second.offset < b.second.offset;
+                  });
+
+        std::vector<std::pair<block_type*, bid_type> > batch;
+        std::swap(batch, batch_);
+        batch_index_.clear();
+
+        for (std::pair<block_type*, bid_type>& entry : batch)
+            submit(entry.first, entry.second);
+    }
+
+    /*!
+     * Charge the blocks of the pool to a memory budget, blocking until the
+     * current blocks fit. Blocks allocated later by resize() are charged,
+     * too. When all blocks are busy, steal() then borrows an additional
+     * block if the budget is limited and permits, up to set_max_borrowed()
+     * blocks, instead of waiting for a write to complete. The additional
+     * blocks are freed again when the budget asks for memory. The account
+     * must outlive the pool.
+     */
+    void set_budget(memory_budget::account* account)
+    {
+        uncharge();
+        budget_ = nullptr;
+        if (account) {
+            account->acquire(size() * block_type::raw_size);
+            charged_ = size();
+        }
+        budget_ = account;
+        register_reclaimer();
+    }
+
+    //! Set the maximum number of additional blocks borrowed from the budget
+    //! by steal(), by default the initial size of the pool.
+    void set_max_borrowed(size_t max_borrowed)
+    {
+        max_borrowed_ = max_borrowed;
     }
 
     //! Take out a block from the pool.
@@ -154,24 +335,71 @@ public:
     block_type * steal()
     {
         assert(size() > 0);
-        if (!free_blocks.empty())
+        if (free_blocks.empty())
+            check_all_busy();
+
+        if (free_blocks.empty() && budget_ && borrowed_ < max_borrowed_ &&
+            budget_->try_borrow(block_type::raw_size))
         {
-            block_type* p = free_blocks.back();
-            FOXXLL_VERBOSE_WPOOL("::steal : " << free_blocks.size() << " free blocks available, serve block=" << p);
-            free_blocks.pop_back();
-            return p;
+            ++charged_, ++borrowed_;
+            FOXXLL_VERBOSE_WPOOL("::steal : borrowed block " << borrowed_ << " from budget");
+            return new block_type;
+        }
+
+        return take_free_block();
+    }
+
+    //! Take out a free block without waiting. Batched writes are submitted
+    //! if no block is free, so that a later wait_for_write() returns.
+    //! \return pointer to the block, nullptr if all blocks are busy.
+    //! Ownership of the block goes to the caller.
+    block_type * try_steal()
+    {
+        if (free_blocks.empty())
+            check_all_busy();
+        if (free_blocks.empty())
+        {
+            flush();
+            return nullptr;
         }
-        FOXXLL_VERBOSE_WPOOL("::steal : all " << busy_blocks.size() << " are busy");
-        busy_blocks_iterator completed = wait_any(busy_blocks.begin(), busy_blocks.end());
-        assert(completed != busy_blocks.end()); // we got something reasonable from wait_any
-        assert(completed->req->poll());         // and it is *really* completed
-        block_type* p = completed->block;
-        busy_blocks.erase(completed);
-        check_all_busy();                       // for debug
-        FOXXLL_VERBOSE_WPOOL("  serve block=" << p);
+
+        block_type* p = free_blocks.back();
+        free_blocks.pop_back();
         return p;
     }
 
+    //! Submits all batched writes and returns the requests of all writes in
+    //! progress, e.g. to wait for them without using the pool meanwhile.
+    std::vector<request_ptr> pending_requests()
+    {
+        flush();
+        std::vector<request_ptr> reqs;
+        reqs.reserve(busy_blocks.size());
+        for (const busy_entry& entry : busy_blocks)
+            reqs.push_back(entry.req);
+        return reqs;
+    }
+
+    //! Number of writes completed so far, to be passed to wait_for_write().
+    size_t completed_writes() const
+    {
+        std::unique_lock<std::mutex> lock(completed_->mutex);
+        return completed_->count;
+    }
+
+    //! Wait until more than \b seen writes have completed, see
+    //! completed_writes(), or completed writes are not yet processed. Unlike
+    //! the other methods, this may be called concurrently with the thread
+    //! using the pool.
+    void wait_for_write(size_t seen) const
+    {
+        std::unique_lock<std::mutex> lock(completed_->mutex);
+        completed_->cv.wait(
+            lock, [this, seen]() {
+                return completed_->count != seen || !completed_->serials.empty();
+            });
+    }
+
     //! Resizes size of the pool.
     //! \param new_size new size of the pool after the call
     void resize(size_t new_size)
@@ -181,47 +409,50 @@ public:
         {
             while (--diff >= 0)
             {
-                free_blocks.push_back(new block_type);
+                free_blocks.push_back(new_block());
                 FOXXLL_VERBOSE_WPOOL("  create block=" << free_blocks.back());
             }
 
             return;
         }
 
+        // shrinking must not borrow blocks only to delete them
         while (++diff <= 0)
-            delete steal();
+            free_block(take_free_block());
     }
 
     bool has_request(bid_type bid)
     {
-        for (busy_blocks_iterator i2 = busy_blocks.begin(); i2 != busy_blocks.end(); ++i2)
-        {
-            if (i2->bid == bid)
-                return true;
-        }
-        return false;
+        return bid_index_.find(bid) != bid_index_.end() ||
+               batch_index_.find(bid) != batch_index_.end();
     }
 
     // returns a block and a (potentially unfinished) I/O request associated with it
     std::pair<block_type*, request_ptr> steal_request(bid_type bid)
     {
-        for (busy_blocks_iterator i2 = busy_blocks.begin(); i2 != busy_blocks.end(); ++i2)
+        // the block must reach the disk, as the caller may treat it as clean
+        if (batch_index_.find(bid) != batch_index_.end())
+            flush();
+
+        typename bid_index_type::iterator it = bid_index_.find(bid);
+        if (it == bid_index_.end())
         {
-            if (i2->bid == bid)
-            {
-                // remove busy block from list, request has not yet been waited for!
-                block_type* blk = i2->block;
-                request_ptr req = i2->req;
-                busy_blocks.erase(i2);
-
-                FOXXLL_VERBOSE_WPOOL("::steal_request block=" << blk);
-                // hand over block and (unfinished) request to caller
-                return std::pair<block_type*, request_ptr>(blk, req);
-            }
+            FOXXLL_VERBOSE_WPOOL("::steal_request NOT FOUND");
+            // not matching request found, return a dummy
+            return std::pair<block_type*, request_ptr>(nullptr, request_ptr());
         }
-        FOXXLL_VERBOSE_WPOOL("::steal_request NOT FOUND");
-        // not matching request found, return a dummy
-        return std::pair<block_type*, request_ptr>(nullptr, request_ptr());
+
+        // remove busy block from list, request has not yet been waited for!
+        busy_blocks_iterator i2 = it->second;
+        block_type* blk = i2->block;
+        request_ptr req = i2->req;
+        bid_index_.erase(it);
+        serial_index_.erase(i2->serial);
+        busy_blocks.erase(i2);
+
+        FOXXLL_VERBOSE_WPOOL("::steal_request block=" << blk);
+        // hand over block and (unfinished) request to caller
+        return std::pair<block_type*, request_ptr>(blk, req);
     }
 
     void add(block_type*& block)
@@ -232,25 +463,181 @@ public:
     }
 
 protected:
+    //! issue the write of a block, replacing a pending write of the same BID
+    request_ptr submit(block_type* block, bid_type bid)
+    {
+        typename bid_index_type::iterator it = bid_index_.find(bid);
+        if (it != bid_index_.end())
+        {
+            busy_blocks_iterator i2 = it->second;
+            assert(i2->block != block);
+            FOXXLL_VERBOSE_WPOOL("WAW dependency");
+            // try to cancel the obsolete request
+            i2->req->cancel();
+            // invalidate the bid of the stale write request,
+            // prevents prefetch_pool from stealing a stale block
+            i2->bid.storage = 0;
+            bid_index_.erase(it);
+        }
+
+        const size_t serial = next_serial_++;
+        std::shared_ptr<completion_queue> queue = completed_;
+        request_ptr result = block->write(
+            bid, [queue, serial](request*, bool) {
+                std::unique_lock<std::mutex> lock(queue->mutex);
+                queue->serials.push_back(serial);
+                ++queue->count;
+                queue->cv.notify_all();
+            });
+
+        busy_blocks.push_back(busy_entry(block, result, bid, serial));
+        busy_blocks_iterator entry = std::prev(busy_blocks.end());
+        bid_index_[bid] = entry;
+        serial_index_[serial] = entry;
+        return result;
+    }
+
+    //! take out a free block, waiting for a write to complete if all are
+    //! busy, never borrowing from the budget
+    block_type * take_free_block()
+    {
+        if (free_blocks.empty())
+            check_all_busy();
+
+        if (free_blocks.empty())
+        {
+            FOXXLL_VERBOSE_WPOOL("::take_free_block : all " << busy_blocks.size() << " are busy");
+            // the batched writes must complete for their blocks to be free
+            flush();
+            stats::scoped_wait_timer wait_timer(stats::WAIT_OP_ANY);
+
+            // completions of writes taken over by steal_request() are
+            // reported, too, but free no block: wait until one is free
+            while (free_blocks.empty())
+            {
+                assert(!busy_blocks.empty());
+                std::unique_lock<std::mutex> lock(completed_->mutex);
+                completed_->cv.wait(
+                    lock, [this]() { return !completed_->serials.empty(); });
+                lock.unlock();
+
+                check_all_busy();
+            }
+        }
+
+        block_type* p = free_blocks.back();
+        FOXXLL_VERBOSE_WPOOL("::take_free_block : " << free_blocks.size() << " free blocks available, serve block=" << p);
+        free_blocks.pop_back();
+        return p;
+    }
+
+    //! allocate a block, charged to the budget if any
+    block_type * new_block()
+    {
+        if (budget_) {
+            budget_->acquire(block_type::raw_size);
+            ++charged_;
+        }
+        return new block_type;
+    }
+
+    //! delete a block leaving the pool, borrowed blocks first
+    void free_block(block_type* block)
+    {
+        delete block;
+        if (borrowed_ > 0) {
+            --borrowed_, --charged_;
+            budget_->release_borrowed(block_type::raw_size);
+        }
+        else if (charged_ > 0) {
+            --charged_;
+            budget_->release(block_type::raw_size);
+        }
+    }
+
+    //! let the budget reclaim borrowed blocks synchronously, see
+    //! memory_budget::account::set_reclaimer()
+    void register_reclaimer()
+    {
+        if (budget_)
+            budget_->set_reclaimer([this]() { give_back(); });
+    }
+
+    //! return all charged blocks to the budget
+    void uncharge()
+    {
+        if (budget_) {
+            budget_->set_reclaimer(nullptr);
+            budget_->release((charged_ - borrowed_) * block_type::raw_size);
+            budget_->release_borrowed(borrowed_ * block_type::raw_size);
+        }
+        charged_ = borrowed_ = 0;
+    }
+
+    //! free blocks drawn from the budget if it asks for memory
+    void give_back()
+    {
+        if (borrowed_ == 0 || budget_->reclaim_requested() == 0)
+            return;
+
+        check_all_busy();
+        while (borrowed_ > 0 && budget_->reclaim_requested() > 0 &&
+               !free_blocks.empty())
+        {
+            free_block(free_blocks.back());
+            free_blocks.pop_back();
+        }
+    }
+
+    //! move the blocks of all completed writes to the free blocks, in
+    //! completion order
     void check_all_busy()
     {
-        busy_blocks_iterator cur = busy_blocks.begin();
+        std::vector<size_t> serials;
+        {
+            std::unique_lock<std::mutex> lock(completed_->mutex);
+            std::swap(serials, completed_->serials);
+        }
+
         size_t cnt = 0;
-        while (cur != busy_blocks.end())
+        std::exception_ptr error;
+        for (size_t serial : serials)
         {
-            if (cur->req->poll())
-            {
-                free_blocks.push_back(cur->block);
-                cur = busy_blocks.erase(cur);
-                ++cnt;
+            // writes taken over by steal_request() are gone
+            typename serial_index_type::iterator it = serial_index_.find(serial);
+            if (it == serial_index_.end())
                 continue;
+
+            busy_blocks_iterator i2 = it->second;
+            request_ptr req = i2->req;
+
+            serial_index_.erase(it);
+            // stale writes were removed from the BID index already
+            typename bid_index_type::iterator bi = bid_index_.find(i2->bid);
+            if (bi != bid_index_.end() && bi->second == i2)
+                bid_index_.erase(bi);
+
+            free_blocks.push_back(i2->block);
+            busy_blocks.erase(i2);
+            ++cnt;
+
+            // report I/O errors as waiting would, after the block was freed
+            // and the remaining completions were processed
+            try {
+                req->poll();
+            }
+            catch (...) {
+                if (!error)
+                    error = std::current_exception();
             }
-            ++cur;
         }
         FOXXLL_VERBOSE_WPOOL(
             "::check_all_busy : " << cnt <<
                 " are completed out of " << busy_blocks.size() + cnt << " busy blocks"
         );
+
+        if (error)
+            std::rethrow_exception(error);
     }
 };
 
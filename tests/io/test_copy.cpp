@@ -0,0 +1,122 @@
+/***************************************************************************
+ *  tests/io/test_copy.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <cstring>
+#include <string>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/io.hpp>
+
+//! \example io/test_copy.cpp
+//! This tests copying ranges between files with file::acopy().
+
+using foxxll::file;
+
+struct print_completion
+{
+    void operator () (foxxll::request* ptr, bool success)
+    {
+        LOG1 << "Copy request completed: " << ptr << " success: " << success;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        LOG1 << "Usage: " << argv[0] << " filetype tempfile";
+        return -1;
+    }
+
+    constexpr size_t size = 1024 * 1024;
+    constexpr size_t kNumBlocks = 8;
+    // larger than the chunks of the buffered fallback
+    constexpr size_t large_size = 5 * size;
+
+    auto* buffer = static_cast<uint32_t*>(foxxll::aligned_alloc<4096>(large_size));
+
+    foxxll::file_ptr src = foxxll::create_file(
+            argv[1], std::string(argv[2]) + "_src",
+            file::CREAT | file::RDWR | file::DIRECT
+        );
+    foxxll::file_ptr dst = foxxll::create_file(
+            argv[1], std::string(argv[2]) + "_dst",
+            file::CREAT | file::RDWR | file::DIRECT
+        );
+
+    src->set_size(kNumBlocks * size);
+    dst->set_size(kNumBlocks * size);
+
+    foxxll::request_ptr req[kNumBlocks];
+
+    // fill source blocks with a pattern depending on the block index
+    for (size_t b = 0; b < kNumBlocks; ++b) {
+        for (size_t i = 0; i < size / sizeof(uint32_t); ++i)
+            buffer[i] = static_cast<uint32_t>(b * size + i);
+        src->awrite(buffer, b * size, size)->wait();
+    }
+
+    // copy blocks in reverse order into the other file
+    for (size_t b = 0; b < kNumBlocks; ++b) {
+        req[b] = src->acopy(
+                dst.get(), b * size, (kNumBlocks - 1 - b) * size, size,
+                print_completion()
+            );
+    }
+    wait_all(req, kNumBlocks);
+
+    // copy the first half of the target onto its second half, block by block
+    // if a request cannot span several blocks, e.g. for fileperblock
+    if (dst->supports_multiblock_requests()) {
+        dst->acopy(dst.get(), 0, kNumBlocks / 2 * size, kNumBlocks / 2 * size)->wait();
+    }
+    else {
+        for (size_t b = 0; b < kNumBlocks / 2; ++b)
+            req[b] = dst->acopy(dst.get(), b * size, (kNumBlocks / 2 + b) * size, size);
+        wait_all(req, kNumBlocks / 2);
+    }
+
+    for (size_t b = 0; b < kNumBlocks; ++b)
+    {
+        dst->aread(buffer, b * size, size)->wait();
+
+        size_t src_block = kNumBlocks - 1 - (b % (kNumBlocks / 2));
+        for (size_t i = 0; i < size / sizeof(uint32_t); ++i)
+            die_unequal(buffer[i], static_cast<uint32_t>(src_block * size + i));
+    }
+
+    // copy a single large block, which is bounced in several chunks
+    for (size_t i = 0; i < large_size / sizeof(uint32_t); ++i)
+        buffer[i] = static_cast<uint32_t>(i ^ 0x5a5a5a5a);
+    src->awrite(buffer, 0, large_size)->wait();
+
+    src->acopy(dst.get(), 0, 0, large_size)->wait();
+
+    std::memset(buffer, 0, large_size);
+    dst->aread(buffer, 0, large_size)->wait();
+    for (size_t i = 0; i < large_size / sizeof(uint32_t); ++i)
+        die_unequal(buffer[i], static_cast<uint32_t>(i ^ 0x5a5a5a5a));
+
+    LOG1 << *foxxll::stats::get_instance();
+
+    foxxll::aligned_dealloc<4096>(buffer);
+
+    src->close_remove();
+    dst->close_remove();
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,106 @@
+/***************************************************************************
+ *  tests/mng/test_adaptive_prefetcher.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/adaptive_block_prefetcher.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_blocks = 200;
+constexpr size_t min_buffers = 2;
+constexpr size_t max_buffers = 16;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = block_type::bid_type;
+using bid_iterator = std::vector<bid_type>::iterator;
+using prefetcher_type =
+    foxxll::adaptive_block_prefetcher<block_type, bid_iterator>;
+
+// forced instantiation
+template class foxxll::adaptive_block_prefetcher<block_type, bid_iterator>;
+
+//! scan the sequence, sleeping per block, returns the largest window
+size_t scan(prefetcher_type& prefetcher, std::chrono::microseconds delay)
+{
+    size_t max_window = prefetcher.window();
+    block_type* block = prefetcher.pull_block();
+    size_t i = 0;
+    do {
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal((*block)[j], i * block_type::size + j);
+        ++i;
+        if (delay.count() != 0)
+            std::this_thread::sleep_for(delay);
+        max_window = std::max(max_window, prefetcher.window());
+        die_unless(prefetcher.buffers() <= max_buffers);
+    } while (prefetcher.block_consumed(block));
+
+    die_unequal(i, num_blocks);
+    die_unless(prefetcher.empty());
+    return max_window;
+}
+
+int main()
+{
+    foxxll::config::get_instance()->add_disk(
+        foxxll::disk_config("/tmp/foxxll-adaptive", 64 * 1024 * 1024, "memory"));
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    {
+        block_type* block = new block_type;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            for (size_t j = 0; j < block_type::size; ++j)
+                (*block)[j] = i * block_type::size + j;
+            block->write(bids[i])->wait();
+        }
+        delete block;
+    }
+
+    // a consumer slower than the disk keeps the minimum window
+    {
+        prefetcher_type prefetcher(
+            bids.begin(), bids.end(), min_buffers, max_buffers);
+        scan(prefetcher, std::chrono::microseconds(2000));
+        die_unequal(prefetcher.window(), min_buffers);
+        die_unless(prefetcher.buffers() <= min_buffers + 1);
+    }
+
+    // a consumer faster than the disk deepens the window, taking the extra
+    // buffers from a shared pool and handing them back afterwards
+    foxxll::concurrent_prefetch_pool<block_type> pool(max_buffers);
+    {
+        prefetcher_type prefetcher(
+            bids.begin(), bids.end(), min_buffers, max_buffers, &pool);
+        const size_t max_window = scan(prefetcher, std::chrono::microseconds(0));
+        LOG1 << "fast consumer: max window " << max_window
+             << ", stalls " << prefetcher.stalls();
+        die_unless(max_window > min_buffers);
+        die_unless(pool.free_size() < max_buffers);
+    }
+    die_unequal(pool.free_size(), max_buffers);
+
+    bm->delete_blocks(bids.begin(), bids.end());
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -11,8 +11,10 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <algorithm>
 #include <cstdlib>
 #include <random>
+#include <vector>
 
 #include <tlx/die.hpp>
 #include <tlx/logger.hpp>
@@ -65,6 +67,45 @@ int main(int argc, char* argv[])
         LOG1 << "request " << i << "  on disk " << disks[i] << "  scheduled as " << j;
     }
 
+    // a prefetcher with m buffers needs block i among the first i + m reads
+    auto check_schedule = [&](const size_t* order) {
+        std::vector<size_t> position(L, L);
+        for (size_t i = 0; i < L; ++i) {
+            die_unless(order[i] < L);
+            die_unless(position[order[i]] == L);
+            position[order[i]] = i;
+        }
+        for (size_t i = 0; i < L; ++i)
+            die_unless(position[i] < i + m);
+    };
+    check_schedule(prefetch_order);
+
+    // windowed schedule: identical for a single window, valid for several
+    std::vector<size_t> windowed(L);
+    foxxll::compute_windowed_prefetch_schedule(
+        disks, disks + L, windowed.data(), m, D, L);
+    die_unless(std::equal(windowed.begin(), windowed.end(), prefetch_order));
+
+    const size_t window = std::max<size_t>(L / 5, 1);
+    foxxll::compute_windowed_prefetch_schedule(
+        disks, disks + L, windowed.data(), m, D, window);
+    check_schedule(windowed.data());
+    for (size_t i = 0; i < L; ++i)
+        die_unless(windowed[i] / window == i / window);
+
+    // heterogeneous disks: uniform times give the unit time schedule, others
+    // a valid schedule
+    std::vector<double> service_times(D, 0.002);
+    foxxll::compute_prefetch_schedule(
+        disks, disks + L, windowed.data(), m, D, service_times);
+    die_unless(std::equal(windowed.begin(), windowed.end(), prefetch_order));
+
+    for (size_t d = 0; d < D; d += 2)
+        service_times[d] = 0.010;
+    foxxll::compute_prefetch_schedule(
+        disks, disks + L, windowed.data(), m, D, service_times);
+    check_schedule(windowed.data());
+
     delete[] count;
     delete[] disks;
     delete[] prefetch_order;
@@ -12,8 +12,11 @@
  *  http://www.boost.org/LICENSE_1_0.txt)
  **************************************************************************/
 
+#include <cmath>
 #include <sstream>
+#include <vector>
 
+#include <tlx/die.hpp>
 #include <tlx/logger.hpp>
 
 #include <foxxll/common/error_handling.hpp>
@@ -55,6 +58,12 @@ int main()
 {
     foxxll::config* cfg = foxxll::config::get_instance();
 
+    // two fixed size disks, such that free space determines the weights
+    cfg->add_disk(foxxll::disk_config(
+                      "/tmp/foxxll-strategy-0", 16 * 1024 * 1024, "memory autogrow=no"));
+    cfg->add_disk(foxxll::disk_config(
+                      "/tmp/foxxll-strategy-1", 16 * 1024 * 1024, "memory autogrow=no"));
+
     // instantiate the allocation strategies
     LOG1 << "Number of disks: " << cfg->disks_number();
     for (unsigned i = 0; i < cfg->disks_number(); ++i)
@@ -70,6 +79,46 @@ int main()
     if (cfg->flash_range().first != cfg->flash_range().second)
         test_strategy<foxxll::random_cyclic_flash>();
     test_strategy<foxxll::single_disk>();
+    test_strategy<foxxll::load_aware>();
+
+    // the load-aware strategy only selects disks with positive weight
+    foxxll::load_aware load_aware;
+    for (unsigned i = 0; i < 64; ++i) {
+        die_unless(load_aware(i) < cfg->disks_number());
+        die_unless(load_aware.weight(load_aware(i)) > 0);
+    }
+
+    // half of disk 0 is used: it receives half as many blocks as disk 1
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    std::vector<foxxll::BID<1024* 1024> > bids(8);
+    bm->new_blocks(foxxll::single_disk(0), bids.begin(), bids.end());
+    load_aware.refresh();
+    die_unless(load_aware.weight(0) < load_aware.weight(1));
+
+    const size_t nslots = 16 * cfg->disks_number();
+    const double sum = load_aware.weight(0) + load_aware.weight(1);
+    std::vector<size_t> count(cfg->disks_number(), 0);
+    for (size_t i = 0; i < nslots; ++i)
+        ++count[load_aware(i)];
+    for (size_t d = 0; d < count.size(); ++d) {
+        const double expected = nslots * load_aware.weight(d) / sum;
+        die_unless(std::abs(count[d] - expected) <= 1.0);
+    }
+
+    // draining disks receive no blocks
+    bm->set_draining(1);
+    foxxll::load_aware drain;
+    die_unequal(drain.weight(1), 0.0);
+    for (size_t i = 0; i < nslots; ++i)
+        die_unequal(drain(i), 0u);
+
+    // not even if all disks are draining
+    bm->set_draining(0);
+    die_unless_throws(foxxll::load_aware(), foxxll::bad_ext_alloc);
+    bm->set_draining(0, false);
+    bm->set_draining(1, false);
+
+    bm->delete_blocks(bids.begin(), bids.end());
 }
 
 /**************************************************************************/
@@ -0,0 +1,211 @@
+/***************************************************************************
+ *  tests/mng/test_block_cache.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_cache.hpp>
+
+constexpr size_t block_size = 4 * 1024;
+constexpr size_t num_blocks = 256;
+constexpr size_t capacity = 16;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = block_type::bid_type;
+using cache_type = foxxll::block_cache<block_type>;
+
+// forced instantiation
+template class foxxll::block_cache<block_type>;
+
+std::vector<bid_type> bids(num_blocks);
+
+void check_block(block_type& block, size_t i, size_t tag = 0)
+{
+    for (size_t j = 0; j < block_type::size; ++j)
+        die_unequal(block[j], tag + i * block_type::size + j);
+}
+
+void test_scan_resistance()
+{
+    cache_type cache(capacity);
+
+    // a hot set accessed twice, which moves it to the frequency list
+    const size_t hot = capacity / 2;
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t i = 0; i < hot; ++i) {
+            check_block(*cache.pin(bids[i]), i);
+            cache.unpin(bids[i]);
+        }
+    }
+    die_unequal(cache.hits(), hot);
+
+    // a long scan does not evict the hot set
+    for (size_t i = hot; i < num_blocks; ++i) {
+        check_block(*cache.pin(bids[i]), i);
+        cache.unpin(bids[i]);
+    }
+    die_unequal(cache.size(), capacity);
+
+    for (size_t i = 0; i < hot; ++i) {
+        check_block(*cache.pin(bids[i]), i);
+        cache.unpin(bids[i]);
+    }
+    die_unequal(cache.hits(), 2 * hot);
+    die_unequal(cache.misses(), num_blocks);
+    die_unequal(cache.evictions(), num_blocks - capacity);
+}
+
+void test_write_back(size_t write_blocks)
+{
+    // without write blocks, evictions wait for the write-backs
+    cache_type cache(capacity, write_blocks);
+    const size_t tag = 1000000;
+
+    // overwrite blocks without reading them, evicting them by a scan
+    for (size_t i = 0; i < capacity; ++i) {
+        block_type* block = cache.pin(bids[i], false);
+        for (size_t j = 0; j < block_type::size; ++j)
+            (*block)[j] = tag + i * block_type::size + j;
+        cache.unpin(bids[i], true);
+    }
+    for (size_t i = capacity; i < 3 * capacity; ++i) {
+        cache.pin(bids[i]);
+        cache.unpin(bids[i]);
+    }
+    die_unequal(cache.writebacks(), capacity);
+
+    // pinning again returns the new contents, from disk or the write pool
+    for (size_t i = 0; i < capacity; ++i) {
+        check_block(*cache.pin(bids[i]), i, tag);
+        cache.unpin(bids[i], true);
+    }
+
+    // flush writes dirty blocks and keeps them cached
+    const size_t misses = cache.misses();
+    cache.flush();
+    die_unequal(cache.writebacks(), 2 * capacity);
+
+    block_type* block = new block_type;
+    for (size_t i = 0; i < capacity; ++i) {
+        block->read(bids[i])->wait();
+        check_block(*block, i, tag);
+
+        // restore original contents
+        for (size_t j = 0; j < block_type::size; ++j)
+            (*block)[j] = i * block_type::size + j;
+        block->write(bids[i])->wait();
+        die_unless(cache.invalidate(bids[i]));
+    }
+    delete block;
+    die_unequal(cache.misses(), misses);
+}
+
+void test_pinned()
+{
+    cache_type cache(2);
+    cache.pin(bids[0]);
+    cache.pin(bids[1]);
+    die_unless_throws(cache.pin(bids[2]), foxxll::resource_error);
+    die_unless(!cache.invalidate(bids[0]));
+
+    cache.unpin(bids[1]);
+    check_block(*cache.pin(bids[2]), 2);
+    cache.unpin(bids[2]);
+    cache.unpin(bids[0]);
+}
+
+void test_read_error(const std::string& path)
+{
+    cache_type cache(2);
+
+    // reading past the end of a file fails, the block is not kept pinned
+    foxxll::file_ptr file = foxxll::create_file(
+            "syscall", path, foxxll::file::CREAT | foxxll::file::RDWR);
+    const bid_type bad(file.get(), 1024 * block_size);
+    die_unless_throws(cache.pin(bad), foxxll::io_error);
+    die_unequal(cache.size(), 0u);
+
+    for (size_t i = 0; i < 4; ++i) {
+        check_block(*cache.pin(bids[i]), i);
+        cache.unpin(bids[i]);
+    }
+    die_unequal(cache.size(), 2u);
+
+    file->close_remove();
+}
+
+void test_threads()
+{
+    cache_type cache(capacity);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&cache, t]() {
+                std::mt19937 rng(static_cast<unsigned>(t));
+                for (size_t n = 0; n < 2000; ++n) {
+                    const size_t i = rng() % (2 * capacity);
+                    check_block(*cache.pin(bids[i]), i);
+                    cache.unpin(bids[i]);
+                }
+            });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    die_unequal(cache.hits() + cache.misses(), 4 * 2000u);
+    LOG1 << "block_cache: " << cache.hits() << " hits, "
+         << cache.misses() << " misses";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG1 << "Usage: " << argv[0] << " tempfile";
+        return -1;
+    }
+
+    foxxll::config::get_instance()->add_disk(
+        foxxll::disk_config("/tmp/foxxll-block-cache", 16 * 1024 * 1024, "memory"));
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    block_type* block = new block_type;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        for (size_t j = 0; j < block_type::size; ++j)
+            (*block)[j] = i * block_type::size + j;
+        block->write(bids[i])->wait();
+    }
+    delete block;
+
+    test_scan_resistance();
+    test_write_back(2);
+    test_write_back(0);
+    test_pinned();
+    test_read_error(argv[1]);
+    test_threads();
+
+    bm->delete_blocks(bids.begin(), bids.end());
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,228 @@
+/***************************************************************************
+ *  tests/mng/test_block_catalog.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_catalog.hpp>
+
+#if !FOXXLL_WINDOWS
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_blocks = 40;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = foxxll::BID<block_size>;
+
+void configure(const std::string& path)
+{
+    foxxll::disk_config cfg(path, 16 * 1024 * 1024, "syscall catalog");
+    die_unless(cfg.catalog);
+    die_unless(!cfg.delete_on_exit);
+    die_unequal(cfg.fileio_string(), "syscall catalog");
+
+    // the data file must outlive its catalog, whatever the order
+    die_unless_throws(
+        foxxll::disk_config(path, 0, "syscall delete catalog"),
+        std::runtime_error);
+    die_unless_throws(
+        foxxll::disk_config(path, 0, "syscall catalog delete_on_exit"),
+        std::runtime_error);
+    die_unless_throws(
+        foxxll::disk_config(path, 0, "syscall catalog unlink"),
+        std::runtime_error);
+
+    foxxll::config::get_instance()->add_disk(cfg);
+}
+
+//! first process: allocate, fill and catalog a sequence, then exit
+int store(const std::string& path)
+{
+    configure(path);
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    // a sequence which is not catalogued and vanishes with the process
+    std::vector<bid_type> temp(num_blocks);
+    bm->new_blocks(foxxll::striping(), temp.begin(), temp.end());
+
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    // direct I/O requires aligned blocks
+    block_type* block = new block_type;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        for (size_t j = 0; j < block_type::size; ++j)
+            (*block)[j] = i * block_type::size + j;
+        block->write(bids[i])->wait();
+    }
+    delete block;
+
+    bm->catalog_store("data", bids.begin(), bids.end());
+    bm->catalog_commit();
+
+    // the catalog is written again when the block_manager is destroyed at
+    // exit, the first generation is kept as previous one
+    return 0;
+}
+
+//! second process: reattach to the catalogued sequence
+void reattach(const std::string& path)
+{
+    configure(path);
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    die_unequal(bm->catalog_names().size(), 1u);
+    die_unequal(bm->catalog_names()[0], std::string("data"));
+    die_unequal(bm->current_allocation(), num_blocks * block_size);
+
+    std::vector<bid_type> bids;
+    die_unless(bm->catalog_load("data", bids));
+    die_unless(!bm->catalog_load("missing", bids));
+    die_unequal(bids.size(), num_blocks);
+
+    block_type* block = new block_type;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        block->read(bids[i])->wait();
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal((*block)[j], i * block_type::size + j);
+    }
+    delete block;
+
+    // new blocks do not overlap the catalogued ones
+    std::vector<bid_type> more(2 * num_blocks);
+    bm->new_blocks(foxxll::striping(), more.begin(), more.end());
+    for (const bid_type& a : more) {
+        for (const bid_type& b : bids)
+            die_unless(a.offset + block_size <= b.offset ||
+                       b.offset + block_size <= a.offset);
+    }
+    bm->delete_blocks(more.begin(), more.end());
+
+    // blocks of other disks cannot be catalogued
+    foxxll::file_ptr own = foxxll::create_file(
+            "memory", path + ".own", foxxll::file::CREAT | foxxll::file::RDWR);
+    bid_type foreign(own.get(), 0);
+    die_unless_throws(bm->catalog_store("foreign", &foreign, &foreign + 1),
+                      std::invalid_argument);
+
+    die_unless(bm->catalog_erase("data"));
+    bm->delete_blocks(bids.begin(), bids.end());
+    bm->catalog_commit();
+    die_unless(bm->catalog_names().empty());
+}
+
+#if !FOXXLL_WINDOWS
+//! saves failing on one disk keep the last complete generation loadable
+void test_failed_save(const std::string& path)
+{
+    using catalog = foxxll::block_catalog;
+    const std::vector<std::string> disks = { path + "_a", path + "_b" };
+    for (const std::string& disk : disks) {
+        std::remove(catalog::superblock_path(disk).c_str());
+        std::remove(catalog::previous_path(disk).c_str());
+    }
+
+    auto make_sequence = [](uint64_t offset) {
+        catalog::sequence seq;
+        seq.block_size = block_size;
+        seq.blocks = { catalog::location(0, offset), catalog::location(1, offset) };
+        return seq;
+    };
+
+    catalog cat;
+    cat.put("a", make_sequence(0));
+    cat.save(disks);
+    cat.save(disks);
+
+    // the current superblock of the second disk cannot be moved aside
+    const std::string blocker = catalog::previous_path(disks[1]);
+    die_unequal(::mkdir(blocker.c_str(), 0700), 0);
+
+    cat.put("b", make_sequence(block_size));
+    die_unless_throws(cat.save(disks), foxxll::io_error);
+    die_unless_throws(cat.save(disks), foxxll::io_error);
+    die_unequal(::rmdir(blocker.c_str()), 0);
+
+    // crash now: the last complete generation is found on both disks
+    {
+        catalog other;
+        other.load(disks);
+        die_unequal(other.names().size(), 1u);
+    }
+
+    // saving again succeeds with a new generation
+    cat.save(disks);
+    {
+        catalog other;
+        std::vector<std::vector<catalog::extent> > extents = other.load(disks);
+        die_unequal(other.names().size(), 2u);
+        die_unequal(extents[0].size(), 1u);
+        die_unequal(extents[0][0].second, 2 * block_size);
+    }
+
+    for (const std::string& disk : disks) {
+        std::remove(catalog::superblock_path(disk).c_str());
+        std::remove(catalog::previous_path(disk).c_str());
+    }
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG1 << "Usage: " << argv[0] << " tempfile [store]";
+        return -1;
+    }
+
+    const std::string path = argv[1];
+
+    if (argc >= 3 && std::string(argv[2]) == "store")
+        return store(path);
+
+#if !FOXXLL_WINDOWS
+    test_failed_save(path);
+#endif
+
+    const std::string superblock = foxxll::block_catalog::superblock_path(path);
+    const std::string previous = foxxll::block_catalog::previous_path(path);
+    std::remove(path.c_str());
+    std::remove(superblock.c_str());
+    std::remove(previous.c_str());
+
+    const std::string cmd =
+        std::string("\"") + argv[0] + "\" \"" + path + "\" store";
+    die_unequal(std::system(cmd.c_str()), 0);
+
+    // a crash while saving after moving the current superblock aside: the
+    // previous superblock is used and becomes the current one again
+    die_unequal(std::rename(superblock.c_str(), previous.c_str()), 0);
+
+    reattach(path);
+    die_unless(std::ifstream(superblock.c_str()).good());
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -15,8 +15,11 @@
 //! This is an example of use of completion handlers, \c foxxll::block_manager, and
 //! \c foxxll::typed_block
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <tlx/die.hpp>
@@ -47,6 +50,54 @@ template class foxxll::typed_block<block_size, MyType>; // forced instantiation
 
 using block_type = foxxll::typed_block<block_size, MyType>;
 
+//! allocate and free single blocks from many threads, served by magazines
+void test_magazines()
+{
+    constexpr size_t num_threads = 8;
+    constexpr size_t num_rounds = 1000;
+    using small_bid = foxxll::BID<64 * 1024>;
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    const uint64_t allocation = bm->current_allocation();
+
+    std::vector<std::vector<small_bid> > kept(num_threads);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&kept, bm, t]() {
+                for (size_t r = 0; r < num_rounds; ++r) {
+                    small_bid bid;
+                    bm->new_block(foxxll::striping(), bid, r);
+                    if (r % 3 == 0)
+                        kept[t].push_back(bid);
+                    else
+                        bm->delete_block(bid);
+                }
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    // all kept blocks must be distinct
+    std::vector<std::pair<foxxll::file*, uint64_t> > all;
+    for (const auto& list : kept) {
+        for (const small_bid& bid : list)
+            all.emplace_back(bid.storage, bid.offset);
+    }
+    std::sort(all.begin(), all.end());
+    die_unless(std::adjacent_find(all.begin(), all.end()) == all.end());
+
+    die_unequal(bm->current_allocation(),
+                allocation + all.size() * small_bid::size);
+
+    for (const auto& list : kept)
+        bm->delete_blocks(list.begin(), list.end());
+
+    die_unequal(bm->current_allocation(), allocation);
+}
+
 int main()
 {
     LOG1 << sizeof(MyType) << " " << (block_size % sizeof(MyType));
@@ -98,7 +149,25 @@ int main()
         }
     }
 
+    // copy blocks to newly allocated ones without passing through memory
+    foxxll::BIDArray<block_size> copy_bids(nblocks);
+    bm->new_blocks(foxxll::striping(), copy_bids.begin(), copy_bids.end());
+
+    std::vector<foxxll::request_ptr> copy_reqs =
+        bm->copy_blocks(bids.begin(), bids.end(), copy_bids.begin());
+    wait_all(copy_reqs.begin(), copy_reqs.end());
+
+    for (size_t i = 0; i < nblocks; ++i)
+    {
+        block[i].read(copy_bids[i])->wait();
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal(i + j, block[i].elem[j].integer);
+    }
+
+    bm->delete_blocks(copy_bids.begin(), copy_bids.end());
     bm->delete_blocks(bids.begin(), bids.end());
+
+    test_magazines();
 }
 
 /**************************************************************************/
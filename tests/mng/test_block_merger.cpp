@@ -0,0 +1,128 @@
+/***************************************************************************
+ *  tests/mng/test_block_merger.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_merger.hpp>
+#include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_ostream.hpp>
+
+constexpr size_t block_size = 16 * 1024;
+
+using value_type = uint64_t;
+using block_type = foxxll::typed_block<block_size, value_type>;
+using bid_type = block_type::bid_type;
+using bid_iterator_type = std::vector<bid_type>::iterator;
+using merger_type = foxxll::block_merger<block_type>;
+
+// forced instantiation
+template class foxxll::block_merger<block_type>;
+
+constexpr value_type padding = std::numeric_limits<value_type>::max();
+
+//! write a sorted run and record the first element of each block
+merger_type::run_type write_run(const std::vector<value_type>& values)
+{
+    const size_t nblocks = (values.size() + block_type::size - 1) / block_type::size;
+    std::vector<bid_type> bids(nblocks);
+    foxxll::block_manager::get_instance()->new_blocks(
+        foxxll::striping(), bids.begin(), bids.end());
+
+    {
+        foxxll::buf_ostream<block_type, bid_iterator_type> out(bids.begin(), 4);
+        for (const value_type& v : values)
+            out << v;
+        out.fill(padding);
+    }
+
+    merger_type::run_type run;
+    run.size = values.size();
+    for (size_t i = 0; i < nblocks; ++i)
+        run.blocks.push_back({ bids[i], values[i * block_type::size] });
+    return run;
+}
+
+int main()
+{
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    std::default_random_engine rng(42);
+
+    // runs of different lengths with many equal elements, one of them empty
+    const size_t nruns = 7;
+    std::vector<merger_type::run_type> runs;
+    std::vector<value_type> all;
+    for (size_t r = 0; r < nruns; ++r)
+    {
+        const size_t size = r == 3 ? 0 : rng() % (40 * block_type::size);
+        std::vector<value_type> values(size);
+        for (value_type& v : values)
+            v = rng() % 100000;
+        std::sort(values.begin(), values.end());
+
+        runs.push_back(write_run(values));
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    const size_t nblocks = (all.size() + block_type::size - 1) / block_type::size;
+    std::vector<bid_type> out_bids(nblocks);
+    bm->new_blocks(foxxll::striping(), out_bids.begin(), out_bids.end());
+
+    {
+        merger_type merger(runs, nruns + 8);
+        die_unequal(merger.size(), all.size());
+
+        // a few elements into memory, the rest through an output stream
+        std::vector<value_type> head(1000);
+        die_unless(merger.merge(head.begin(), head.end()) == head.end());
+        die_unless(std::equal(head.begin(), head.end(), all.begin()));
+
+        foxxll::buf_ostream<block_type, bid_iterator_type> out(out_bids.begin(), 4);
+        for (const value_type& v : head)
+            out << v;
+        merger.merge(out);
+        die_unless(merger.empty());
+        out.fill(padding);
+    }
+
+    {
+        foxxll::buf_istream<block_type, bid_iterator_type> in(
+            out_bids.begin(), out_bids.end(), 4);
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            value_type v;
+            in >> v;
+            die_unequal(v, all[i]);
+        }
+    }
+
+    for (merger_type::run_type& run : runs)
+    {
+        for (merger_type::trigger_entry& t : run.blocks)
+            bm->delete_block(t.bid);
+    }
+    bm->delete_blocks(out_bids.begin(), out_bids.end());
+
+    LOG1 << "block_merger: merged " << all.size() << " elements of "
+         << nruns << " runs";
+
+    return 0;
+}
+
+/**************************************************************************/
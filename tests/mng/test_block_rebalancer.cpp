@@ -0,0 +1,162 @@
+/***************************************************************************
+ *  tests/mng/test_block_rebalancer.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_rebalancer.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_disks = 3;
+constexpr size_t num_blocks = 60;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = foxxll::BID<block_size>;
+
+std::vector<size_t> count_disks(const std::vector<bid_type>& bids)
+{
+    std::vector<size_t> count(num_disks, 0);
+    for (const bid_type& bid : bids)
+        ++count[bid.storage->get_allocator_id()];
+    return count;
+}
+
+void check_contents(const std::vector<bid_type>& bids)
+{
+    block_type block;
+    for (size_t i = 0; i < bids.size(); ++i) {
+        block.read(bids[i])->wait();
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal(block[j], i * block_type::size + j);
+    }
+}
+
+void test_plan()
+{
+    // all blocks on disk 0, disk 2 is full
+    std::vector<int> disks(9, 0);
+    foxxll::rebalance_registration::move_list moves =
+        foxxll::block_rebalancer::plan_moves(disks, { 100, 100, 0 }, 100);
+    die_unequal(moves.size(), 4u);
+    for (const auto& m : moves)
+        die_unequal(m.second, 1u);
+
+    // disk 1 has room for a single block only
+    moves = foxxll::block_rebalancer::plan_moves(disks, { 100, 1, 100 }, 100);
+    std::vector<size_t> received(3, 0);
+    for (const auto& m : moves)
+        ++received[m.second];
+    die_unequal(received[1], 1u);
+    die_unequal(received[2], 3u);
+
+    // balanced sequences stay untouched
+    disks = { 0, 1, 2, 0, 1, 2, 0, 1 };
+    die_unless(
+        foxxll::block_rebalancer::plan_moves(
+            disks, { 100, 100, 100 }, 100).empty());
+}
+
+int main()
+{
+    foxxll::config* config = foxxll::config::get_instance();
+    for (size_t d = 0; d < num_disks; ++d) {
+        config->add_disk(
+            foxxll::disk_config("/tmp/foxxll-rebalance-" + std::to_string(d),
+                                16 * 1024 * 1024, "memory"));
+    }
+
+    test_plan();
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    // allocate everything on a single disk and fill it
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::single_disk(0), bids.begin(), bids.end());
+
+    {
+        block_type block;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            for (size_t j = 0; j < block_type::size; ++j)
+                block[j] = i * block_type::size + j;
+            block.write(bids[i])->wait();
+        }
+    }
+
+    die_unequal(count_disks(bids)[0], num_blocks);
+
+    // synchronous rebalancing
+    foxxll::block_rebalancer rebalancer(0, 8);
+    foxxll::block_rebalancer::registration_ptr reg =
+        rebalancer.register_bids(bids.begin(), bids.end());
+
+    while (rebalancer.rebalance_once() != 0) { }
+
+    for (size_t count : count_disks(bids))
+        die_unequal(count, num_blocks / num_disks);
+
+    die_unequal(rebalancer.migrated_blocks(),
+                num_blocks - num_blocks / num_disks);
+    die_unequal(rebalancer.migrated_bytes(),
+                rebalancer.migrated_blocks() * block_size);
+
+    check_contents(bids);
+
+    // background rebalancing of a second sequence
+    std::vector<bid_type> bids2(num_blocks);
+    bm->new_blocks(foxxll::single_disk(1), bids2.begin(), bids2.end());
+    {
+        block_type block;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            for (size_t j = 0; j < block_type::size; ++j)
+                block[j] = i * block_type::size + j;
+            block.write(bids2[i])->wait();
+        }
+    }
+
+    foxxll::block_rebalancer::registration_ptr reg2 =
+        rebalancer.register_bids(bids2.begin(), bids2.end());
+    rebalancer.start();
+
+    for (size_t round = 0; round < 1000; ++round) {
+        {
+            auto lock = reg2->lock();
+            if (count_disks(bids2)[1] == num_blocks / num_disks)
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    rebalancer.stop();
+    rebalancer.unregister(reg2);
+    rebalancer.unregister(reg);
+
+    for (size_t count : count_disks(bids2))
+        die_unequal(count, num_blocks / num_disks);
+
+    check_contents(bids2);
+
+    bm->delete_blocks(bids.begin(), bids.end());
+    bm->delete_blocks(bids2.begin(), bids2.end());
+
+    LOG1 << "Migrated " << rebalancer.migrated_blocks() << " blocks";
+
+    return 0;
+}
+
+/**************************************************************************/
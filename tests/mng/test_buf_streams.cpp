@@ -13,7 +13,9 @@
 //! \example mng/test_buf_streams.cpp
 //! This is an example of use of \c foxxll::buf_istream and \c foxxll::buf_ostream
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include <foxxll/mng.hpp>
 #include <foxxll/mng/buf_istream.hpp>
@@ -78,6 +80,66 @@ int main()
             die_unless(prevalue == value);
         }
     }
+
+    // span interface: write in chunks not aligned to blocks, one whole block
+    // is handed over directly
+    {
+        buf_ostream_type out(bids.begin(), 2);
+        block_type* own = new block_type;
+        foxxll::request_ptr req;
+        unsigned i = 0;
+        while (i < nelements)
+        {
+            if (i == 5 * block_type::size)
+            {
+                for (unsigned j = 0; j < block_type::size; ++j)
+                    (*own)[j] = ~(i + j);
+                req = out.write_block(*own);
+                i += block_type::size;
+                continue;
+            }
+            std::pair<block_type::iterator, block_type::iterator> span =
+                out.next_span();
+            die_unless(span.first != span.second);
+            const size_t n = std::min<size_t>(span.second - span.first, 1000);
+            for (size_t j = 0; j < n; ++j)
+                span.first[j] = ~(i + static_cast<unsigned>(j));
+            out.commit(n);
+            i += static_cast<unsigned>(n);
+        }
+        req->wait();
+        delete own;
+    }
+    {
+        buf_istream_type in(bids.begin(), bids.end(), 2);
+        unsigned i = 0;
+        while (i < nelements)
+        {
+            std::pair<block_type::iterator, block_type::iterator> span =
+                in.next_span();
+            const size_t n = std::min<size_t>(span.second - span.first, 777);
+            for (size_t j = 0; j < n; ++j)
+                die_unequal(span.first[j], ~(i + static_cast<unsigned>(j)));
+            in.consume(n);
+            i += static_cast<unsigned>(n);
+        }
+    }
+    {
+        buf_istream_reverse_type in(bids.begin(), bids.end(), 2);
+        unsigned i = nelements;
+        while (i > 0)
+        {
+            std::pair<block_type::iterator, block_type::iterator> span =
+                in.next_span();
+            const size_t n = std::min<size_t>(span.second - span.first, 777);
+            for (size_t j = 1; j <= n; ++j)
+                die_unequal(span.second[-static_cast<ptrdiff_t>(j)],
+                            ~(i - static_cast<unsigned>(j)));
+            in.consume(n);
+            i -= static_cast<unsigned>(n);
+        }
+    }
+
     bm->delete_blocks(bids.begin(), bids.end());
 
     return 0;
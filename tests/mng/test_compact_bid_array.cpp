@@ -0,0 +1,115 @@
+/***************************************************************************
+ *  tests/mng/test_compact_bid_array.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/buf_istream.hpp>
+#include <foxxll/mng/buf_ostream.hpp>
+#include <foxxll/mng/compact_bid_array.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_disks = 3;
+constexpr size_t num_blocks = 300;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = foxxll::BID<block_size>;
+using bid_array_type = foxxll::compact_bid_array<block_size>;
+
+void test_encoding()
+{
+    foxxll::file* f1 = reinterpret_cast<foxxll::file*>(0x1000);
+    foxxll::file* f2 = reinterpret_cast<foxxll::file*>(0x2000);
+
+    std::vector<bid_type> plain;
+    // contiguous extent
+    for (size_t i = 0; i < 10; ++i)
+        plain.emplace_back(f1, i * block_size);
+    // two stripes
+    for (size_t i = 0; i < 10; ++i)
+        plain.emplace_back((i % 2) ? f2 : f1, (100 + i / 2) * block_size);
+    // scattered blocks
+    for (size_t i = 0; i < 5; ++i)
+        plain.emplace_back(f2, (1000 - 7 * i) * block_size);
+
+    bid_array_type compact;
+    for (const bid_type& bid : plain)
+        compact.push_back(bid);
+
+    die_unequal(compact.size(), plain.size());
+    die_unequal(compact.num_runs(), 3u);
+
+    for (size_t i = 0; i < plain.size(); ++i)
+        die_unless(compact[i] == plain[i]);
+
+    size_t i = 0;
+    for (bid_array_type::const_iterator it = compact.begin();
+         it != compact.end(); ++it, ++i)
+    {
+        die_unless(*it == plain[i]);
+        die_unequal(it->offset, plain[i].offset);
+    }
+    die_unequal(compact.end() - compact.begin(),
+                static_cast<std::ptrdiff_t>(plain.size()));
+}
+
+int main()
+{
+    foxxll::config* config = foxxll::config::get_instance();
+    for (size_t d = 0; d < num_disks; ++d) {
+        config->add_disk(
+            foxxll::disk_config("/tmp/foxxll-compact-bid-" + std::to_string(d),
+                                64 * 1024 * 1024, "memory"));
+    }
+
+    test_encoding();
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    // striped allocation compresses to a single run
+    bid_array_type bids;
+    bm->new_blocks(foxxll::striping(), bids, num_blocks);
+    die_unequal(bids.size(), num_blocks);
+    LOG1 << "allocated " << bids.size() << " blocks in " << bids.num_runs()
+         << " runs using " << bids.memory_usage() << " bytes";
+    die_unless(bids.num_runs() <= num_disks);
+
+    {
+        foxxll::buf_ostream<block_type, bid_array_type::const_iterator> out(
+            bids.begin(), 2 * num_disks);
+        for (size_t i = 0; i < num_blocks * block_type::size; ++i)
+            out << i;
+    }
+
+    {
+        foxxll::buf_istream<block_type, bid_array_type::const_iterator> in(
+            bids.begin(), bids.end(), 2 * num_disks);
+        for (size_t i = 0; i < num_blocks * block_type::size; ++i) {
+            size_t value;
+            in >> value;
+            die_unequal(value, i);
+        }
+    }
+
+    bm->delete_blocks(bids);
+    die_unless(bids.empty());
+    die_unequal(bm->current_allocation(), 0u);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,125 @@
+/***************************************************************************
+ *  tests/mng/test_concurrent_prefetch_pool.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/concurrent_prefetch_pool.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_blocks = 256;
+constexpr size_t num_threads = 8;
+constexpr size_t read_ahead = 4;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = block_type::bid_type;
+using pool_type = foxxll::concurrent_prefetch_pool<block_type>;
+
+// forced instantiation
+template class foxxll::concurrent_prefetch_pool<block_type>;
+
+void check_block(block_type& block, size_t i)
+{
+    for (size_t j = 0; j < block_type::size; ++j)
+        die_unequal(block[j], i * block_type::size + j);
+}
+
+void test_single(pool_type& pool, const std::vector<bid_type>& bids)
+{
+    die_unequal(pool.size(), 2u);
+
+    die_unless(pool.hint(bids[0]));
+    die_unless(pool.hint(bids[0]));
+    die_unless(pool.hint(bids[1]));
+    die_unless(!pool.hint(bids[2]));
+    die_unequal(pool.busy_size(), 2u);
+    die_unless(pool.in_prefetching(bids[1]));
+
+    die_unless(pool.invalidate(bids[1]));
+    die_unless(!pool.invalidate(bids[1]));
+    die_unequal(pool.free_size(), 1u);
+
+    block_type* block = new block_type;
+    pool.read(block, bids[0])->wait();
+    check_block(*block, 0);
+    pool.read(block, bids[2])->wait();
+    check_block(*block, 2);
+    delete block;
+
+    die_unequal(pool.busy_size(), 0u);
+    die_unequal(pool.free_size(), 2u);
+}
+
+int main()
+{
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    {
+        block_type* block = new block_type;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            for (size_t j = 0; j < block_type::size; ++j)
+                (*block)[j] = i * block_type::size + j;
+            block->write(bids[i])->wait();
+        }
+        delete block;
+    }
+
+    {
+        pool_type pool(2, 4);
+        test_single(pool, bids);
+    }
+
+    // consumers scan interleaved parts, sharing less buffers than they hint
+    pool_type pool(num_threads * read_ahead / 2);
+    pool.resize(num_threads * read_ahead);
+    pool.resize(num_threads * read_ahead / 2);
+    die_unequal(pool.size(), num_threads * read_ahead / 2);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&pool, &bids, t]() {
+                block_type* block = new block_type;
+                for (size_t i = t; i < num_blocks; i += num_threads)
+                {
+                    for (size_t k = 1; k <= read_ahead; ++k) {
+                        const size_t ahead = i + k * num_threads;
+                        if (ahead < num_blocks)
+                            pool.hint(bids[ahead]);
+                    }
+                    pool.read(block, bids[i])->wait();
+                    check_block(*block, i);
+                }
+                delete block;
+            });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    die_unequal(pool.busy_size(), 0u);
+    die_unequal(pool.free_size(), num_threads * read_ahead / 2);
+
+    bm->delete_blocks(bids.begin(), bids.end());
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -36,6 +36,35 @@ void test1()
     die_unequal(cfg.queue, 5);
     die_unequal(cfg.direct, foxxll::disk_config::DIRECT_ON);
 
+    cfg.parse_line("flash=/var/tmp/foxxll.tmp, 1 GiB, syscall bandwidth=2GiB");
+
+    die_unequal(cfg.bandwidth, 2 * 1024 * 1024 * uint64_t(1024));
+    die_unequal(cfg.fileio_string(), "syscall bandwidth=2147483648 flash");
+
+    // generated configuration lines, e.g. by foxxll_tool calibrate, parse
+    // back to the same disk
+
+    foxxll::disk_config tuned("/var/tmp/foxxll.tmp", 1000 * 1024 * uint64_t(1024),
+                              "syscall direct=on");
+    tuned.flash = true;
+    tuned.bandwidth = 500 * 1024 * 1024;
+    tuned.autogrow_chunk = 3 * 1024 * 1024;
+    die_unequal(tuned.config_line(),
+                "flash=/var/tmp/foxxll.tmp,1000MiB,syscall autogrow_chunk=3MiB "
+                "bandwidth=524288000 direct=on flash");
+
+    cfg.parse_line(tuned.config_line());
+    die_unequal(cfg.path, tuned.path);
+    die_unequal(cfg.size, tuned.size);
+    die_unequal(cfg.flash, true);
+    die_unequal(cfg.fileio_string(), tuned.fileio_string());
+
+    tuned.flash = false;
+    tuned.size = 4096 + 1;
+    cfg.parse_line(tuned.config_line());
+    die_unequal(cfg.size, 4097u);
+    die_unequal(cfg.flash, false);
+
     // bad configurations
 
     die_unless_throws(
@@ -0,0 +1,80 @@
+/***************************************************************************
+ *  tests/mng/test_device_topology.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <string>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/io/device_topology.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG1 << "Usage: " << argv[0] << " tempfile";
+        return -1;
+    }
+
+    const std::string path = argv[1];
+
+    // paths which do not exist resolve to their nearest existing directory
+    foxxll::device_topology missing =
+        foxxll::device_topology::discover(path + ".missing/a/b");
+    foxxll::device_topology existing = foxxll::device_topology::discover(path);
+    die_unequal(missing.id, existing.id);
+
+    LOG1 << path << ": device '" << existing.name << "' (" << existing.id
+         << ") rotational=" << existing.rotational
+         << " queue_depth=" << existing.queue_depth
+         << " optimal_io_size=" << existing.optimal_io_size
+         << " physical_block_size=" << existing.physical_block_size;
+
+    // two files in the same directory, and a memory disk
+    foxxll::config* config = foxxll::config::get_instance();
+    config->add_disk(foxxll::disk_config(
+                         path + "0", 4 * 1024 * 1024, "syscall delete_on_exit"));
+    config->add_disk(foxxll::disk_config(
+                         path + "1", 4 * 1024 * 1024, "syscall delete_on_exit"));
+    config->add_disk(foxxll::disk_config(path + "2", 4 * 1024 * 1024, "memory"));
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    die_unless(!bm->disk_device(2).known());
+    die_unless(bm->disk_file(2)->get_queue_id() != bm->disk_file(0)->get_queue_id());
+
+    if (bm->disk_device(0).known())
+    {
+        die_unless(bm->disk_device(0).same_device(bm->disk_device(1)));
+        die_unequal(bm->disk_file(0)->get_queue_id(),
+                    bm->disk_file(1)->get_queue_id());
+        die_unequal(bm->disk_file(0)->get_device_id(),
+                    bm->disk_file(1)->get_device_id());
+    }
+    else
+    {
+        die_unless(bm->disk_file(0)->get_queue_id() !=
+                   bm->disk_file(1)->get_queue_id());
+    }
+
+    // the load-aware strategy splits a shared device among its disks
+    foxxll::load_aware strategy;
+    if (bm->disk_device(0).known())
+        die_unless(strategy.weight(0) < strategy.weight(2));
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,165 @@
+/***************************************************************************
+ *  tests/mng/test_disk_block_allocator.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/disk_block_allocator.hpp>
+
+constexpr size_t block_size = 256 * 1024;
+using bid_type = foxxll::BID<block_size>;
+
+void test_autogrow(const char* io_impl, const char* path)
+{
+    foxxll::disk_config cfg(path, 0, io_impl);
+    cfg.autogrow_chunk = 1024 * 1024;
+    die_unequal(cfg.fileio_string(),
+                std::string(io_impl) + " autogrow_chunk=1MiB");
+
+    // the formatted parameters parse back to the same values
+    for (foxxll::external_size_type chunk : { 1024 * 1024u, 3 * 1024u + 1 })
+    {
+        foxxll::disk_config orig(path, 0, io_impl);
+        orig.autogrow_chunk = chunk;
+        foxxll::disk_config parsed(path, 0, orig.fileio_string());
+        die_unequal(parsed.autogrow_chunk, orig.autogrow_chunk);
+        die_unequal(parsed.fileio_string(), orig.fileio_string());
+    }
+
+    foxxll::file_ptr file = foxxll::create_file(
+            cfg, foxxll::file::CREAT | foxxll::file::RDWR, 0);
+
+    {
+        foxxll::disk_block_allocator alloc(file.get(), cfg);
+        die_unequal(alloc.total_bytes(), 0u);
+
+        // the first allocation grows synchronously by at least one chunk
+        std::vector<bid_type> bids(1);
+        alloc.new_blocks(bids.begin(), bids.end());
+        die_unequal(alloc.total_bytes(), 1024 * 1024u);
+        die_unequal(alloc.used_bytes(), block_size);
+        die_unless(file->size() >= alloc.total_bytes());
+
+        // allocate many blocks, the file grows geometrically
+        std::vector<bid_type> more(200);
+        for (size_t i = 0; i < more.size(); ++i)
+            alloc.new_blocks(more.begin() + i, more.begin() + i + 1);
+
+        die_unequal(alloc.used_bytes(), 201 * block_size);
+        die_unless(alloc.total_bytes() >= 201 * block_size);
+        die_unless(file->size() >= alloc.total_bytes());
+
+        // blocks must not overlap
+        std::vector<uint64_t> offsets;
+        offsets.push_back(bids[0].offset);
+        for (const bid_type& bid : more)
+            offsets.push_back(bid.offset);
+        std::sort(offsets.begin(), offsets.end());
+        for (size_t i = 1; i < offsets.size(); ++i)
+            die_unless(offsets[i - 1] + block_size <= offsets[i]);
+
+        for (const bid_type& bid : more)
+            alloc.delete_block(bid);
+        alloc.delete_block(bids[0]);
+
+        die_unequal(alloc.used_bytes(), 0u);
+        LOG1 << io_impl << ": grew to " << alloc.total_bytes() << " bytes";
+    }
+
+    // the destructor shrinks the file back to the configured size
+    die_unequal(file->size(), 0u);
+    file->close_remove();
+}
+
+void test_size_classes(const char* path)
+{
+    foxxll::disk_config cfg(path, 8 * 1024 * 1024, "memory alloc=sizeclass");
+    cfg.autogrow = false;
+    die_unless(cfg.size_classes);
+    die_unequal(cfg.fileio_string(), "memory autogrow=no alloc=sizeclass");
+
+    foxxll::file_ptr file = foxxll::create_file(
+            cfg, foxxll::file::CREAT | foxxll::file::RDWR, 0);
+
+    foxxll::disk_block_allocator alloc(file.get(), cfg);
+    const size_t num_blocks = cfg.size / block_size;
+
+    // fill the disk block by block
+    std::vector<bid_type> bids(num_blocks);
+    for (size_t i = 0; i < num_blocks; ++i)
+        alloc.new_blocks(bids.begin() + i, bids.begin() + i + 1);
+    die_unequal(alloc.free_bytes(), 0u);
+
+    std::vector<uint64_t> offsets;
+    for (const bid_type& bid : bids)
+        offsets.push_back(bid.offset);
+    std::sort(offsets.begin(), offsets.end());
+    for (size_t i = 0; i < num_blocks; ++i)
+        die_unequal(offsets[i], i * block_size);
+
+    die_unless_throws(
+        alloc.new_blocks(bids.begin(), bids.begin() + 1),
+        foxxll::bad_ext_alloc);
+
+    // freed blocks are reused immediately
+    alloc.delete_block(bids[5]);
+    die_unequal(alloc.free_bytes(), block_size);
+    bid_type bid;
+    alloc.new_blocks(&bid, &bid + 1);
+    die_unequal(bid.offset, bids[5].offset);
+    bids[5] = bid;
+
+    // deleting a block twice is detected
+    alloc.delete_block(bids[5]);
+    die_unless_throws(alloc.delete_block(bids[5]), foxxll::bad_ext_alloc);
+    die_unequal(alloc.free_bytes(), block_size);
+    alloc.new_blocks(&bid, &bid + 1);
+    die_unequal(bid.offset, bids[5].offset);
+
+    for (const bid_type& b : bids)
+        alloc.delete_block(b);
+    die_unequal(alloc.free_bytes(), cfg.size);
+
+    // a request of another size reclaims the free lists
+    std::vector<foxxll::BID<2* block_size> > big(num_blocks / 2);
+    alloc.new_blocks(big.begin(), big.end());
+    die_unequal(alloc.free_bytes(), 0u);
+    for (size_t i = 0; i < big.size(); ++i)
+        die_unequal(big[i].offset, i * 2 * block_size);
+
+    for (const auto& b : big)
+        alloc.delete_block(b);
+    die_unequal(alloc.free_bytes(), cfg.size);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        LOG1 << "Usage: " << argv[0] << " tempfile";
+        return -1;
+    }
+
+    test_autogrow("memory", argv[1]);
+    test_autogrow("syscall", argv[1]);
+    test_size_classes(argv[1]);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,137 @@
+/***************************************************************************
+ *  tests/mng/test_disk_hotplug.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/block_alloc_strategy.hpp>
+#include <foxxll/mng/block_rebalancer.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_blocks = 30;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = foxxll::BID<block_size>;
+
+std::vector<size_t> count_disks(const std::vector<bid_type>& bids)
+{
+    std::vector<size_t> count(
+        foxxll::block_manager::get_instance()->disks_number(), 0);
+    for (const bid_type& bid : bids)
+        ++count[bid.storage->get_allocator_id()];
+    return count;
+}
+
+foxxll::disk_config memory_disk(size_t d)
+{
+    return foxxll::disk_config(
+        "/tmp/foxxll-hotplug-" + std::to_string(d), 16 * 1024 * 1024, "memory");
+}
+
+int main()
+{
+    foxxll::config* config = foxxll::config::get_instance();
+    config->add_disk(memory_disk(0));
+    config->add_disk(memory_disk(1));
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    die_unequal(bm->disks_number(), 2u);
+
+    // a hot-added disk takes part in strategies constructed afterwards
+    die_unequal(bm->add_disk(memory_disk(2)), 2u);
+    die_unequal(bm->disks_number(), 3u);
+    die_unequal(config->disks_number(), 3u);
+    die_unequal(bm->total_bytes(2), 16u * 1024 * 1024);
+
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+    for (size_t count : count_disks(bids))
+        die_unequal(count, num_blocks / 3);
+
+    block_type* block = new block_type;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        for (size_t j = 0; j < block_type::size; ++j)
+            (*block)[j] = i * block_type::size + j;
+        block->write(bids[i])->wait();
+    }
+
+    // a draining disk gets no new blocks, neither in bulk nor single ones
+    bm->set_draining(0);
+    die_unless(bm->is_draining(0));
+    die_unless(!bm->has_available_space(0, block_size));
+
+    std::vector<bid_type> more(num_blocks);
+    bm->new_blocks(foxxll::striping(), more.begin(), more.end());
+    die_unequal(count_disks(more)[0], 0u);
+
+    for (size_t i = 0; i < 4; ++i) {
+        bid_type bid;
+        bm->new_block(foxxll::single_disk(0), bid);
+        die_unless(bid.storage->get_allocator_id() != 0);
+        bm->delete_block(bid);
+    }
+
+    foxxll::load_aware strategy;
+    die_unequal(strategy.weight(0), 0.0);
+
+    // the rebalancer evacuates the draining disk
+    foxxll::block_rebalancer rebalancer(0, 4);
+    foxxll::block_rebalancer::registration_ptr reg =
+        rebalancer.register_bids(bids.begin(), bids.end());
+
+    while (rebalancer.rebalance_once() != 0) { }
+    rebalancer.unregister(reg);
+
+    std::vector<size_t> count = count_disks(bids);
+    die_unequal(count[0], 0u);
+    die_unequal(count[1] + count[2], num_blocks);
+    die_unequal(rebalancer.migrated_blocks(), num_blocks / 3);
+
+    for (size_t i = 0; i < num_blocks; ++i) {
+        block->read(bids[i])->wait();
+        for (size_t j = 0; j < block_type::size; ++j)
+            die_unequal((*block)[j], i * block_type::size + j);
+    }
+    delete block;
+
+    // the evacuated disk is empty and may be used again
+    bm->delete_blocks(more.begin(), more.end());
+    bm->delete_blocks(bids.begin(), bids.end());
+    die_unequal(bm->current_allocation(), 0u);
+    die_unequal(bm->free_bytes(0), bm->total_bytes(0));
+
+    bm->set_draining(0, false);
+    bm->new_blocks(foxxll::striping(), more.begin(), more.end());
+    die_unequal(count_disks(more)[0], num_blocks / 3);
+    bm->delete_blocks(more.begin(), more.end());
+
+    // flash devices stay after the regular disks; as disks are numbered by
+    // position, no regular disk can be added behind a flash device
+    foxxll::disk_config flash = memory_disk(3);
+    flash.flash = true;
+    die_unequal(bm->add_disk(flash), 3u);
+    die_unless(config->regular_disk_range() == std::make_pair(0u, 3u));
+    die_unless(config->flash_range() == std::make_pair(3u, 4u));
+    die_unless_throws(bm->add_disk(memory_disk(4)), std::invalid_argument);
+    die_unequal(bm->disks_number(), 4u);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *  tests/mng/test_extent_reservation.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/extent_reservation.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_disks = 2;
+constexpr size_t num_blocks = 40;
+
+using bid_type = foxxll::BID<block_size>;
+
+//! check that the blocks of a stream are consecutive on each disk
+void check_sequential(const std::vector<bid_type>& bids)
+{
+    for (size_t i = num_disks; i < bids.size(); ++i) {
+        die_unequal(bids[i].storage, bids[i - num_disks].storage);
+        die_unequal(bids[i].offset, bids[i - num_disks].offset + block_size);
+    }
+}
+
+int main()
+{
+    foxxll::config* config = foxxll::config::get_instance();
+    for (size_t d = 0; d < num_disks; ++d) {
+        config->add_disk(
+            foxxll::disk_config("/tmp/foxxll-extent-" + std::to_string(d),
+                                16 * 1024 * 1024, "memory autogrow=no"));
+    }
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    const uint64_t free_bytes = bm->free_bytes();
+    const uint64_t allocation = bm->current_allocation();
+
+    std::vector<bid_type> a(num_blocks), b(num_blocks);
+
+    {
+        foxxll::extent_reservation ra(2 * 1024 * 1024), rb(2 * 1024 * 1024);
+
+        // interleave the allocations of two streams
+        for (size_t i = 0; i < num_blocks; ++i) {
+            ra.new_block(foxxll::striping(), a[i], i);
+            rb.new_block(foxxll::striping(), b[i], i);
+        }
+
+        check_sequential(a);
+        check_sequential(b);
+
+        die_unequal(bm->current_allocation(),
+                    allocation + 2 * num_blocks * block_size);
+        die_unequal(ra.reserved_bytes(),
+                    num_disks * 2 * 1024 * 1024 - num_blocks * block_size);
+    }
+
+    // unused tails were returned
+    die_unequal(bm->free_bytes(), free_bytes - 2 * num_blocks * block_size);
+
+    bm->delete_blocks(a.begin(), a.end());
+    bm->delete_blocks(b.begin(), b.end());
+
+    die_unequal(bm->free_bytes(), free_bytes);
+    die_unequal(bm->current_allocation(), allocation);
+
+    // extents larger than the free space fall back to regular allocation
+    {
+        foxxll::extent_reservation huge(1024 * 1024 * 1024);
+        huge.new_blocks(foxxll::striping(), a.begin(), a.end());
+        die_unequal(huge.reserved_bytes(), 0u);
+    }
+    bm->delete_blocks(a.begin(), a.end());
+
+    die_unequal(bm->current_allocation(), allocation);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,200 @@
+/***************************************************************************
+ *  tests/mng/test_memory_budget.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/memory_budget.hpp>
+#include <foxxll/mng/prefetch_pool.hpp>
+#include <foxxll/mng/write_pool.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t budget_blocks = 8;
+constexpr size_t num_blocks = 32;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = block_type::bid_type;
+
+int main()
+{
+    foxxll::config::get_instance()->add_disk(
+        foxxll::disk_config("/tmp/foxxll-budget", 16 * 1024 * 1024, "memory"));
+
+    foxxll::memory_budget* budget = foxxll::memory_budget::get_instance();
+    LOG1 << "cgroup memory limit: " << foxxll::memory_budget::cgroup_limit();
+    budget->set_limit(budget_blocks * block_size);
+
+    std::vector<bid_type> bids(num_blocks);
+    foxxll::block_manager::get_instance()->new_blocks(
+        foxxll::striping(), bids.begin(), bids.end());
+
+    foxxll::memory_budget::account write_account("write_pool");
+    foxxll::memory_budget::account prefetch_account("prefetch_pool");
+
+    {
+        // without a limit nothing is borrowed: pools keep their size
+        budget->set_limit(0);
+        foxxll::prefetch_pool<block_type> p_pool(1, &prefetch_account);
+        die_unless(p_pool.hint(bids[0]));
+        die_unless(!p_pool.hint(bids[1]));
+        die_unequal(p_pool.size(), 1u);
+        die_unless(!write_account.try_borrow(block_size));
+        budget->set_limit(budget_blocks * block_size);
+    }
+    die_unequal(prefetch_account.used(), 0u);
+
+    {
+        // by default a pool borrows up to its initial size
+        foxxll::prefetch_pool<block_type> p_pool(1, &prefetch_account);
+        die_unless(p_pool.hint(bids[0]));
+        die_unless(p_pool.hint(bids[1]));
+        die_unless(!p_pool.hint(bids[2]));
+        die_unequal(prefetch_account.borrowed(), block_size);
+        die_unless(budget->used() < budget->limit());
+    }
+    die_unequal(prefetch_account.used(), 0u);
+
+    {
+        // the write pool grows only within the budget, all its blocks are
+        // charged
+        foxxll::write_pool<block_type> w_pool(1);
+        w_pool.set_budget(&write_account);
+        w_pool.set_max_borrowed(num_blocks);
+        die_unequal(write_account.used(), block_size);
+        for (size_t i = 0; i < num_blocks; ++i) {
+            block_type* block = w_pool.steal();
+            w_pool.write(block, bids[i]);
+            die_unless(budget->used() <= budget->limit());
+            die_unequal(w_pool.size(), write_account.used() / block_size);
+        }
+    }
+    die_unequal(write_account.used(), 0u);
+
+    {
+        // hints draw blocks from the budget until it is exhausted
+        foxxll::prefetch_pool<block_type> p_pool(0);
+        p_pool.set_budget(&prefetch_account);
+        p_pool.set_max_borrowed(num_blocks);
+        for (size_t i = 0; i < budget_blocks; ++i)
+            die_unless(p_pool.hint(bids[i]));
+        die_unless(!p_pool.hint(bids[budget_blocks]));
+        die_unequal(prefetch_account.used(), budget_blocks * block_size);
+
+        // a failed hint neither waits nor asks for memory
+        die_unequal(prefetch_account.waits(), 0u);
+
+        // another component asks for memory, the pool gives it back when
+        // its blocks are consumed
+        die_unless(!write_account.try_borrow(2 * block_size));
+        die_unequal(prefetch_account.reclaim_requested(), 2 * block_size);
+
+        block_type* block = new block_type;
+        p_pool.read(block, bids[0])->wait();
+        p_pool.read(block, bids[1])->wait();
+        delete block;
+
+        die_unequal(prefetch_account.reclaim_requested(), 0u);
+        die_unequal(p_pool.size(), budget_blocks - 2);
+        die_unless(write_account.try_borrow(2 * block_size));
+        write_account.release_borrowed(2 * block_size);
+    }
+    die_unequal(prefetch_account.used(), 0u);
+    die_unequal(prefetch_account.peak(), budget_blocks * block_size);
+
+    {
+        // a pool that borrowed on the waiting thread cannot be used while it
+        // waits, so acquire() makes it give back its free blocks at once
+        foxxll::prefetch_pool<block_type> p_pool(0, &prefetch_account);
+        p_pool.set_max_borrowed(num_blocks);
+        for (size_t i = 0; i < budget_blocks; ++i)
+            die_unless(p_pool.hint(bids[i]));
+
+        block_type* block = new block_type;
+        p_pool.read(block, bids[0])->wait();
+        p_pool.read(block, bids[1])->wait();
+        delete block;
+
+        write_account.acquire(2 * block_size);
+        die_unequal(write_account.used(), 2 * block_size);
+        die_unequal(p_pool.size(), budget_blocks - 2);
+
+        // its blocks in reading cannot be given back
+        die_unless_throws(write_account.acquire(block_size),
+                          foxxll::resource_error);
+        write_account.release(2 * block_size);
+    }
+    die_unequal(prefetch_account.used(), 0u);
+
+    {
+        // shrinking the pool waits for writes instead of borrowing blocks
+        foxxll::write_pool<block_type> w_pool(2, &write_account);
+        block_type* block = w_pool.steal();
+        w_pool.write(block, bids[0]);
+        block = w_pool.steal();
+        w_pool.write(block, bids[1]);
+        w_pool.resize(1);
+        die_unequal(w_pool.size(), 1u);
+        die_unequal(write_account.used(), block_size);
+        die_unequal(write_account.borrowed(), 0u);
+    }
+    die_unequal(write_account.used(), 0u);
+
+    {
+        // the blocks of the pool itself are charged, too
+        foxxll::prefetch_pool<block_type> p_pool(2, &prefetch_account);
+        die_unequal(prefetch_account.used(), 2 * block_size);
+        p_pool.resize(4);
+        die_unequal(prefetch_account.used(), 4 * block_size);
+        p_pool.resize(1);
+        die_unequal(prefetch_account.used(), block_size);
+    }
+    die_unequal(prefetch_account.used(), 0u);
+
+    // acquire() fails if the memory cannot become free
+    die_unless_throws(write_account.acquire((budget_blocks + 1) * block_size),
+                      foxxll::bad_parameter);
+
+    prefetch_account.acquire(budget_blocks * block_size);
+    die_unless_throws(write_account.acquire(block_size),
+                      foxxll::resource_error);
+    prefetch_account.release(budget_blocks * block_size);
+
+    // acquire() blocks until borrowed memory is given back
+    die_unless(prefetch_account.try_borrow(budget_blocks * block_size));
+    std::thread waiter([&write_account]() {
+                           write_account.acquire(block_size);
+                       });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    die_unequal(write_account.used(), 0u);
+    die_unequal(prefetch_account.reclaim_requested(), block_size);
+
+    prefetch_account.release_borrowed(budget_blocks * block_size);
+    waiter.join();
+    die_unequal(write_account.used(), block_size);
+    write_account.release(block_size);
+
+    std::vector<foxxll::memory_budget::usage> report = budget->report();
+    die_unequal(report.size(), 2u);
+    for (const foxxll::memory_budget::usage& u : report)
+        LOG1 << u;
+
+    foxxll::block_manager::get_instance()->delete_blocks(bids.begin(), bids.end());
+
+    return 0;
+}
+
+/**************************************************************************/
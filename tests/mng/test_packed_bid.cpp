@@ -0,0 +1,110 @@
+/***************************************************************************
+ *  tests/mng/test_packed_bid.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/packed_bid.hpp>
+#include <foxxll/mng/prefetch_pool.hpp>
+#include <foxxll/mng/write_pool.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_disks = 2;
+constexpr size_t num_blocks = 32;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_type = foxxll::BID<block_size>;
+using packed_type = foxxll::packed_bid<block_size>;
+
+static_assert(sizeof(packed_type) == 8, "packed_bid must take 8 bytes");
+
+int main()
+{
+    foxxll::config* config = foxxll::config::get_instance();
+    for (size_t d = 0; d < num_disks; ++d) {
+        config->add_disk(
+            foxxll::disk_config("/tmp/foxxll-packed-bid-" + std::to_string(d),
+                                16 * 1024 * 1024, "memory"));
+    }
+
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+
+    std::vector<bid_type> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    // pack and unpack
+    std::vector<packed_type> packed;
+    for (const bid_type& bid : bids)
+        packed.emplace_back(bid);
+
+    for (size_t i = 0; i < num_blocks; ++i) {
+        die_unless(packed[i].valid());
+        die_unequal(packed[i].disk(),
+                    static_cast<size_t>(bids[i].storage->get_allocator_id()));
+        die_unequal(packed[i].offset(), bids[i].offset);
+        die_unless(packed[i].unpack() == bids[i]);
+    }
+
+    die_unless(!packed_type().valid());
+    die_unless(!packed_type(bid_type()).valid());
+
+    // self managed files cannot be packed
+    foxxll::file_ptr own = foxxll::create_file(
+            "memory", "/tmp/foxxll-packed-bid-own",
+            foxxll::file::CREAT | foxxll::file::RDWR);
+    die_unless_throws(packed_type(bid_type(own.get(), 0)),
+                      std::invalid_argument);
+
+    // write through write_pool, read through prefetch_pool
+    {
+        foxxll::write_pool<block_type> w_pool(4);
+        for (size_t i = 0; i < num_blocks; ++i) {
+            block_type* block = w_pool.steal();
+            for (size_t j = 0; j < block_type::size; ++j)
+                (*block)[j] = i * block_type::size + j;
+            w_pool.write(block, packed[i]);
+        }
+    }
+
+    {
+        foxxll::prefetch_pool<block_type> p_pool(4);
+        block_type* block = new block_type;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            if (i + 1 < num_blocks)
+                p_pool.hint(packed[i + 1]);
+            p_pool.read(block, packed[i])->wait();
+            for (size_t j = 0; j < block_type::size; ++j)
+                die_unequal((*block)[j], i * block_type::size + j);
+        }
+        delete block;
+    }
+
+    // typed_block I/O
+    {
+        block_type block;
+        block.read(packed[3])->wait();
+        die_unequal(block[0], 3 * block_type::size);
+    }
+
+    for (const packed_type& p : packed)
+        bm->delete_block(p.unpack());
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,123 @@
+/***************************************************************************
+ *  tests/mng/test_parallel_buf_istream.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/buf_ostream.hpp>
+#include <foxxll/mng/parallel_buf_istream.hpp>
+
+constexpr size_t block_size = 64 * 1024;
+constexpr size_t num_blocks = 256;
+constexpr size_t num_threads = 8;
+
+using block_type = foxxll::typed_block<block_size, size_t>;
+using bid_iterator_type = foxxll::BIDArray<block_size>::iterator;
+using stream_type = foxxll::parallel_buf_istream<block_type, bid_iterator_type>;
+
+// forced instantiation
+template class foxxll::parallel_buf_istream<block_type, bid_iterator_type>;
+
+//! scan with all threads, returns the indices pulled by each thread
+std::vector<std::vector<size_t> > scan(stream_type& in)
+{
+    std::vector<std::vector<size_t> > pulled(num_threads);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back(
+            [&in, &pulled, t]() {
+                block_type* block;
+                size_t index;
+                while (in.pull(block, index))
+                {
+                    for (size_t j = 0; j < block_type::size; ++j)
+                        die_unequal((*block)[j], index * block_type::size + j);
+                    pulled[t].push_back(index);
+                    in.release(block);
+                }
+            });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    return pulled;
+}
+
+//! every block was pulled exactly once
+void check_complete(const std::vector<std::vector<size_t> >& pulled)
+{
+    std::vector<size_t> all;
+    for (const std::vector<size_t>& p : pulled)
+        all.insert(all.end(), p.begin(), p.end());
+
+    std::sort(all.begin(), all.end());
+    die_unequal(all.size(), num_blocks);
+    for (size_t i = 0; i < num_blocks; ++i)
+        die_unequal(all[i], i);
+}
+
+int main()
+{
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    foxxll::BIDArray<block_size> bids(num_blocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+
+    {
+        foxxll::buf_ostream<block_type, bid_iterator_type> out(bids.begin(), 4);
+        for (size_t i = 0; i < num_blocks * block_type::size; ++i)
+            out << i;
+    }
+
+    // blocks are handed out as they are read
+    {
+        stream_type in(bids.begin(), bids.end(), 2 * num_threads);
+        die_unless(!in.ordered());
+        check_complete(scan(in));
+    }
+
+    // blocks are handed out in sequence order, hence each thread sees
+    // increasing indices
+    {
+        stream_type in(bids.begin(), bids.end(), 2 * num_threads, true);
+        std::vector<std::vector<size_t> > pulled = scan(in);
+        check_complete(pulled);
+        for (const std::vector<size_t>& p : pulled)
+            die_unless(std::is_sorted(p.begin(), p.end()));
+    }
+
+    // the stream can be destroyed before it is drained
+    {
+        stream_type in(bids.begin(), bids.end(), 4, true);
+        block_type* block;
+        size_t index;
+        die_unless(in.pull(block, index));
+        die_unequal(index, 0u);
+        die_unequal((*block)[0], 0u);
+        in.release(block);
+    }
+
+    bm->delete_blocks(bids.begin(), bids.end());
+
+    LOG1 << "parallel_buf_istream: " << num_blocks << " blocks scanned by "
+         << num_threads << " threads";
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,133 @@
+/***************************************************************************
+ *  tests/mng/test_partition_writer.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/memory_budget.hpp>
+#include <foxxll/mng/partition_writer.hpp>
+
+constexpr size_t block_size = 4 * 1024;
+constexpr size_t num_buckets = 300;
+constexpr size_t num_elements = 200000;
+
+using block_type = foxxll::typed_block<block_size, uint64_t>;
+using writer_type = foxxll::partition_writer<block_type>;
+
+// forced instantiation
+template class foxxll::partition_writer<block_type>;
+
+//! scatter elements with a skewed bucket distribution, returns the number
+//! of partially filled blocks spilled
+size_t scatter(writer_type& writer, std::vector<size_t>& expected)
+{
+    std::default_random_engine rng(42);
+    expected.assign(num_buckets, 0);
+    for (size_t i = 0; i < num_elements; ++i)
+    {
+        const size_t b = std::min(rng() % num_buckets, rng() % num_buckets);
+        writer.push(b, i * num_buckets + b);
+        ++expected[b];
+    }
+    const size_t spilled = writer.spilled();
+    writer.finish();
+    die_unequal(writer.held(), 0u);
+    return spilled;
+}
+
+//! read back all buckets and delete their blocks
+void check(writer_type& writer, const std::vector<size_t>& expected)
+{
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    std::vector<writer_type::bucket_type> buckets = writer.release_buckets();
+    die_unequal(buckets.size(), num_buckets);
+
+    block_type* block = new block_type;
+    size_t total = 0;
+    for (size_t b = 0; b < num_buckets; ++b)
+    {
+        const writer_type::bucket_type& bucket = buckets[b];
+        die_unequal(bucket.size, expected[b]);
+        die_unequal(bucket.bids.size(), bucket.sizes.size());
+
+        size_t size = 0;
+        uint64_t prev = 0;
+        for (size_t i = 0; i < bucket.bids.size(); ++i)
+        {
+            die_unless(bucket.sizes[i] > 0 && bucket.sizes[i] <= block_type::size);
+            block->read(bucket.bids[i])->wait();
+            for (size_t j = 0; j < bucket.sizes[i]; ++j)
+            {
+                // elements of a bucket arrive in push order
+                const uint64_t v = (*block)[j];
+                die_unequal(v % num_buckets, b);
+                die_unless(size == 0 || v > prev);
+                prev = v;
+                ++size;
+            }
+            bm->delete_block(bucket.bids[i]);
+        }
+        die_unequal(size, expected[b]);
+        total += size;
+    }
+    delete block;
+    die_unequal(total, num_elements);
+}
+
+int main()
+{
+    std::vector<size_t> expected;
+
+    // few blocks in memory: partially filled blocks are spilled
+    size_t spilled;
+    {
+        writer_type writer(num_buckets, 256);
+        spilled = scatter(writer, expected);
+        die_unless(spilled > 0);
+        check(writer, expected);
+    }
+
+    // additional blocks from a sufficient budget: nothing is spilled
+    {
+        foxxll::memory_budget::get_instance()->set_limit(
+            (2 * num_buckets + 512) * block_type::raw_size);
+        foxxll::memory_budget::account account("partition_writer");
+        writer_type writer(num_buckets, 256);
+        writer.set_budget(&account);
+        die_unequal(scatter(writer, expected), 0u);
+        check(writer, expected);
+        die_unequal(account.used(), 0u);
+        die_unless(account.peak() >= (num_buckets - 256) * block_type::raw_size);
+    }
+
+    // without a limit nothing can be borrowed, the writer stays bounded
+    {
+        foxxll::memory_budget::get_instance()->set_limit(0);
+        foxxll::memory_budget::account account("partition_writer");
+        writer_type writer(num_buckets, 256);
+        writer.set_budget(&account);
+        die_unequal(scatter(writer, expected), spilled);
+        check(writer, expected);
+        die_unequal(account.borrowed(), 0u);
+    }
+
+    LOG1 << "partition_writer: " << num_elements << " elements into "
+         << num_buckets << " buckets, " << spilled << " blocks spilled";
+
+    return 0;
+}
+
+/**************************************************************************/
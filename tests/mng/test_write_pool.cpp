@@ -13,7 +13,12 @@
 
 //! \example mng/test_write_pool.cpp
 
+#include <algorithm>
 #include <iostream>
+#include <random>
+#include <vector>
+
+#include <tlx/die.hpp>
 
 #include <foxxll/mng.hpp>
 #include <foxxll/mng/write_pool.hpp>
@@ -42,6 +47,101 @@ int main()
     foxxll::block_manager::get_instance()->new_block(foxxll::single_disk(), bid);
     pool.write(blk, bid)->wait();
     delete blk;
+
+    // more writes than the 6 blocks: steal() reuses those of completed writes
+    foxxll::block_manager* bm = foxxll::block_manager::get_instance();
+    const size_t nblocks = 64;
+    std::vector<block_type::bid_type> bids(nblocks);
+    bm->new_blocks(foxxll::striping(), bids.begin(), bids.end());
+    for (size_t i = 0; i < nblocks; ++i)
+    {
+        blk = pool.steal();
+        (*blk)[0].integer = static_cast<int>(i);
+        pool.write(blk, bids[i]);
+        die_unless(pool.has_request(bids[i]));
+    }
+    die_unequal(pool.size(), 6u);
+
+    // an overwritten write is not found by its BID any more
+    blk = pool.steal();
+    (*blk)[0].integer = -1;
+    pool.write(blk, bids[0]);
+    std::pair<block_type*, foxxll::request_ptr> wp = pool.steal_request(bids[0]);
+    die_unless(wp.first != nullptr);
+    wp.second->wait();
+    die_unequal((*wp.first)[0].integer, -1);
+    die_unless(!pool.has_request(bids[0]));
+    pool.add(wp.first);
+
+    // all blocks busy and the first write taken over: its completion comes
+    // first but frees no block, so steal() has to wait for the second one
+    pool.resize(2);
+    for (size_t i = 1; i <= 2; ++i)
+    {
+        blk = pool.steal();
+        (*blk)[0].integer = static_cast<int>(i);
+        pool.write(blk, bids[i]);
+    }
+    wp = pool.steal_request(bids[1]);
+    blk = pool.steal();
+    die_unless(blk != nullptr);
+    wp.second->wait();
+    pool.add(blk);
+    pool.add(wp.first);
+    die_unequal(pool.size(), 2u);
+
+    // waits for all writes
+    pool.resize(0);
+    die_unequal(pool.size(), 0u);
+
+    block_type* check = new block_type;
+    for (size_t i = 1; i < nblocks; ++i)
+    {
+        check->read(bids[i])->wait();
+        die_unequal((*check)[0].integer, static_cast<int>(i));
+    }
+
+    // batched writes in random order are submitted sorted by file and offset
+    std::shuffle(bids.begin(), bids.end(), std::default_random_engine(42));
+    pool.resize(12);
+    pool.set_batch_size(8);
+    for (size_t i = 0; i < nblocks; ++i)
+    {
+        blk = pool.steal();
+        (*blk)[0].integer = static_cast<int>(nblocks + i);
+        pool.write(blk, bids[i]);
+        die_unless(pool.has_request(bids[i]));
+    }
+    die_unequal(pool.size(), 12u);
+
+    // a batched write is replaced by a later one of the same BID
+    pool.set_batch_size(4);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        blk = pool.steal();
+        (*blk)[0].integer = -static_cast<int>(i);
+        pool.write(blk, bids[0]);
+    }
+    die_unequal(pool.size(), 12u);
+
+    // stealing a batched block submits the batch
+    wp = pool.steal_request(bids[0]);
+    die_unless(wp.first != nullptr);
+    wp.second->wait();
+    die_unequal((*wp.first)[0].integer, -1);
+    pool.add(wp.first);
+
+    pool.flush();
+    pool.resize(0);
+
+    for (size_t i = 1; i < nblocks; ++i)
+    {
+        check->read(bids[i])->wait();
+        die_unequal((*check)[0].integer, static_cast<int>(nblocks + i));
+    }
+    delete check;
+    bm->delete_blocks(bids.begin(), bids.end());
+    bm->delete_block(bid);
 }
 
 /**************************************************************************/
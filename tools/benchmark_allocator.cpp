@@ -0,0 +1,166 @@
+/***************************************************************************
+ *  tools/benchmark_allocator.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <tlx/cmdline_parser.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io.hpp>
+#include <foxxll/mng.hpp>
+#include <foxxll/mng/disk_block_allocator.hpp>
+
+using foxxll::timestamp;
+using foxxll::external_size_type;
+
+using bid_type = foxxll::BID<0>;
+
+static void print_phase(const char* phase, size_t ops, double elapsed)
+{
+    LOG1 << std::setw(8) << phase << ": " << ops << " ops in "
+         << std::fixed << std::setw(8) << std::setprecision(3)
+         << elapsed << " seconds: "
+         << std::setw(12) << std::setprecision(0)
+         << (static_cast<double>(ops) / elapsed) << " ops/s";
+}
+
+static void run_allocator(const std::string& path, bool size_classes,
+                          size_t num_blocks, size_t block_size)
+{
+    // fileperblock files only record their size, no disk space is used
+    foxxll::disk_config cfg(
+        path, num_blocks * block_size, "fileperblock_syscall");
+    cfg.autogrow = false;
+    cfg.size_classes = size_classes;
+
+    foxxll::file_ptr file = foxxll::create_file(
+            cfg, foxxll::file::CREAT | foxxll::file::RDWR, 0);
+
+    std::vector<bid_type> bids(num_blocks);
+    for (bid_type& bid : bids)
+        bid.size = block_size;
+
+    std::default_random_engine rng(std::random_device { } ());
+    double begin, alloc_time, churn_time, free_time;
+
+    LOG1 << "# Allocator: " << (size_classes ? "sizeclass" : "extent");
+
+    {
+        foxxll::disk_block_allocator alloc(file.get(), cfg);
+
+        // allocate all blocks one at a time
+        begin = timestamp();
+        for (size_t i = 0; i < num_blocks; ++i)
+            alloc.new_blocks(bids.begin() + i, bids.begin() + i + 1);
+        alloc_time = timestamp() - begin;
+        print_phase("alloc", num_blocks, alloc_time);
+
+        // free the first half in random order, creating fragmented space
+        std::shuffle(bids.begin(), bids.end(), rng);
+        const size_t half = num_blocks / 2;
+        for (size_t i = 0; i < half; ++i)
+            alloc.delete_block(bids[i]);
+
+        // repeatedly free and allocate random blocks
+        std::uniform_int_distribution<size_t> dist(half, num_blocks - 1);
+        begin = timestamp();
+        for (size_t i = 0; i < half; ++i) {
+            bid_type& bid = bids[dist(rng)];
+            alloc.delete_block(bid);
+            alloc.new_blocks(&bid, &bid + 1);
+        }
+        churn_time = timestamp() - begin;
+        print_phase("churn", 2 * half, churn_time);
+
+        // free the rest
+        begin = timestamp();
+        for (size_t i = half; i < num_blocks; ++i)
+            alloc.delete_block(bids[i]);
+        free_time = timestamp() - begin;
+        print_phase("free", num_blocks - half, free_time);
+    }
+
+    std::cout << "RESULT"
+              << (getenv("RESULT") ? getenv("RESULT") : "")
+              << " alloc=" << (size_classes ? "sizeclass" : "extent")
+              << " num_blocks=" << num_blocks
+              << " block_size=" << block_size
+              << " alloc_time=" << alloc_time
+              << " churn_time=" << churn_time
+              << " free_time=" << free_time
+              << std::endl;
+}
+
+int benchmark_allocator(int argc, char* argv[])
+{
+    // parse command line
+
+    tlx::CmdlineParser cp;
+
+    size_t num_blocks = 1024 * 1024;
+    external_size_type block_size = 4096;
+    std::string path = "/tmp/foxxll_benchmark_allocator";
+    std::string allocstr;
+
+    cp.add_opt_param_size_t(
+        "num_blocks", num_blocks,
+        "Number of blocks to allocate (default: 1Mi)."
+    );
+    cp.add_opt_param_bytes(
+        "block_size", block_size,
+        "Size of the blocks (default: 4KiB)."
+    );
+    cp.add_opt_param_string(
+        "alloc", allocstr,
+        "Free space management: extent, sizeclass (default: both)."
+    );
+    cp.add_string(
+        'p', "path", path,
+        "Path prefix of the (never written) fileperblock file."
+    );
+
+    cp.set_description(
+        "This program benchmarks the free space management of "
+        "disk_block_allocator: allocation of single blocks, random "
+        "deallocation and reallocation, and deallocation. No I/O is "
+        "performed."
+    );
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    if (num_blocks == 0 || block_size == 0) {
+        LOG1 << "num_blocks and block_size must be positive";
+        return -1;
+    }
+
+    if (!allocstr.empty() && allocstr != "extent" && allocstr != "sizeclass")
+    {
+        LOG1 << "Unknown allocator '" << allocstr << "'";
+        cp.print_usage();
+        return -1;
+    }
+
+    if (allocstr.empty() || allocstr == "extent")
+        run_allocator(path, false, num_blocks, block_size);
+    if (allocstr.empty() || allocstr == "sizeclass")
+        run_allocator(path, true, num_blocks, block_size);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,238 @@
+/***************************************************************************
+ *  tools/benchmark_prefetch_schedule.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <tlx/cmdline_parser.hpp>
+#include <tlx/logger.hpp>
+
+#include <foxxll/common/timer.hpp>
+#include <foxxll/mng/async_schedule.hpp>
+
+using foxxll::timestamp;
+
+/*!
+ * Time to consume the sequence if reads are issued in the given order with m
+ * buffers: disk d reads the blocks issued to it in order, taking service[d]
+ * per block, blocks are consumed in sequence order as soon as they are read,
+ * and a consumed block frees its buffer for the next read.
+ */
+static double simulate_prefetch(const std::vector<size_t>& disks,
+                                const std::vector<size_t>& order,
+                                size_t m, const std::vector<double>& service)
+{
+    using event = std::pair<double, size_t>;
+    const size_t L = disks.size();
+    std::vector<std::queue<size_t> > queues(service.size());
+    std::vector<bool> busy(service.size(), false), done(L, false);
+    std::priority_queue<event, std::vector<event>, std::greater<event> > events;
+
+    double now = 0.0;
+    auto start_next = [&](size_t d) {
+                          if (busy[d] || queues[d].empty())
+                              return;
+                          events.push(event(now + service[d], queues[d].front()));
+                          queues[d].pop();
+                          busy[d] = true;
+                      };
+
+    size_t issued = 0, consumed = 0;
+    while (consumed < L)
+    {
+        while (issued < L && issued < consumed + m) {
+            const size_t b = order[issued++];
+            queues[disks[b]].push(b);
+            start_next(disks[b]);
+        }
+
+        const event e = events.top();
+        events.pop();
+        now = e.first;
+        done[e.second] = true;
+        busy[disks[e.second]] = false;
+        start_next(disks[e.second]);
+
+        while (consumed < L && done[consumed])
+            ++consumed;
+    }
+    return now;
+}
+
+static void run_schedule(const char* name, const std::vector<size_t>& disks,
+                         size_t m, const std::vector<double>& service,
+                         const std::vector<double>& schedule_service,
+                         size_t window, bool simulate)
+{
+    const size_t D = service.size();
+    const size_t L = disks.size();
+    std::vector<size_t> order(L);
+
+    double begin = timestamp(), first_time, total_time;
+    if (window == 0)
+    {
+        foxxll::compute_prefetch_schedule(
+            disks.data(), disks.data() + L, order.data(), m, D,
+            schedule_service);
+        total_time = first_time = timestamp() - begin;
+    }
+    else
+    {
+        // time until the prefetcher could issue its first read
+        foxxll::compute_windowed_prefetch_schedule(
+            disks.data(), disks.data() + std::min(window, L),
+            order.data(), m, D, window, schedule_service);
+        first_time = timestamp() - begin;
+
+        foxxll::compute_windowed_prefetch_schedule(
+            disks.data(), disks.data() + L, order.data(), m, D, window,
+            schedule_service);
+        total_time = timestamp() - begin - first_time;
+    }
+
+    // the full schedule allocates disks, order and a pair per block
+    const size_t memory = 4 * sizeof(size_t) * (window ? std::min(window, L) : L);
+    const double io_time = simulate ? simulate_prefetch(disks, order, m, service) : 0;
+
+    LOG1 << std::setw(9) << name << ": first read after "
+         << std::fixed << std::setprecision(4) << first_time
+         << " s, total " << total_time << " s, "
+         << (memory / 1024) << " KiB schedule memory"
+         << (simulate ? ", " : "")
+         << (simulate ? "I/O time " + std::to_string(io_time) : "");
+
+    std::cout << "RESULT"
+              << (getenv("RESULT") ? getenv("RESULT") : "")
+              << " schedule=" << name
+              << " length=" << L
+              << " buffers=" << m
+              << " disks=" << D
+              << " window=" << window
+              << " first_time=" << first_time
+              << " total_time=" << total_time
+              << " memory=" << memory
+              << " io_time=" << io_time
+              << std::endl;
+}
+
+int benchmark_prefetch_schedule(int argc, char* argv[])
+{
+    // parse command line
+
+    tlx::CmdlineParser cp;
+
+    size_t length = 16 * 1024 * 1024;
+    size_t buffers = 64;
+    size_t ndisks = 8;
+    size_t window = 0;
+    size_t seed = 42;
+    std::string times_str;
+    bool simulate = false;
+
+    cp.add_opt_param_size_t(
+        "length", length,
+        "Number of blocks in the sequence (default: 16Mi)."
+    );
+    cp.add_size_t(
+        'm', "buffers", buffers,
+        "Number of prefetch buffers (default: 64)."
+    );
+    cp.add_size_t(
+        'd', "disks", ndisks,
+        "Number of disks the blocks are spread over (default: 8)."
+    );
+    cp.add_size_t(
+        'w', "window", window,
+        "Window of the windowed schedule in blocks (default: automatic)."
+    );
+    cp.add_size_t(
+        's', "seed", seed,
+        "Seed of the random disk assignment (default: 42)."
+    );
+    cp.add_string(
+        't', "times", times_str,
+        "Comma separated relative read times of the disks, repeated over "
+        "all disks, e.g. 1,4 (default: all equal)."
+    );
+    cp.add_flag(
+        'q', "quality", simulate,
+        "Simulate the I/O time needed with each schedule."
+    );
+
+    cp.set_description(
+        "This program compares the full prefetch schedule computation with "
+        "the windowed one on a sequence of blocks placed on random disks: "
+        "time until the first read can be issued, total time, memory and, "
+        "optionally, the I/O time of the schedule. With disks of different "
+        "speed, the schedule ignoring the speeds is shown for comparison."
+    );
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    if (length == 0 || buffers == 0 || ndisks == 0) {
+        LOG1 << "length, buffers and disks must be positive";
+        return -1;
+    }
+    if (window == 0)
+        window = foxxll::default_prefetch_window(buffers);
+
+    std::vector<size_t> disks(length);
+    std::default_random_engine rng(static_cast<unsigned>(seed));
+    for (size_t& d : disks)
+        d = rng() % ndisks;
+
+    std::vector<double> times;
+    {
+        std::istringstream iss(times_str);
+        std::string t;
+        while (std::getline(iss, t, ','))
+        {
+            const double v = std::strtod(t.c_str(), nullptr);
+            if (v <= 0.0) {
+                LOG1 << "Invalid disk time '" << t << "'";
+                return -1;
+            }
+            times.push_back(v);
+        }
+    }
+    std::vector<double> service(ndisks, 1.0);
+    for (size_t d = 0; d < ndisks && !times.empty(); ++d)
+        service[d] = times[d % times.size()];
+
+    if (simulate) {
+        // lower bound: the most loaded disk reads all the time
+        std::vector<double> load(ndisks, 0.0);
+        for (size_t d : disks)
+            load[d] += service[d];
+        LOG1 << "lower bound: I/O time "
+             << *std::max_element(load.begin(), load.end());
+    }
+
+    if (!times.empty())
+        run_schedule("oblivious", disks, buffers, service,
+                     std::vector<double>(), 0, simulate);
+    run_schedule("full", disks, buffers, service, service, 0, simulate);
+    run_schedule("windowed", disks, buffers, service, service, window, simulate);
+
+    return 0;
+}
+
+/**************************************************************************/
@@ -0,0 +1,446 @@
+/***************************************************************************
+ *  tools/calibrate.cpp
+ *
+ *  Part of FOXXLL. See http://foxxll.org
+ *
+ *  Copyright (C) 2026 FOXXLL Maintainer Team
+ *
+ *  Distributed under the Boost Software License, Version 1.0.
+ *  (See accompanying file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ **************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tlx/cmdline_parser.hpp>
+#include <tlx/logger.hpp>
+#include <tlx/string/parse_si_iec_units.hpp>
+#include <tlx/string/split.hpp>
+
+#include <foxxll/common/aligned_alloc.hpp>
+#include <foxxll/common/timer.hpp>
+#include <foxxll/io.hpp>
+#include <foxxll/mng/config.hpp>
+
+using foxxll::request_ptr;
+using foxxll::timestamp;
+using foxxll::external_size_type;
+
+//! result of one calibration run
+struct measurement
+{
+    std::string backend;
+    size_t block_size;
+    size_t queue_depth;
+    bool write;
+    //! bandwidth in MiB/s
+    double bandwidth;
+    //! latency percentiles in milliseconds
+    double latency_p50, latency_p95, latency_p99;
+};
+
+//! recommended settings for one disk
+struct recommendation
+{
+    std::string backend;
+    size_t block_size = 0;
+    size_t queue_depth = 0;
+    double read_bandwidth = 0, write_bandwidth = 0;
+};
+
+static double percentile(std::vector<double>& values, double p)
+{
+    if (values.empty()) return 0.0;
+    const size_t k = std::min(
+        values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+//! Issue volume bytes of requests of block_size bytes with at most
+//! queue_depth requests in flight, and measure bandwidth and latencies.
+static measurement measure(
+    foxxll::file* file, char* buffer, bool write, size_t block_size,
+    size_t queue_depth, external_size_type volume, bool random)
+{
+    const size_t num_blocks = static_cast<size_t>(volume / block_size);
+
+    std::vector<external_size_type> order(num_blocks);
+    std::iota(order.begin(), order.end(), 0);
+    if (random) {
+        std::default_random_engine rng(std::random_device { } ());
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+
+    std::vector<request_ptr> reqs(num_blocks);
+    std::vector<double> start(num_blocks), end(num_blocks);
+
+    const double begin = timestamp();
+    for (size_t i = 0; i < num_blocks; ++i)
+    {
+        if (i >= queue_depth)
+            reqs[i - queue_depth]->wait();
+
+        foxxll::completion_handler on_complete =
+            [&end, i](foxxll::request*, bool) { end[i] = timestamp(); };
+
+        start[i] = timestamp();
+        const external_size_type offset = order[i] * block_size;
+        reqs[i] = write
+                  ? file->awrite(buffer, offset, block_size, on_complete)
+                  : file->aread(buffer, offset, block_size, on_complete);
+    }
+    foxxll::wait_all(reqs.begin(), reqs.end());
+    const double elapsed = timestamp() - begin;
+
+    std::vector<double> latency(num_blocks);
+    for (size_t i = 0; i < num_blocks; ++i)
+        latency[i] = 1000.0 * (end[i] - start[i]);
+
+    measurement m;
+    m.block_size = block_size;
+    m.queue_depth = queue_depth;
+    m.write = write;
+    m.bandwidth = static_cast<double>(num_blocks * block_size) /
+                  (1024.0 * 1024.0) / elapsed;
+    m.latency_p50 = percentile(latency, 0.50);
+    m.latency_p95 = percentile(latency, 0.95);
+    m.latency_p99 = percentile(latency, 0.99);
+    return m;
+}
+
+//! Choose the backend with the highest bandwidth, the smallest block size
+//! reaching 90% of it, and the smallest queue depth reaching 90% of the
+//! bandwidth at that block size.
+static recommendation recommend(const std::vector<measurement>& results)
+{
+    // average of read and write bandwidth of each (backend, size, depth)
+    struct point {
+        std::string backend;
+        size_t block_size, queue_depth;
+        double read = 0, write = 0;
+        double score() const { return (read + write) / 2; }
+    };
+    std::vector<point> points;
+    for (const measurement& m : results)
+    {
+        auto it = std::find_if(
+            points.begin(), points.end(), [&m](const point& p) {
+                return p.backend == m.backend && p.block_size == m.block_size &&
+                p.queue_depth == m.queue_depth;
+            });
+        if (it == points.end()) {
+            points.push_back(point { m.backend, m.block_size, m.queue_depth });
+            it = points.end() - 1;
+        }
+        (m.write ? it->write : it->read) = m.bandwidth;
+    }
+
+    recommendation rec;
+    if (points.empty())
+        return rec;
+
+    const point& best = *std::max_element(
+        points.begin(), points.end(), [](const point& a, const point& b) {
+            return a.score() < b.score();
+        });
+
+    rec.backend = best.backend;
+    rec.block_size = best.block_size;
+    for (const point& p : points) {
+        if (p.backend == rec.backend && p.score() >= 0.9 * best.score())
+            rec.block_size = std::min(rec.block_size, p.block_size);
+    }
+
+    double size_best = 0;
+    for (const point& p : points) {
+        if (p.backend == rec.backend && p.block_size == rec.block_size)
+            size_best = std::max(size_best, p.score());
+    }
+
+    rec.queue_depth = 0;
+    for (const point& p : points)
+    {
+        if (p.backend != rec.backend || p.block_size != rec.block_size ||
+            p.score() < 0.9 * size_best)
+            continue;
+        if (rec.queue_depth == 0 || p.queue_depth < rec.queue_depth) {
+            rec.queue_depth = p.queue_depth;
+            rec.read_bandwidth = p.read;
+            rec.write_bandwidth = p.write;
+        }
+    }
+    return rec;
+}
+
+//! parse a comma separated list of sizes
+static bool parse_list(const std::string& str, std::vector<size_t>& out)
+{
+    out.clear();
+    for (const std::string& s : tlx::split(',', str)) {
+        uint64_t v;
+        if (!tlx::parse_si_iec_units(s, &v) || v == 0)
+            return false;
+        out.push_back(static_cast<size_t>(v));
+    }
+    return !out.empty();
+}
+
+static void write_profile(
+    std::ostream& os, const std::vector<foxxll::disk_config>& disks,
+    const std::vector<std::vector<measurement> >& results,
+    const std::vector<recommendation>& recs)
+{
+    os << "{\n  \"disks\": [";
+    for (size_t d = 0; d < disks.size(); ++d)
+    {
+        os << (d ? "," : "") << "\n    {\n"
+           << "      \"path\": \"" << disks[d].path << "\",\n"
+           << "      \"recommended\": { \"backend\": \"" << recs[d].backend
+           << "\", \"block_size\": " << recs[d].block_size
+           << ", \"queue_depth\": " << recs[d].queue_depth
+           << ", \"read_bandwidth\": " << recs[d].read_bandwidth
+           << ", \"write_bandwidth\": " << recs[d].write_bandwidth << " },\n"
+           << "      \"measurements\": [";
+
+        for (size_t i = 0; i < results[d].size(); ++i)
+        {
+            const measurement& m = results[d][i];
+            os << (i ? "," : "") << "\n        { \"backend\": \"" << m.backend
+               << "\", \"op\": \"" << (m.write ? "write" : "read")
+               << "\", \"block_size\": " << m.block_size
+               << ", \"queue_depth\": " << m.queue_depth
+               << ", \"bandwidth\": " << m.bandwidth
+               << ", \"latency_p50\": " << m.latency_p50
+               << ", \"latency_p95\": " << m.latency_p95
+               << ", \"latency_p99\": " << m.latency_p99 << " }";
+        }
+        os << "\n      ]\n    }";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int calibrate(int argc, char* argv[])
+{
+    // parse command line
+
+    tlx::CmdlineParser cp;
+
+    external_size_type volume = 64 * 1024 * 1024;
+    std::string block_sizes_str = "64Ki,256Ki,1Mi,4Mi";
+    std::string depths_str = "1,4,16";
+    std::string backends_str = "syscall,linuxaio,mmap";
+    std::string config_out = "calibrated.foxxll";
+    std::string profile_out = "device_profile.json";
+    bool random = false;
+
+    cp.add_bytes(
+        'v', "volume", volume,
+        "Bytes transferred per measurement (default: 64MiB)."
+    );
+    cp.add_string(
+        'b', "block_sizes", block_sizes_str,
+        "Comma separated request sizes (default: 64Ki,256Ki,1Mi,4Mi)."
+    );
+    cp.add_string(
+        'q', "queue_depths", depths_str,
+        "Comma separated numbers of requests in flight (default: 1,4,16)."
+    );
+    cp.add_string(
+        'i', "backends", backends_str,
+        "Comma separated file I/O implementations "
+        "(default: syscall,linuxaio,mmap, as far as available)."
+    );
+    cp.add_flag(
+        'r', "random", random,
+        "Access the blocks in random instead of sequential order."
+    );
+    cp.add_string(
+        'o', "output", config_out,
+        "Tuned disk configuration file to write (default: calibrated.foxxll)."
+    );
+    cp.add_string(
+        'p', "profile", profile_out,
+        "Device profile in JSON to write (default: device_profile.json)."
+    );
+
+    cp.set_description(
+        "Calibrate the disks configured by the standard .foxxll mechanism: "
+        "measure bandwidth and latency percentiles for all combinations of "
+        "request size, queue depth and file I/O implementation, then write a "
+        "tuned disk configuration and a device profile. The disk files are "
+        "overwritten!"
+    );
+
+    if (!cp.process(argc, argv))
+        return -1;
+
+    std::vector<size_t> block_sizes, depths;
+    if (!parse_list(block_sizes_str, block_sizes) ||
+        !parse_list(depths_str, depths))
+    {
+        LOG1 << "Invalid list of block sizes or queue depths.";
+        return -1;
+    }
+    for (size_t bs : block_sizes) {
+        if (bs % foxxll::BlockAlignment != 0 || bs > volume) {
+            LOG1 << "Block size " << bs << " must be a multiple of "
+                 << foxxll::BlockAlignment << " and at most the volume.";
+            return -1;
+        }
+    }
+
+    std::vector<std::string> backends;
+    for (const std::string& b : tlx::split(',', backends_str))
+    {
+#if !FOXXLL_HAVE_LINUXAIO_FILE
+        if (b == "linuxaio") continue;
+#endif
+#if !FOXXLL_HAVE_MMAP_FILE
+        if (b == "mmap") continue;
+#endif
+        backends.push_back(b);
+    }
+
+    foxxll::config* config = foxxll::config::get_instance();
+    const size_t ndisks = config->disks_number();
+
+    std::vector<foxxll::disk_config> disks;
+    for (size_t d = 0; d < ndisks; ++d)
+        disks.push_back(config->disk(d));
+
+    const size_t max_block =
+        *std::max_element(block_sizes.begin(), block_sizes.end());
+    const size_t max_depth = *std::max_element(depths.begin(), depths.end());
+    char* buffer = static_cast<char*>(
+        foxxll::aligned_alloc<foxxll::BlockAlignment>(max_block));
+    std::fill(buffer, buffer + max_block, 42);
+
+    std::vector<std::vector<measurement> > results(ndisks);
+    std::vector<recommendation> recs(ndisks);
+
+    for (size_t d = 0; d < ndisks; ++d)
+    {
+        const bool existed = std::ifstream(disks[d].path.c_str()).good();
+        bool raw_device = false;
+
+        for (const std::string& backend : backends)
+        {
+            foxxll::disk_config cfg = disks[d];
+            cfg.io_impl = backend;
+            cfg.queue = static_cast<int>(d);
+            cfg.queue_length = static_cast<int>(max_depth);
+            cfg.unlink_on_open = false;
+
+            external_size_type span = volume;
+            try
+            {
+                foxxll::file_ptr file = foxxll::create_file(
+                        cfg, foxxll::file::CREAT | foxxll::file::RDWR);
+                raw_device = cfg.raw_device;
+                if (raw_device)
+                    span = std::min(span, cfg.size);
+                else if (file->size() < span)
+                    file->set_size(span);
+
+                for (size_t bs : block_sizes)
+                {
+                    for (size_t depth : depths)
+                    {
+                        for (const bool write : { true, false })
+                        {
+                            measurement m = measure(
+                                file.get(), buffer, write, bs, depth, span,
+                                random);
+                            m.backend = backend;
+                            results[d].push_back(m);
+
+                            LOG1 << "disk " << d << " " << std::setw(8)
+                                 << backend << " "
+                                 << (write ? "write" : "read ")
+                                 << " block_size=" << std::setw(8) << bs
+                                 << " depth=" << std::setw(3) << depth
+                                 << std::fixed << std::setprecision(1)
+                                 << " " << std::setw(8) << m.bandwidth
+                                 << " MiB/s  p50=" << std::setprecision(3)
+                                 << m.latency_p50 << " p95=" << m.latency_p95
+                                 << " p99=" << m.latency_p99 << " ms";
+                        }
+                    }
+                }
+            }
+            catch (std::exception& e)
+            {
+                LOG1 << "disk " << d << ": skipping " << backend << ": "
+                     << e.what();
+            }
+        }
+
+        // remove files created only for the calibration
+        if (!existed && !raw_device)
+            std::remove(disks[d].path.c_str());
+
+        recs[d] = recommend(results[d]);
+
+        std::cout << "RESULT"
+                  << (getenv("RESULT") ? getenv("RESULT") : "")
+                  << " disk=" << disks[d].path
+                  << " backend=" << recs[d].backend
+                  << " block_size=" << recs[d].block_size
+                  << " queue_depth=" << recs[d].queue_depth
+                  << " read_bandwidth=" << recs[d].read_bandwidth
+                  << " write_bandwidth=" << recs[d].write_bandwidth
+                  << std::endl;
+    }
+
+    foxxll::aligned_dealloc<foxxll::BlockAlignment>(buffer);
+
+    // tuned disk configuration
+    {
+        std::ofstream out(config_out.c_str());
+        out << "# generated by foxxll_tool calibrate\n";
+        for (size_t d = 0; d < ndisks; ++d)
+        {
+            foxxll::disk_config cfg = disks[d];
+            if (!recs[d].backend.empty()) {
+                cfg.io_impl = recs[d].backend;
+                cfg.queue_length = (recs[d].backend == "linuxaio")
+                                   ? static_cast<int>(recs[d].queue_depth) : 0;
+                // weighs the disk in prefetch schedules, MiB/s to bytes/s
+                cfg.bandwidth = static_cast<foxxll::external_size_type>(
+                    recs[d].read_bandwidth * 1024.0 * 1024.0);
+                out << "# recommended block size " << recs[d].block_size
+                    << ", queue depth " << recs[d].queue_depth << "\n";
+            }
+            out << cfg.config_line() << "\n";
+        }
+        if (!out.good()) {
+            LOG1 << "Error writing " << config_out;
+            return -1;
+        }
+    }
+
+    // machine-readable device profile
+    {
+        std::ofstream out(profile_out.c_str());
+        write_profile(out, disks, results, recs);
+        if (!out.good()) {
+            LOG1 << "Error writing " << profile_out;
+            return -1;
+        }
+    }
+
+    LOG1 << "Wrote " << config_out << " and " << profile_out;
+
+    return 0;
+}
+
+/**************************************************************************/
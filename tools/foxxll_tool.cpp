@@ -47,6 +47,9 @@ extern int benchmark_disks(int argc, char* argv[]);
 extern int benchmark_files(int argc, char* argv[]);
 extern int benchmark_sort(int argc, char* argv[]);
 extern int benchmark_disks_random(int argc, char* argv[]);
+extern int benchmark_allocator(int argc, char* argv[]);
+extern int benchmark_prefetch_schedule(int argc, char* argv[]);
+extern int calibrate(int argc, char* argv[]);
 extern int benchmark_pqueue(int argc, char* argv[]);
 extern int do_mlock(int argc, char* argv[]);
 extern int do_mallinfo(int argc, char* argv[]);
@@ -82,6 +85,22 @@ struct SubTool subtools[] = {
         "benchmark_disks_random", &benchmark_disks_random, false,
         "Benchmark random block access time to .foxxll configured disks."
     },
+    {
+        "benchmark_allocator", &benchmark_allocator, false,
+        "Benchmark the free space management of disk_block_allocator, "
+        "comparing the extent map to size class free lists."
+    },
+    {
+        "benchmark_prefetch_schedule", &benchmark_prefetch_schedule, false,
+        "Compare the time, memory and quality of the full and the windowed "
+        "prefetch schedule computation."
+    },
+    {
+        "calibrate", &calibrate, false,
+        "Sweep request sizes, queue depths and file I/O implementations on "
+        "the .foxxll configured disks, write a tuned disk configuration and a "
+        "device profile."
+    },
     { nullptr, nullptr, false, nullptr }
 };
 